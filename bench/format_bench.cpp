@@ -0,0 +1,103 @@
+// Compares the price reply formatting of pricefmt (precomputed grouping rules,
+// std::to_chars into a reused buffer) with the previous path, which built
+// std::locale objects and std::stringstreams for every reply and recovered
+// the precision by round-tripping through strings.
+//
+// Usage: format_bench [iterations]
+
+#include <price_format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <locale>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::locale get_locale(const std::string& name) {
+    try {
+        return std::locale(name);
+    } catch (const std::runtime_error&) {
+        return std::locale::classic();
+    }
+}
+
+int determine_precision_from_str(std::string value) {
+    size_t decimal_pos = value.find('.');
+    if (decimal_pos == std::string::npos) return 0;
+    int precision = value.length() - decimal_pos - 1;
+    return std::max(0, std::min(precision, 10));
+}
+
+std::string dump(double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+std::string legacy_reply(const std::string& id, double usd, double idr) {
+    // What the /simple/price parser did: dump() the JSON number (shortest
+    // round-trip digits), then stod it back
+    std::string usd_str = dump(usd);
+    std::string idr_str = dump(idr);
+    double usd_value = std::stod(usd_str);
+    double idr_value = std::stod(idr_str);
+    int usd_precision = determine_precision_from_str(usd_str);
+    int idr_precision = determine_precision_from_str(idr_str);
+
+    std::stringstream ss_usd;
+    ss_usd.imbue(get_locale("en_US.UTF-8"));
+    ss_usd << std::fixed << std::setprecision(usd_precision) << usd_value;
+
+    std::stringstream ss_idr;
+    ss_idr.imbue(get_locale("id_ID.UTF-8"));
+    ss_idr << std::fixed << std::setprecision(idr_precision) << idr_value;
+
+    return ":information_source: " + id + " price: $" + ss_usd.str() + " / Rp." + ss_idr.str();
+}
+
+std::string pricefmt_reply(const std::string& id, double usd, double idr) {
+    std::string reply;
+    reply.reserve(64 + id.size());
+    reply += ":information_source: ";
+    reply += id;
+    reply += " price: $";
+    pricefmt::append(reply, usd, pricefmt::precision_of(usd), pricefmt::usd);
+    reply += " / Rp.";
+    pricefmt::append(reply, idr, pricefmt::precision_of(idr), pricefmt::idr);
+    return reply;
+}
+
+template <typename F>
+double time_ns(F&& reply, const std::vector<double>& prices, long iterations, size_t& sink) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+        double usd = prices[i % prices.size()];
+        sink += reply("bitcoin", usd, usd * 15843.2).size();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 200000;
+
+    // A spread of magnitudes, from sub-cent tokens to BTC
+    std::vector<double> prices = {0.00001234, 0.0421, 0.998, 1.27, 17.45, 243.1, 3012.77, 43123.5, 67890.12};
+
+    size_t sink = 0;
+    double legacy = time_ns(legacy_reply, prices, iterations, sink);
+    double fast = time_ns(pricefmt_reply, prices, iterations, sink);
+
+    std::printf("locale+stringstream: %8.1f ns/reply\n", legacy);
+    std::printf("pricefmt:            %8.1f ns/reply (%.1fx)\n", fast, legacy / fast);
+    std::printf("sample: %s\n", pricefmt_reply("bitcoin", 43123.5, 43123.5 * 15843.2).c_str());
+    return sink == 0;
+}
@@ -0,0 +1,208 @@
+// Drives synthetic slash command traffic through the same code the handlers
+// run (price cache and batcher, streaming parsers, chart rendering, the
+// shared HTTP client and rate limiter) against bench/mock_upstream, and
+// reports throughput and latency percentiles per command. Only the Discord
+// delivery is left out: replies are timed when the handler would send them.
+//
+// The mix is 80% /price over a skewed set of ids, 15% /market (1d, 7d and
+// 30d alike) and 5% /coins.
+// Autocomplete is timed separately beforehand, over every one and two
+// character prefix.
+// The usual bot environment variables (PRICE_CACHE_TTL_SECONDS,
+// COINGECKO_RATE_PER_MINUTE, CHART_BACKEND, ...) apply.
+//
+// Usage: load_bench [commands] [concurrency] [mock_url]
+
+#include <chart_cache.h>
+#include <coin_index.h>
+#include <coin_search.h>
+#include <coingecko.h>
+#include <config.h>
+#include <fx_rates.h>
+#include <http_client.h>
+#include <logging.h>
+#include <price_batcher.h>
+#include <price_cache.h>
+#include <quickchart.h>
+#include <series_store.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct command_stats {
+    const char* name;
+    std::vector<double> latencies_ms;
+    size_t errors = 0;
+};
+
+std::mutex stats_mutex;
+std::condition_variable done_cv;
+size_t outstanding = 0;
+
+void finished(command_stats& stats, clock::time_point start, bool ok) {
+    double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    stats.latencies_ms.push_back(ms);
+    if (!ok) stats.errors++;
+    outstanding--;
+    done_cv.notify_one();
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    long commands = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 5000;
+    size_t concurrency = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+    std::string mock_url = argc > 3 ? argv[3] : "http://127.0.0.1:8089";
+
+    logging::init(logging::parse_level(config::get_string("LOG_LEVEL", "warn"), logging::level::warn));
+    http::init(config::get_long("HTTP_MAX_IN_FLIGHT", 16), config::get_long("HTTP_MAX_QUEUED", 4096));
+
+    gecko::configure_base_url(mock_url + "/api/v3");
+    qchart::configure_base_url(mock_url);
+    gecko::configure_rate_limit(config::get_long("COINGECKO_RATE_PER_MINUTE", 600000),
+                                config::get_long("COINGECKO_BURST", 1000));
+    gecko::price_cache::instance().configure(
+        std::chrono::seconds(config::get_long("PRICE_CACHE_TTL_SECONDS", 30)),
+        std::chrono::seconds(config::get_long("PRICE_CACHE_STALE_SECONDS", 0)),
+        std::chrono::seconds(config::get_long("PRICE_CACHE_FALLBACK_SECONDS", 3600)));
+    gecko::price_batcher::instance().start(
+        std::chrono::milliseconds(config::get_long("PRICE_BATCH_WINDOW_MS", 25)),
+        config::get_long("PRICE_BATCH_MAX_IDS", 50));
+
+    gecko::chart_options chart_options;
+    chart_options.backend = config::get_string("CHART_BACKEND", "local") == "local" ? gecko::chart_backend::local
+                                                                                     : gecko::chart_backend::quickchart;
+    chart_options.max_points = config::get_long("MARKET_CHART_POINTS", 250);
+    gecko::configure_charts(chart_options);
+    gecko::series_store::instance().configure(
+        std::chrono::seconds(config::get_long("MARKET_REFRESH_SECONDS", 60)),
+        config::get_long("MARKET_HISTORY_COINS", 256));
+    gecko::chart_cache::instance().configure(std::chrono::seconds(config::get_long("CHART_CACHE_SECONDS", 60)),
+                                             config::get_long("CHART_CACHE_BYTES", 32 << 20));
+
+    gecko::coin_index::instance().configure_ranking(gecko::base_url() + "/coins/markets",
+                                                    config::get_long("AUTOCOMPLETE_RANKED_COINS", 1000));
+    auto index_start = clock::now();
+    gecko::coin_index::instance().start(std::chrono::hours(1), gecko::rate_limiter(), gecko::base_url() + "/coins/list");
+    gecko::fx_rates::instance().start(std::chrono::hours(1), gecko::rate_limiter(), gecko::base_url() + "/exchange_rates");
+    std::printf("coin index: ready=%d in %.1f ms\n", gecko::coin_index::instance().ready(),
+                std::chrono::duration<double, std::milli>(clock::now() - index_start).count());
+
+    if (auto search = gecko::coin_index::instance().search()) {
+        std::vector<std::string> prefixes{""};
+        for (char a = 'a'; a <= 'z'; a++) {
+            prefixes.push_back(std::string(1, a));
+            for (char b : std::string("abcdefghijklmnopqrstuvwxyz0123456789-")) prefixes.push_back({a, b});
+        }
+        std::vector<double> latencies_us;
+        for (const auto& prefix : prefixes) {
+            for (bool ticker : {true, false}) {
+                auto start = clock::now();
+                auto choices = ticker ? search->tickers(prefix) : search->coins(prefix);
+                latencies_us.push_back(std::chrono::duration<double, std::micro>(clock::now() - start).count());
+            }
+        }
+        std::sort(latencies_us.begin(), latencies_us.end());
+        std::printf("autocomplete: %zu queries over %zu coins, p50 %.1f us, p99 %.1f us, max %.1f us\n",
+                    latencies_us.size(), search->size(), percentile(latencies_us, 0.50),
+                    percentile(latencies_us, 0.99), latencies_us.back());
+    }
+
+    command_stats price{"price", {}, 0};
+    command_stats market{"market", {}, 0};
+    command_stats coins{"coins", {}, 0};
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> pick(0, 1);
+    // A few hot coins and a long tail, like real /price traffic
+    std::geometric_distribution<int> coin_rank(0.05);
+
+    auto bench_start = clock::now();
+    for (long i = 0; i < commands; i++) {
+        {
+            std::unique_lock<std::mutex> lock(stats_mutex);
+            done_cv.wait(lock, [&] { return outstanding < concurrency; });
+            outstanding++;
+        }
+
+        auto start = clock::now();
+        double roll = pick(rng);
+        if (roll < 0.80) {
+            std::string id = "coin-" + std::to_string(coin_rank(rng) % 1000);
+            gecko::reply cached;
+            if (gecko::cached_price_reply(id, "", cached)) {
+                finished(price, start, cached.ok);
+            } else {
+                gecko::price_reply(id, "", [&price, start](const gecko::reply& r) { finished(price, start, r.ok); });
+            }
+        } else if (roll < 0.95) {
+            auto range = static_cast<gecko::chart_range>(rng() % 3);
+            gecko::market_chart_reply("coin-" + std::to_string(coin_rank(rng) % 100), "usd", range,
+                                      [&market, start](const gecko::reply& r) { finished(market, start, r.ok); });
+        } else {
+            finished(coins, start, gecko::coins_reply(gecko::listing_order::market_cap, coin_rank(rng) % 50).ok);
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(stats_mutex);
+        done_cv.wait(lock, [] { return outstanding == 0; });
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - bench_start).count();
+
+    std::printf("%ld commands, concurrency %zu: %.1f s, %.0f commands/s\n", commands, concurrency, seconds,
+                commands / seconds);
+    std::printf("%-8s %8s %8s %9s %9s %9s %9s\n", "command", "count", "errors", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (command_stats* stats : {&price, &market, &coins}) {
+        std::sort(stats->latencies_ms.begin(), stats->latencies_ms.end());
+        const auto& l = stats->latencies_ms;
+        std::printf("%-8s %8zu %8zu %9.2f %9.2f %9.2f %9.2f\n", stats->name, l.size(), stats->errors,
+                    percentile(l, 0.50), percentile(l, 0.90), percentile(l, 0.99), l.empty() ? 0.0 : l.back());
+    }
+
+    http::stats http_stats = http::get_stats();
+    gecko::price_cache::stats cache = gecko::price_cache::instance().get_stats();
+    gecko::price_batcher::stats batcher = gecko::price_batcher::instance().get_stats();
+    std::printf("upstream: requests=%llu failures=%llu throttled=%llu retried=%llu new_connections=%llu\n",
+                (unsigned long long)http_stats.requests, (unsigned long long)http_stats.failures,
+                (unsigned long long)http_stats.throttled, (unsigned long long)http_stats.retried,
+                (unsigned long long)http_stats.new_connections);
+    std::printf("upstream bytes: received=%llu decoded=%llu\n", (unsigned long long)http_stats.received_bytes,
+                (unsigned long long)http_stats.decoded_bytes);
+    std::printf("price cache: hits=%llu misses=%llu coalesced=%llu; batches=%llu for %llu lookups\n",
+                (unsigned long long)cache.hits, (unsigned long long)cache.misses, (unsigned long long)cache.coalesced,
+                (unsigned long long)batcher.batches, (unsigned long long)batcher.lookups);
+    gecko::series_store::stats series = gecko::series_store::instance().get_stats();
+    std::printf("price history: hits=%llu refreshes=%llu loads=%llu coalesced=%llu\n",
+                (unsigned long long)series.hits, (unsigned long long)series.refreshes,
+                (unsigned long long)series.loads, (unsigned long long)series.coalesced);
+    gecko::chart_cache::stats charts = gecko::chart_cache::instance().get_stats();
+    std::printf("chart cache: hits=%llu misses=%llu coalesced=%llu entries=%llu bytes=%llu\n",
+                (unsigned long long)charts.hits, (unsigned long long)charts.misses,
+                (unsigned long long)charts.coalesced, (unsigned long long)charts.entries,
+                (unsigned long long)charts.bytes);
+
+    gecko::coin_index::instance().stop();
+    gecko::fx_rates::instance().stop();
+    gecko::price_batcher::instance().stop();
+    logging::shutdown();
+    return 0;
+}
@@ -0,0 +1,486 @@
+// Local stand-in for the CoinGecko and QuickChart endpoints the bot calls,
+// for load testing without touching the real APIs. Point the bot (or
+// load_bench) at it with
+//
+//   COINGECKO_BASE_URL=http://127.0.0.1:8089/api/v3
+//   QUICKCHART_BASE_URL=http://127.0.0.1:8089
+//
+// Routes:
+//   GET  /api/v3/coins/list
+//   GET  /api/v3/coins/
+//   GET  /api/v3/coins/markets?per_page=...&page=...
+//   GET  /api/v3/simple/price?ids=...
+//   GET  /api/v3/coins/{id}/market_chart?days=...
+//   GET  /api/v3/coins/{id}/market_chart/range?from=...&to=...
+//   GET  /api/v3/exchange_rates
+//   POST /chart/create
+//
+// Successful GETs carry an ETag and answer a matching If-None-Match with 304,
+// and bodies over 1 KiB are gzipped for clients that accept it.
+//
+// Responses are replayed from recorded bodies in --fixtures (coins_list.json,
+// coins.json, simple_price.json, market_chart.json, exchange_rates.json,
+// chart_create.json) when
+// present, and synthesized otherwise. For /simple/price only the requested
+// ids are returned; ids missing from the recording get a made-up quote (with
+// a 24h change when asked for one).
+//
+// Usage: mock_upstream [--port 8089] [--latency-ms 80] [--jitter-ms 40]
+//                      [--rate-429 0.0] [--coins 15000] [--fixtures DIR]
+//                      [--compress 1]
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+struct options {
+    int port = 8089;
+    int latency_ms = 80;
+    int jitter_ms = 40;
+    double rate_429 = 0.0;
+    size_t coins = 15000;
+    std::string fixtures;
+    bool compress = true;
+};
+
+options opts;
+std::unordered_map<std::string, std::string> recorded;
+std::atomic<uint64_t> served{0};
+std::atomic<uint64_t> throttled{0};
+
+struct http_request {
+    std::string method;
+    std::string path;
+    std::string query;
+    // Names lowercased
+    std::map<std::string, std::string> headers;
+    std::string body;
+};
+
+struct http_response {
+    int status = 200;
+    std::string body;
+    std::vector<std::string> headers;
+};
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return "";
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+void load_fixtures() {
+    if (opts.fixtures.empty()) return;
+    for (const char* name : {"coins_list.json", "coins.json", "simple_price.json", "market_chart.json",
+                             "exchange_rates.json", "chart_create.json"}) {
+        std::string body = read_file(opts.fixtures + "/" + name);
+        if (body.empty()) continue;
+        recorded[name] = std::move(body);
+        std::printf("replaying %s/%s\n", opts.fixtures.c_str(), name);
+    }
+}
+
+std::string url_decode(const std::string& text) {
+    std::string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '%' && i + 2 < text.size()) {
+            out += static_cast<char>(std::strtol(text.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out += text[i];
+        }
+    }
+    return out;
+}
+
+std::string query_param(const std::string& query, const std::string& name) {
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+        std::string pair = query.substr(pos, end - pos);
+        if (pair.compare(0, name.size() + 1, name + "=") == 0) return url_decode(pair.substr(name.size() + 1));
+        pos = end + 1;
+    }
+    return "";
+}
+
+// Deterministic made-up price for a coin id
+double synthetic_price(const std::string& id) {
+    size_t h = std::hash<std::string>{}(id);
+    return static_cast<double>(h % 10000000) / 100.0 + 0.01;
+}
+
+std::string coins_list(size_t count) {
+    std::string out = "[";
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) out += ',';
+        // Every 50th symbol is shared, like real tickers
+        std::string symbol = i % 50 == 0 ? "dup" : "c" + std::to_string(i);
+        out += R"({"id":"coin-)" + std::to_string(i) + R"(","symbol":")" + symbol + R"(","name":"Coin )" +
+               std::to_string(i) + R"("})";
+    }
+    return out + "]";
+}
+
+// Ranked by coin number: coin-0 has the largest market cap
+std::string coins_markets(const std::string& query) {
+    long per_page = std::max(1L, std::strtol(query_param(query, "per_page").c_str(), nullptr, 10));
+    long page = std::max(1L, std::strtol(query_param(query, "page").c_str(), nullptr, 10));
+    std::string out = "[";
+    for (long rank = (page - 1) * per_page + 1; rank <= page * per_page && rank <= static_cast<long>(opts.coins);
+         rank++) {
+        if (out.size() > 1) out += ',';
+        std::string id = "coin-" + std::to_string(rank - 1);
+        out += R"({"id":")" + id + R"(","current_price":)" + std::to_string(synthetic_price(id)) +
+               R"(,"market_cap_rank":)" + std::to_string(rank) + "}";
+    }
+    return out + "]";
+}
+
+http_response simple_price(const std::string& query) {
+    std::string ids = query_param(query, "ids");
+    bool change = query_param(query, "include_24hr_change") == "true";
+    json recording = recorded.count("simple_price.json") ? json::parse(recorded.at("simple_price.json"), nullptr, false)
+                                                         : json::object();
+    json out = json::object();
+    size_t pos = 0;
+    while (pos <= ids.size() && !ids.empty()) {
+        size_t end = ids.find(',', pos);
+        if (end == std::string::npos) end = ids.size();
+        std::string id = ids.substr(pos, end - pos);
+        if (recording.is_object() && recording.contains(id)) {
+            out[id] = recording[id];
+        } else {
+            double usd = synthetic_price(id);
+            out[id] = {{"usd", usd}};
+            // Somewhere between -10% and +10%, fixed per coin
+            if (change) {
+                out[id]["usd_24h_change"] = static_cast<double>(std::hash<std::string>{}(id) % 2001) / 100.0 - 10.0;
+            }
+        }
+        pos = end + 1;
+    }
+    return {200, out.dump(), {}};
+}
+
+// A smooth made-up BTC-like price at Unix milliseconds `t`, so overlapping
+// /market_chart and /market_chart/range responses agree
+double chart_price(long t) {
+    double hours = static_cast<double>(t) / 3600000.0;
+    return 43000.0 + 800.0 * std::sin(hours / 9.0) + 150.0 * std::sin(hours * 1.7);
+}
+
+std::string chart_points(long from, long to, long step) {
+    std::string out = R"({"prices":[)";
+    bool first = true;
+    // Aligned so the last point is `to`
+    for (long t = from + (to - from) % step; t <= to; t += step) {
+        if (!first) out += ',';
+        first = false;
+        out += "[" + std::to_string(t) + "," + std::to_string(chart_price(t)) + "]";
+    }
+    return out + R"(],"market_caps":[],"total_volumes":[]})";
+}
+
+long now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// CoinGecko's granularity: 5 minute points for one day, hourly beyond
+std::string market_chart(const std::string& query) {
+    long days = std::max(1L, std::strtol(query_param(query, "days").c_str(), nullptr, 10));
+    long now = now_ms();
+    return chart_points(now - days * 86400000L, now, days == 1 ? 300000L : 3600000L);
+}
+
+// 5 minute points between `from` and `to` (Unix seconds), hourly past a day
+std::string market_chart_range(const std::string& query) {
+    long from = std::strtol(query_param(query, "from").c_str(), nullptr, 10) * 1000;
+    long to = std::min(now_ms(), std::strtol(query_param(query, "to").c_str(), nullptr, 10) * 1000);
+    if (to <= from) return R"({"prices":[],"market_caps":[],"total_volumes":[]})";
+    return chart_points(from, to, to - from <= 86400000L ? 300000L : 3600000L);
+}
+
+// A handful of currencies at fixed rates (units per BTC)
+std::string exchange_rates() {
+    struct rate {
+        const char* code;
+        const char* name;
+        const char* unit;
+        const char* type;
+        double per_btc;
+    };
+    static const rate rates[] = {
+        {"btc", "Bitcoin", "BTC", "crypto", 1.0},
+        {"eth", "Ether", "ETH", "crypto", 17.5},
+        {"usd", "US Dollar", "$", "fiat", 43000.0},
+        {"idr", "Indonesian Rupiah", "Rp", "fiat", 43000.0 * 16250.0},
+        {"eur", "Euro", "€", "fiat", 39600.0},
+        {"jpy", "Japanese Yen", "¥", "fiat", 6400000.0},
+        {"xau", "Gold - Troy Ounce", "XAU", "commodity", 20.4},
+    };
+    json out = json::object();
+    for (const auto& r : rates) {
+        out["rates"][r.code] = {{"name", r.name}, {"unit", r.unit}, {"value", r.per_btc}, {"type", r.type}};
+    }
+    return out.dump();
+}
+
+http_response route(const http_request& req) {
+    const std::string api = "/api/v3";
+    bool coingecko = req.path.compare(0, api.size(), api) == 0;
+
+    if (coingecko && opts.rate_429 > 0) {
+        thread_local std::mt19937 rng(std::random_device{}());
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < opts.rate_429) {
+            throttled++;
+            return {429, R"({"status":{"error_code":429,"error_message":"You've exceeded the Rate Limit."}})",
+                    {"Retry-After: 1"}};
+        }
+    }
+
+    if (req.method == "GET" && req.path == api + "/coins/list") {
+        if (recorded.count("coins_list.json")) return {200, recorded.at("coins_list.json"), {}};
+        static const std::string list = coins_list(opts.coins);
+        return {200, list, {}};
+    }
+    if (req.method == "GET" && req.path == api + "/coins/") {
+        if (recorded.count("coins.json")) return {200, recorded.at("coins.json"), {}};
+        static const std::string page = coins_list(100);
+        return {200, page, {}};
+    }
+    if (req.method == "GET" && req.path == api + "/coins/markets") {
+        return {200, coins_markets(req.query), {}};
+    }
+    if (req.method == "GET" && req.path == api + "/simple/price") {
+        return simple_price(req.query);
+    }
+    if (req.method == "GET" && req.path == api + "/exchange_rates") {
+        if (recorded.count("exchange_rates.json")) return {200, recorded.at("exchange_rates.json"), {}};
+        static const std::string rates = exchange_rates();
+        return {200, rates, {}};
+    }
+    if (req.method == "GET" && coingecko && req.path.size() > 13 &&
+        req.path.compare(req.path.size() - 13, 13, "/market_chart") == 0) {
+        if (recorded.count("market_chart.json")) return {200, recorded.at("market_chart.json"), {}};
+        return {200, market_chart(req.query), {}};
+    }
+    if (req.method == "GET" && coingecko && req.path.size() > 19 &&
+        req.path.compare(req.path.size() - 19, 19, "/market_chart/range") == 0) {
+        return {200, market_chart_range(req.query), {}};
+    }
+    if (req.method == "POST" && req.path == "/chart/create") {
+        if (recorded.count("chart_create.json")) return {200, recorded.at("chart_create.json"), {}};
+        return {200, R"({"success":true,"url":"http://127.0.0.1/chart/render/mock"})", {}};
+    }
+    return {404, R"({"error":"not found"})", {}};
+}
+
+// Read one request off a keep-alive connection. `buffer` carries bytes that
+// arrived past the end of the previous request.
+bool read_request(int fd, std::string& buffer, http_request& req) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        char chunk[8192];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+
+    std::string head = buffer.substr(0, header_end);
+    size_t line_end = head.find("\r\n");
+    std::istringstream request_line(head.substr(0, line_end));
+    std::string target;
+    request_line >> req.method >> target;
+    size_t question = target.find('?');
+    req.path = target.substr(0, question);
+    req.query = question == std::string::npos ? "" : target.substr(question + 1);
+
+    req.headers.clear();
+    std::istringstream headers(head.substr(line_end == std::string::npos ? head.size() : line_end + 2));
+    std::string line;
+    while (std::getline(headers, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = line.substr(0, colon);
+        for (char& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        size_t value_begin = line.find_first_not_of(" \t", colon + 1);
+        size_t value_end = line.find_last_not_of(" \t\r");
+        req.headers[name] = value_begin == std::string::npos ? "" : line.substr(value_begin, value_end - value_begin + 1);
+    }
+    size_t content_length = std::strtoul(req.headers["content-length"].c_str(), nullptr, 10);
+
+    size_t body_start = header_end + 4;
+    while (buffer.size() < body_start + content_length) {
+        char chunk[8192];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    req.body = buffer.substr(body_start, content_length);
+    buffer.erase(0, body_start + content_length);
+    return true;
+}
+
+std::string gzip(const std::string& data) {
+    z_stream stream{};
+    // 16 + MAX_WBITS asks for a gzip header instead of a zlib one
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+// Validators and compression for successful GETs, like CoinGecko's CDN does
+http_response finish(const http_request& req, http_response res) {
+    if (req.method != "GET" || res.status != 200) return res;
+
+    char etag[24];
+    std::snprintf(etag, sizeof(etag), "\"%016zx\"", std::hash<std::string>{}(res.body));
+    res.headers.push_back(std::string("ETag: ") + etag);
+    auto match = req.headers.find("if-none-match");
+    if (match != req.headers.end() && match->second == etag) {
+        res.status = 304;
+        res.body.clear();
+        return res;
+    }
+
+    auto accept = req.headers.find("accept-encoding");
+    if (opts.compress && res.body.size() >= 1024 && accept != req.headers.end() &&
+        accept->second.find("gzip") != std::string::npos) {
+        res.body = gzip(res.body);
+        res.headers.push_back("Content-Encoding: gzip");
+    }
+    return res;
+}
+
+void write_response(int fd, const http_response& res) {
+    const char* reason = res.status == 200   ? "OK"
+                         : res.status == 304 ? "Not Modified"
+                         : res.status == 429 ? "Too Many Requests"
+                                             : "Not Found";
+    std::string out = "HTTP/1.1 " + std::to_string(res.status) + " " + reason + "\r\n";
+    out += "Content-Type: application/json\r\n";
+    out += "Content-Length: " + std::to_string(res.body.size()) + "\r\n";
+    for (const auto& header : res.headers) out += header + "\r\n";
+    out += "\r\n";
+    out += res.body;
+
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += n;
+    }
+}
+
+void serve_connection(int fd) {
+    thread_local std::mt19937 rng(std::random_device{}());
+    std::string buffer;
+    http_request req;
+    while (read_request(fd, buffer, req)) {
+        int jitter = opts.jitter_ms > 0 ? std::uniform_int_distribution<int>(-opts.jitter_ms, opts.jitter_ms)(rng) : 0;
+        int delay = std::max(0, opts.latency_ms + jitter);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+        write_response(fd, finish(req, route(req)));
+        served++;
+    }
+    close(fd);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        const char* value = argv[i + 1];
+        if (flag == "--port") {
+            opts.port = std::atoi(value);
+        } else if (flag == "--latency-ms") {
+            opts.latency_ms = std::atoi(value);
+        } else if (flag == "--jitter-ms") {
+            opts.jitter_ms = std::atoi(value);
+        } else if (flag == "--rate-429") {
+            opts.rate_429 = std::atof(value);
+        } else if (flag == "--coins") {
+            opts.coins = std::strtoul(value, nullptr, 10);
+        } else if (flag == "--fixtures") {
+            opts.fixtures = value;
+        } else if (flag == "--compress") {
+            opts.compress = std::atoi(value) != 0;
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    load_fixtures();
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(opts.port));
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 128) != 0) {
+        std::perror("mock_upstream: listen");
+        return 1;
+    }
+
+    std::printf("mock_upstream listening on 127.0.0.1:%d (latency %d+-%d ms, 429 rate %.2f)\n", opts.port,
+                opts.latency_ms, opts.jitter_ms, opts.rate_429);
+    std::fflush(stdout);
+
+    std::thread([] {
+        uint64_t last = 0;
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::seconds(5));
+            uint64_t now = served;
+            if (now != last) std::printf("served=%llu throttled=%llu\n", (unsigned long long)now, (unsigned long long)throttled.load());
+            std::fflush(stdout);
+            last = now;
+        }
+    }).detach();
+
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::thread(serve_connection, fd).detach();
+    }
+}
@@ -0,0 +1,115 @@
+// Compares the old buffered-DOM handling of /coins/list with the streaming
+// SAX parser used by gecko::coin_index. Each mode runs in its own child
+// process so peak RSS can be compared.
+//
+// Usage: parse_bench [coins]
+
+#include <coin_index.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace {
+
+constexpr size_t kChunkSize = 16 * 1024;
+constexpr int kIterations = 5;
+
+// Produce a synthetic /coins/list payload in network-sized chunks, so the
+// streaming mode never holds the whole document
+void generate_coins_list(size_t coins, const std::function<void(const char*, size_t)>& sink) {
+    std::string chunk;
+    chunk.reserve(kChunkSize + 256);
+    chunk += '[';
+    for (size_t i = 0; i < coins; i++) {
+        if (i > 0) chunk += ',';
+        chunk += "{\"id\":\"coin-number-" + std::to_string(i) + "\",\"symbol\":\"SYM" +
+                 std::to_string(i % 9000) + "\",\"name\":\"Coin Number " + std::to_string(i) + "\"}";
+        if (chunk.size() >= kChunkSize) {
+            sink(chunk.data(), chunk.size());
+            chunk.clear();
+        }
+    }
+    chunk += ']';
+    sink(chunk.data(), chunk.size());
+}
+
+size_t run_dom(size_t coins) {
+    std::string body;
+    generate_coins_list(coins, [&](const char* data, size_t size) { body.append(data, size); });
+
+    gecko::coin_index::symbol_map index;
+    json coins_list = json::parse(body);
+    for (const auto& coin : coins_list) {
+        std::string symbol = coin["symbol"].get<std::string>();
+        std::transform(symbol.begin(), symbol.end(), symbol.begin(), ::tolower);
+        index[symbol].push_back({coin["id"].get<std::string>(), coin["name"].get<std::string>()});
+    }
+    return index.size();
+}
+
+size_t run_stream(size_t coins) {
+    gecko::coin_index::symbol_map index;
+    gecko::coin_list_handler handler(index);
+    jsonstream::parser parser(handler);
+
+    generate_coins_list(coins, [&](const char* data, size_t size) { parser.feed(data, size); });
+    if (!parser.finish()) {
+        std::fprintf(stderr, "stream parse failed: %s\n", parser.error().c_str());
+        std::exit(1);
+    }
+    return index.size();
+}
+
+long peak_rss_kb() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void measure(const char* mode, size_t (*run)(size_t), size_t coins) {
+    long rss_before = peak_rss_kb();
+
+    size_t symbols = 0;
+    double total_ms = 0;
+    for (int i = 0; i < kIterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        symbols = run(coins);
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::printf("%-7s coins=%zu symbols=%zu avg=%.2f ms peak_rss_growth=%ld KB\n",
+                mode, coins, symbols, total_ms / kIterations, peak_rss_kb() - rss_before);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t coins = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 15000;
+
+    size_t payload = 0;
+    generate_coins_list(coins, [&](const char*, size_t size) { payload += size; });
+    std::printf("payload: %zu bytes\n", payload);
+
+    const std::pair<const char*, size_t (*)(size_t)> modes[] = {{"dom", run_dom}, {"stream", run_stream}};
+    for (const auto& [mode, run] : modes) {
+        std::fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            measure(mode, run, coins);
+            std::fflush(stdout);
+            std::_Exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <coingecko.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// Rendered /market charts (the QuickChart URL or the local PNG), keyed by
+// coin, currency, range and time bucket.
+//
+// Every request for the same chart within one bucket gets the same reply, so
+// when a coin trends and a whole server charts it at once only the first
+// request renders; concurrent ones wait on that render instead of starting
+// their own. Buckets are `bucket` long for 1d charts and scale with the
+// range (7x for 7d, 30x for 30d). Entries are dropped least recently used
+// first once their size passes `max_bytes`, and as soon as their bucket ends.
+class chart_cache {
+public:
+    // Renders the chart and hands the reply to the callback
+    using render_fn = std::function<void(reply_callback)>;
+
+    struct stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t coalesced = 0;
+        uint64_t evictions = 0;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+    static chart_cache& instance();
+
+    void configure(std::chrono::seconds bucket, size_t max_bytes);
+
+    // The cached chart for `token_id` in `currency` (lowercase) over `range`,
+    // or the result of `render` when there is none. Failed renders aren't
+    // cached. `done` runs on the calling thread on a hit, otherwise wherever
+    // `render` completes.
+    void fetch(const std::string& token_id, const std::string& currency, chart_range range, render_fn render,
+               reply_callback done);
+
+    stats get_stats() const;
+
+private:
+    using clock = std::chrono::system_clock;
+
+    struct entry {
+        std::string key;
+        reply chart;
+        clock::time_point expires_at;
+        size_t bytes = 0;
+    };
+
+    chart_cache() = default;
+    chart_cache(const chart_cache&) = delete;
+    chart_cache& operator=(const chart_cache&) = delete;
+
+    void complete(const std::string& key, clock::time_point expires_at, const reply& chart);
+    void erase(std::list<entry>::iterator it);
+    void evict(clock::time_point now);
+
+    mutable std::mutex mutex_;
+    std::chrono::seconds bucket_{60};
+    size_t max_bytes_ = 32 << 20;
+    // Most recently used first
+    std::list<entry> lru_;
+    std::unordered_map<std::string, std::list<entry>::iterator> entries_;
+    size_t bytes_ = 0;
+    // Waiters of each in-flight render
+    std::unordered_map<std::string, std::vector<reply_callback>> in_flight_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t coalesced_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+}  // namespace gecko
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <json_stream.h>
+#include <rate_limiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+struct coin_entry {
+    std::string id;
+    std::string name;
+};
+
+class coin_listing;
+class coin_search;
+
+// In-memory symbol -> [(id, name)] index over CoinGecko's /coins/list.
+//
+// The index is published as an immutable snapshot. Lookups grab the current
+// snapshot and never touch the network; a background thread rebuilds the
+// snapshot on an interval and swaps it in, so readers keep using the old one
+// until the new one is complete.
+class coin_index {
+public:
+    using symbol_map = std::unordered_map<std::string, std::vector<coin_entry>>;
+    // CoinGecko id -> market cap rank (1 is the largest)
+    using rank_map = std::unordered_map<std::string, uint32_t>;
+
+    static coin_index& instance();
+
+    // Rank autocomplete suggestions by market cap, taken from the first
+    // `ranked_coins` entries of `markets_url` (CoinGecko's /coins/markets) on
+    // every refresh. 0 turns ranking off. Call before start().
+    void configure_ranking(const std::string& markets_url, size_t ranked_coins);
+
+    // Build the index once (blocking) and start the background refresh thread.
+    // Refreshes count against `limiter` at background priority. `list_url`
+    // overrides CoinGecko's /coins/list endpoint. If an index was restored
+    // beforehand, start() doesn't block and the first refresh is due one
+    // interval after that index was built.
+    void start(std::chrono::seconds refresh_interval, http::rate_limiter* limiter = nullptr,
+               const std::string& list_url = "");
+    void stop();
+
+    // True once at least one snapshot has been published
+    bool ready() const;
+
+    // Lookup by lowercase symbol (without the leading '$')
+    std::vector<coin_entry> find(const std::string& symbol) const;
+
+    // The current snapshot (nullptr before the first one) and when it was built
+    std::shared_ptr<const symbol_map> snapshot() const;
+    std::chrono::system_clock::time_point built_at() const;
+
+    // Prefix index for autocomplete over the current snapshot (nullptr before the first one)
+    std::shared_ptr<const coin_search> search() const;
+
+    // Pre-rendered /coins pages over the current snapshot (nullptr before the first one)
+    std::shared_ptr<const coin_listing> listing() const;
+
+    // Market cap ranks the search index was built with (nullptr if none)
+    std::shared_ptr<const rank_map> ranks() const;
+
+    // Publish a previously saved index, e.g. from disk at startup. Without
+    // `ranks` the current ones are kept.
+    void restore(std::shared_ptr<const symbol_map> index, std::chrono::system_clock::time_point built_at,
+                 std::shared_ptr<const rank_map> ranks = nullptr);
+
+    // Download /coins/list (and the market cap ranks) and swap in a new
+    // snapshot. Returns false (and keeps the current snapshot) on any
+    // failure; failing to fetch ranks only keeps the previous ranks.
+    //
+    // The list is revalidated with the ETag / Last-Modified of the one the
+    // current snapshot was built from, so an unchanged list costs a 304 and
+    // no parsing. A list that did change is diffed against the snapshot, and
+    // only the coins added or removed are applied to a copy of it. Nothing
+    // is rebuilt unless there were any (or the ranks moved).
+    bool refresh();
+
+    ~coin_index();
+
+private:
+    coin_index() = default;
+    coin_index(const coin_index&) = delete;
+    coin_index& operator=(const coin_index&) = delete;
+
+    void run(std::chrono::seconds refresh_interval);
+    std::shared_ptr<const rank_map> fetch_ranks();
+    // Publish `ranks` over the current snapshot if they differ from the current ones
+    void update_ranks(std::shared_ptr<const rank_map> ranks);
+
+    std::shared_ptr<const symbol_map> snapshot_;
+    std::shared_ptr<const rank_map> ranks_;
+    std::shared_ptr<const coin_search> search_;
+    std::shared_ptr<const coin_listing> listing_;
+    // Unix milliseconds
+    std::atomic<int64_t> built_at_ms_{0};
+    http::rate_limiter* limiter_ = nullptr;
+    std::string list_url_ = "https://api.coingecko.com/api/v3/coins/list";
+    std::string markets_url_ = "https://api.coingecko.com/api/v3/coins/markets";
+    size_t ranked_coins_ = 0;
+
+    // Validators and cost of the /coins/list response the current snapshot
+    // was built from. Only touched by refresh().
+    std::string list_etag_;
+    std::string list_last_modified_;
+    uint64_t list_received_bytes_ = 0;
+    std::chrono::steady_clock::duration list_parse_time_{0};
+
+    std::thread worker_;
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    bool stopping_ = false;
+};
+
+// Streams /coins/list ([{"id", "symbol", "name", ...}, ...]) straight into a
+// symbol map, keeping only the three fields we need
+class coin_list_handler : public jsonstream::sax_handler {
+public:
+    explicit coin_list_handler(coin_index::symbol_map& index);
+
+    size_t coins() const { return coins_; }
+
+    bool start_array(std::size_t) override;
+    bool end_array() override;
+    bool start_object(std::size_t) override;
+    bool end_object() override;
+    bool key(string_t& key) override;
+    bool string(string_t& value) override;
+
+private:
+    coin_index::symbol_map& index_;
+    int depth_ = 0;
+    size_t coins_ = 0;
+
+    std::string id_;
+    std::string symbol_;
+    std::string name_;
+    std::string* field_ = nullptr;
+};
+
+// Streams a /coins/markets page ([{"id", "market_cap_rank", ...}, ...]) into
+// a rank map. Coins without a rank are left out.
+class market_rank_handler : public jsonstream::sax_handler {
+public:
+    explicit market_rank_handler(coin_index::rank_map& ranks);
+
+    size_t coins() const { return coins_; }
+
+    bool start_array(std::size_t) override;
+    bool end_array() override;
+    bool start_object(std::size_t) override;
+    bool end_object() override;
+    bool key(string_t& key) override;
+    bool string(string_t& value) override;
+    bool number_integer(number_integer_t value) override;
+    bool number_unsigned(number_unsigned_t value) override;
+
+private:
+    coin_index::rank_map& ranks_;
+    int depth_ = 0;
+    size_t coins_ = 0;
+
+    enum class field { none, id, rank };
+    field field_ = field::none;
+    std::string id_;
+    uint64_t rank_ = 0;
+};
+
+}  // namespace gecko
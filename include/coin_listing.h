@@ -0,0 +1,42 @@
+#pragma once
+
+#include <coin_index.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace gecko {
+
+enum class listing_order { market_cap = 0, name = 1 };
+
+// "market_cap" / "name", as used in /coins options and button ids
+const char* order_key(listing_order order);
+bool parse_order(const std::string& key, listing_order& out);
+
+// Every coin in the index as numbered, ready-to-send /coins pages.
+//
+// Pages are rendered once per coin index snapshot for each sort order, so
+// turning a page is an array lookup with no upstream fetch. Every page fits
+// in one Discord message.
+class coin_listing {
+public:
+    static constexpr size_t kPageSize = 15;
+
+    coin_listing(const coin_index::symbol_map& index, const coin_index::rank_map& ranks,
+                 std::chrono::system_clock::time_point built_at);
+
+    size_t pages() const { return pages_[0].size(); }
+    size_t size() const { return coins_; }
+
+    // Page `index` (0-based, clamped to the last page) in `order`
+    const std::string& page(listing_order order, size_t index) const;
+
+private:
+    size_t coins_ = 0;
+    // One vector of rendered pages per listing_order
+    std::vector<std::string> pages_[2];
+};
+
+}  // namespace gecko
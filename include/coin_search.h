@@ -0,0 +1,70 @@
+#pragma once
+
+#include <coin_index.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gecko {
+
+// One autocomplete suggestion: what Discord shows and what the option is set to
+struct completion {
+    std::string name;
+    std::string value;
+};
+
+// Immutable prefix index over the coin list for autocomplete.
+//
+// Symbols, ids and lowercased names sit in three sorted arrays; a query
+// binary-searches each one for the typed prefix and keeps the best-ranked
+// matches. Coins are numbered in rank order (market cap rank, unranked coins
+// last, then shorter ids first), so ranking a set of matches is sorting
+// small integers. Built once per coin index snapshot, never touched by the
+// network.
+class coin_search {
+public:
+    // Discord accepts at most 25 choices per autocomplete reply
+    static constexpr size_t kMaxChoices = 25;
+
+    coin_search(const coin_index::symbol_map& index, const coin_index::rank_map& ranks);
+
+    // Ticker symbols starting with `prefix` (a leading '$' is ignored), one
+    // suggestion per symbol; the value is the symbol
+    std::vector<completion> tickers(std::string_view prefix, size_t limit = kMaxChoices) const;
+
+    // Coins whose id, symbol or name starts with `prefix`; the value is the CoinGecko id
+    std::vector<completion> coins(std::string_view prefix, size_t limit = kMaxChoices) const;
+
+    size_t size() const { return coins_.size(); }
+
+private:
+    struct coin {
+        std::string id;
+        std::string symbol;
+        std::string name;
+        uint32_t rank;
+    };
+
+    struct key {
+        std::string text;
+        // Index into coins_, which is also the coin's rank order
+        uint32_t coin;
+    };
+
+    using key_range = std::pair<std::vector<key>::const_iterator, std::vector<key>::const_iterator>;
+
+    static key_range find(const std::vector<key>& keys, std::string_view prefix);
+
+    // Sorted in rank order
+    std::vector<coin> coins_;
+    // Suggestions before anything is typed, which is every autocomplete's first query
+    std::vector<completion> top_tickers_;
+    // Sorted by text, then rank order
+    std::vector<key> by_symbol_;
+    std::vector<key> by_id_;
+    std::vector<key> by_name_;
+};
+
+}  // namespace gecko
@@ -1,15 +1,163 @@
-#include <curl/curl.h>
+#pragma once
+
+#include <coin_listing.h>
 #include <dpp/dpp.h>
+#include <http_client.h>
+#include <rate_limiter.h>
+#include <series_store.h>
 
+#include <cstdint>
 #include <cstdlib>
-#include <iostream>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
 namespace gecko {
-    void fetch_tokens(dpp::slashcommand_t event);
-    void fetch_price(dpp::slashcommand_t event);
-    void fetch_single_price(const std::string& coingecko_id, const dpp::interaction_create_t& event);
-    void fetch_market_chart(dpp::slashcommand_t event);
-    size_t write_callback(char* ptr, size_t size, size_t nmemb, std::string* data);
+    // Only USD is stored; other currencies are converted when shown (see idr_price)
+    struct price_quote {
+        double usd = 0;
+        // Decimal places to display, taken from CoinGecko's own representation
+        int usd_precision = 0;
+        // USD price change over the last 24 hours, in percent, when CoinGecko sent one
+        bool has_change = false;
+        double usd_24h_change = 0;
+    };
+
+    // `quote` in IDR at the current exchange rate, or zero until the rates have loaded
+    double idr_price(const price_quote& quote);
+
+    struct price_result {
+        bool ok = false;
+        price_quote quote;
+        // User-facing error message when !ok
+        std::string error;
+        // Set when the upstream fetch failed and an older cached quote was
+        // served instead
+        bool stale = false;
+    };
+
+    // Per-id results of a multi-id /simple/price request
+    using quote_map = std::unordered_map<std::string, price_result>;
+
+    // Where /market charts are rendered
+    enum class chart_backend {
+        quickchart,  // POST to quickchart.io and reply with the chart URL
+        local,       // rasterize in-process and attach the PNG
+    };
+
+    struct chart_options {
+        chart_backend backend = chart_backend::quickchart;
+        // Price series are downsampled to at most this many points
+        size_t max_points = 250;
+    };
+
+    // A finished command reply, independent of how it's delivered
+    struct reply {
+        bool ok = false;
+        // Message text; the user-facing error when !ok
+        std::string content;
+        // Optional attachment
+        std::string file_name;
+        std::string file_data;
+        std::string file_type;
+        // Optional embeds, shown below the text
+        std::vector<dpp::embed> embeds;
+    };
+
+    using reply_callback = std::function<void(const reply&)>;
+
+    // CoinGecko API root, e.g. to point the bot at a local stand-in. Call once
+    // at startup; defaults to https://api.coingecko.com/api/v3.
+    void configure_base_url(const std::string& url);
+    const std::string& base_url();
+
+    // Configure /market charts. Call once at startup.
+    void configure_charts(const chart_options& options);
+
+    // Budget shared by every CoinGecko request. Call once at startup, before
+    // any request is made; without it requests are not rate limited.
+    void configure_rate_limit(double requests_per_minute, double burst);
+
+    // The CoinGecko rate limiter, or nullptr when none is configured
+    http::rate_limiter* rate_limiter();
+
+    // The work behind each command, without the Discord interaction. `done`
+    // runs on the HTTP event loop thread, or on the calling thread when the
+    // result was already at hand.
+    // `currency` is any code from the exchange rate table (see fx_rates.h),
+    // or empty for USD and IDR
+    bool cached_price_reply(const std::string& coingecko_id, const std::string& currency, reply& out);
+    void price_reply(const std::string& coingecko_id, const std::string& currency, reply_callback done);
+    // Page `page` (0-based) of the pre-rendered coin listing
+    reply coins_reply(listing_order order, size_t page);
+    void market_chart_reply(const std::string& token_id, const std::string& currency, chart_range range,
+                            reply_callback done);
+
+    // Price alerts (see price_alerts.h); `currency` is "usd" or "idr". The
+    // alert fires when the price moves from where it is now to `target`.
+    void alert_reply(uint64_t user_id, uint64_t channel_id, const std::string& coingecko_id, double target,
+                     const std::string& currency, reply_callback done);
+    reply alerts_reply(uint64_t user_id);
+    reply unalert_reply(uint64_t user_id, uint64_t alert_id);
+
+    // Price table of several coins (see watchlists.h). `coins` lists tickers
+    // and CoinGecko ids separated by spaces or commas; when it is empty
+    // `user_id`'s watchlist is shown.
+    void prices_reply(uint64_t user_id, const std::string& coins, const std::string& currency, reply_callback done);
+    // Add or remove watchlist coins, listed the same way. Only coins with a
+    // price are added.
+    void watch_reply(uint64_t user_id, const std::string& coins, reply_callback done);
+    reply unwatch_reply(uint64_t user_id, const std::string& coins);
+
+    // Live ticker messages (see ticker_board.h) in `channel_id`
+    reply tickers_reply(uint64_t channel_id);
+    reply untick_reply(uint64_t channel_id, uint64_t ticker_id);
+
+    // Slash command handlers, run by the command router (see command_router.h)
+    void ping(const dpp::slashcommand_t& event);
+    void fetch_tokens(const dpp::slashcommand_t& event);
+    // The /coins page buttons
+    void turn_coins_page(const dpp::button_click_t& event);
+    void fetch_price(const dpp::slashcommand_t& event);
+    void fetch_single_price(const std::string& coingecko_id, const std::string& currency,
+                            const dpp::interaction_create_t& event);
+    void fetch_market_chart(const dpp::slashcommand_t& event);
+    void fetch_prices(const dpp::slashcommand_t& event);
+    void watch_coins(const dpp::slashcommand_t& event);
+    void unwatch_coins(const dpp::slashcommand_t& event);
+    void create_alert(const dpp::slashcommand_t& event);
+    void list_alerts(const dpp::slashcommand_t& event);
+    void remove_alert(const dpp::slashcommand_t& event);
+    void create_ticker(dpp::cluster& bot, const dpp::slashcommand_t& event);
+    void list_tickers(const dpp::slashcommand_t& event);
+    void remove_ticker(const dpp::slashcommand_t& event);
+
+    // Suggest tickers for /price ticker and CoinGecko ids for /price
+    // coingecko_id and /market token_id, straight from the coin index, and
+    // currency codes from the exchange rate table
+    void autocomplete(dpp::cluster& bot, const dpp::autocomplete_t& event);
+
+    // Whether `coingecko_id` looks like a CoinGecko id (lowercase letters,
+    // digits, '-', '.' and '_'), so it can go into a request URL as-is
+    bool valid_id(const std::string& coingecko_id);
+
+    // Fetch prices for one coin, bypassing the cache. Lookups are
+    // micro-batched with other concurrent ones into a single request.
+    void fetch_quote(const std::string& coingecko_id, std::function<void(const price_result&)> done);
+
+    // Fetch prices for several coins with one /simple/price request. Only
+    // USD (and its 24h change) is requested; other currencies are converted
+    // locally when shown. The result has an entry for every requested id;
+    // ids that aren't valid_id() are reported as not found without being
+    // sent.
+    void fetch_quotes(const std::vector<std::string>& ids, std::function<void(const quote_map&)> done,
+                      http::priority prio = http::priority::interactive);
+
+    // Fetch USD price history for one coin: `days` days (5 minute points for
+    // one day, hourly beyond), or with no days the points after `from_ms`
+    void fetch_price_history(const std::string& coingecko_id, int days, int64_t from_ms,
+                             std::function<void(const price_history&)> done);
 }  // namespace gecko
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <dpp/dpp.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Slash command dispatch.
+//
+// D++ event threads only look the command up and queue it; a fixed pool of
+// workers runs the handlers. Each command has its own queue and a cap on how
+// many of it may run at once, so a burst of /market can't take every worker
+// from /price. A command holds its slot until its reply is sent when the
+// handler keeps a hold() token alive for the asynchronous part.
+//
+// Admission is deadline aware: a command that can't start before its
+// acknowledgement budget runs out is deferred with thinking() right away (or
+// as soon as the budget runs out while it waits), so Discord never drops it.
+// A command whose queue is full is turned away with a short "busy" reply
+// instead of piling up.
+namespace commands {
+
+using handler = std::function<void(const dpp::slashcommand_t& event)>;
+
+struct route {
+    std::string name;
+    // Commands of this kind allowed to run (or hold a slot) at once
+    size_t max_running = 4;
+    // Commands allowed to wait for a slot before new ones are turned away
+    size_t max_queued = 64;
+    // Defer with an ephemeral "thinking..." when the command replies ephemerally
+    bool ephemeral = false;
+    handler run;
+};
+
+struct stats {
+    uint64_t dispatched = 0;
+    // Acknowledged with thinking() by the router rather than the handler
+    uint64_t deferred = 0;
+    // Turned away because their queue was full
+    uint64_t shed = 0;
+    // Dropped because Discord's deadline passed before they could be acknowledged
+    uint64_t expired = 0;
+    uint64_t queued = 0;
+    uint64_t running = 0;
+};
+
+// Register `routes` and start `workers` threads. Commands still waiting
+// `ack_budget` after Discord created them are deferred.
+void start(std::vector<route> routes, size_t workers, std::chrono::milliseconds ack_budget);
+void stop();
+
+// Queue `event` for its route. Unknown commands are logged and ignored.
+void dispatch(const dpp::slashcommand_t& event);
+
+// Whether the command running on this thread was already deferred by the
+// router, so the handler has to edit the response instead of replying
+bool deferred();
+
+// Keep the running command's slot until the returned token is destroyed.
+// Capture it in the completion callback of asynchronous work. Returns
+// nullptr outside a routed command.
+std::shared_ptr<void> hold();
+
+// Record how long after Discord created the interaction it was acknowledged.
+// Measured from the interaction id's timestamp, so gateway delay counts too.
+void record_ack(const dpp::interaction_create_t& event, const std::string& command);
+
+stats get_stats();
+
+}  // namespace commands
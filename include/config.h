@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace config {
+    // Read an environment variable, falling back to `fallback` when it's unset or empty
+    std::string get_string(const char* name, const std::string& fallback);
+
+    // Read a numeric environment variable, falling back to `fallback` when it's
+    // unset or not a valid number
+    long get_long(const char* name, long fallback);
+
+    // Like get_long, for counts and sizes: negative values also fall back
+    size_t get_size(const char* name, size_t fallback);
+}  // namespace config
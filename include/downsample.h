@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace downsample {
+
+// Reduce a time series to at most `target` points with
+// Largest-Triangle-Three-Buckets. The first and last points are always kept,
+// and each bucket keeps the point that spans the largest triangle with its
+// neighbours, which preserves peaks and troughs. Series that already fit, or
+// a target below 3, are left untouched.
+void lttb(std::vector<long>& timestamps, std::vector<double>& values, size_t target);
+
+}  // namespace downsample
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <json_stream.h>
+#include <rate_limiter.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// One row of CoinGecko's /exchange_rates
+struct currency_rate {
+    std::string name;
+    // Display symbol, e.g. "$", "€", "Rp"
+    std::string unit;
+    // "fiat", "crypto" or "commodity"
+    std::string type;
+    // Units of this currency per 1 BTC
+    double per_btc = 0;
+};
+
+// Exchange rates for converting USD prices into any currency CoinGecko
+// quotes, so upstream price requests stay in USD only and every other
+// currency is a local multiplication.
+//
+// Like coin_index, the table is an immutable snapshot swapped in by a
+// background refresh; readers never touch the network.
+class fx_rates {
+public:
+    // Lowercase currency code -> rate
+    using rate_map = std::unordered_map<std::string, currency_rate>;
+
+    static fx_rates& instance();
+
+    // Load the table once (blocking, unless one was restored) and refresh it
+    // every `refresh_interval` at background priority
+    void start(std::chrono::seconds refresh_interval, http::rate_limiter* limiter, const std::string& url);
+    void stop();
+
+    bool ready() const;
+
+    // Convert a USD amount into `currency` (lowercase code). Returns false
+    // for an unsupported currency or before the first table is loaded.
+    bool from_usd(double usd, const std::string& currency, double& out) const;
+
+    // Look up `currency`'s rate. Returns false if it isn't supported.
+    bool find(const std::string& currency, currency_rate& out) const;
+
+    // Supported currency codes starting with `prefix`, fiat first, then alphabetical
+    std::vector<std::string> codes(const std::string& prefix, size_t limit) const;
+
+    std::shared_ptr<const rate_map> snapshot() const;
+    std::chrono::system_clock::time_point built_at() const;
+
+    // Publish a previously saved table, e.g. from disk at startup
+    void restore(std::shared_ptr<const rate_map> rates, std::chrono::system_clock::time_point built_at);
+
+    // Download /exchange_rates and swap in a new table. Returns false (and
+    // keeps the current table) on any failure.
+    bool refresh();
+
+    ~fx_rates();
+
+private:
+    fx_rates() = default;
+    fx_rates(const fx_rates&) = delete;
+    fx_rates& operator=(const fx_rates&) = delete;
+
+    void run(std::chrono::seconds refresh_interval);
+
+    std::shared_ptr<const rate_map> rates_;
+    // Unix milliseconds
+    std::atomic<int64_t> built_at_ms_{0};
+    http::rate_limiter* limiter_ = nullptr;
+    std::string url_ = "https://api.coingecko.com/api/v3/exchange_rates";
+
+    std::thread worker_;
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    bool stopping_ = false;
+};
+
+// Streams /exchange_rates ({"rates": {"usd": {"name", "unit", "value",
+// "type"}, ...}}) into a rate map
+class exchange_rates_handler : public jsonstream::sax_handler {
+public:
+    explicit exchange_rates_handler(fx_rates::rate_map& rates);
+
+    bool start_object(std::size_t) override;
+    bool end_object() override;
+    bool start_array(std::size_t) override;
+    bool end_array() override;
+    bool key(string_t& key) override;
+    bool string(string_t& value) override;
+    bool number_integer(number_integer_t value) override;
+    bool number_unsigned(number_unsigned_t value) override;
+    bool number_float(number_float_t value, const string_t&) override;
+
+private:
+    void number(double value);
+
+    fx_rates::rate_map& rates_;
+    int depth_ = 0;
+    bool in_rates_ = false;
+
+    std::string code_;
+    currency_rate rate_;
+    std::string* field_ = nullptr;
+    bool value_field_ = false;
+};
+
+}  // namespace gecko
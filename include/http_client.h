@@ -0,0 +1,147 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <rate_limiter.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Shared libcurl connection layer used by gecko:: and qchart::.
+//
+// Responses are requested with every content encoding libcurl was built with
+// (gzip and deflate always, brotli and zstd when available) and decoded
+// before they reach the caller or its on_data sink.
+//
+// Every thread keeps one reusable easy handle, and all handles are attached
+// to a process-wide curl_share so DNS lookups and TLS sessions for
+// api.coingecko.com / quickchart.io survive across requests. Open
+// connections are not shared: the multi event loop keeps its own pool, and
+// each thread's handle keeps the connections it opened.
+//
+// Interaction handlers use the asynchronous API: requests are queued to a
+// single curl multi event loop and the callback runs on that loop's thread
+// once the transfer completes, so D++ threads never wait on the network.
+// Callbacks must not block; chaining another async request is fine.
+//
+// Queued requests start in priority order. Requests tagged with a
+// rate_limiter only start when it grants a token, and a 429 response is
+// retried after the upstream's Retry-After as long as the request's max_wait
+// allows; otherwise it completes with response::throttled set.
+//
+// All of that lives in the default libcurl backend. set_backend() swaps the
+// transport out, e.g. for an in-process fake in tests or benchmarks.
+namespace http {
+
+enum class priority {
+    interactive = 0,  // a user is waiting on a deferred interaction
+    normal = 1,       // slower commands like /market
+    background = 2,   // periodic refreshes
+};
+
+struct request {
+    std::string url;
+    bool post = false;
+    std::string body;
+    std::vector<std::string> headers;
+    // Optional streaming sink. When set, the response body is handed over
+    // chunk by chunk as it arrives instead of being buffered into
+    // response::body. Returning false aborts the transfer. 429 bodies are
+    // always buffered, since they get retried.
+    std::function<bool(const char* data, size_t size)> on_data;
+
+    priority prio = priority::normal;
+    // Upstream budget this request counts against, if any
+    rate_limiter* limiter = nullptr;
+    // How long the request may wait for a rate limit token or a 429 retry
+    std::chrono::milliseconds max_wait{15000};
+};
+
+struct response {
+    CURLcode code = CURLE_OK;
+    long status = 0;
+    std::string body;
+    // Response headers, names lowercased
+    std::map<std::string, std::string> headers;
+    // Body size as transferred (compressed, when the upstream compressed it)
+    // and after decoding
+    uint64_t received_bytes = 0;
+    uint64_t decoded_bytes = 0;
+    // Set when the request was dropped because the async queue was full
+    bool shed = false;
+    // Set when the rate limiter couldn't fit the request within its max_wait
+    bool throttled = false;
+
+    bool ok() const { return code == CURLE_OK && !shed && !throttled; }
+    std::string error() const {
+        if (shed) return "upstream request queue is full";
+        if (throttled) return "upstream rate limit exceeded";
+        return curl_easy_strerror(code);
+    }
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+};
+
+using callback = std::function<void(response)>;
+
+// Transport behind perform() and perform_async()
+class backend {
+public:
+    virtual ~backend() = default;
+
+    // Blocking transfer. Never called from an async callback.
+    virtual response perform(const request& req) = 0;
+
+    // Start a transfer; `done` runs once it completes, on any thread
+    virtual void perform_async(request req, callback done) = 0;
+};
+
+struct stats {
+    uint64_t requests = 0;
+    uint64_t failures = 0;
+    uint64_t new_connections = 0;
+    uint64_t reused_connections = 0;
+    uint64_t shed = 0;
+    uint64_t throttled = 0;
+    uint64_t retried = 0;
+    // Response bodies as transferred and after decoding
+    uint64_t received_bytes = 0;
+    uint64_t decoded_bytes = 0;
+    uint64_t in_flight = 0;
+    uint64_t queued = 0;
+};
+
+// Must be called once from main() before any other thread uses the client.
+// At most `max_in_flight` async transfers run at once; up to `max_queued`
+// more wait for a slot, anything beyond that is shed.
+void init(size_t max_in_flight, size_t max_queued);
+
+// Replace the transport installed by init(). Call before any request is
+// made; the previous backend is destroyed. Stats, metrics and rate limiting
+// are the new backend's responsibility.
+void set_backend(std::unique_ptr<backend> transport);
+
+// Blocking API, for background threads only (never from an async callback).
+// Rate limited requests are routed through the async scheduler and waited on.
+response perform(const request& req);
+response get(const std::string& url);
+response post_json(const std::string& url, const std::string& body);
+
+// Non-blocking API
+void perform_async(request req, callback done);
+void get_async(const std::string& url, callback done);
+void post_json_async(const std::string& url, const std::string& body, callback done);
+
+stats get_stats();
+
+// User-Agent sent with every request. CoinGecko returns HTTP 403 without one.
+extern const char* const user_agent;
+
+}  // namespace http
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+// Incremental (push) JSON parser.
+//
+// nlohmann's sax_parse() pulls from a complete input, so it can't be fed
+// from a curl write callback chunk by chunk. jsonstream::parser accepts the
+// body in arbitrary pieces and reports the same SAX events to a
+// nlohmann::json_sax handler, so large responses are never buffered whole and
+// no DOM is built.
+namespace jsonstream {
+
+using json = nlohmann::json;
+
+// SAX handler with no-op defaults, so handlers only override the events they need
+class sax_handler : public nlohmann::json_sax<json> {
+public:
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t) override { return true; }
+    bool number_unsigned(number_unsigned_t) override { return true; }
+    bool number_float(number_float_t, const string_t&) override { return true; }
+    bool string(string_t&) override { return true; }
+    bool binary(binary_t&) override { return true; }
+    bool start_object(std::size_t) override { return true; }
+    bool key(string_t&) override { return true; }
+    bool end_object() override { return true; }
+    bool start_array(std::size_t) override { return true; }
+    bool end_array() override { return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override { return false; }
+};
+
+class parser {
+public:
+    explicit parser(nlohmann::json_sax<json>& handler);
+
+    // Feed the next chunk of input. Returns false once the input turned out
+    // to be invalid or the handler asked to stop; see error().
+    bool feed(const char* data, size_t size);
+
+    // Signal end of input. Returns true if exactly one complete JSON value was parsed.
+    bool finish();
+
+    const std::string& error() const { return error_; }
+
+    // Total bytes fed so far
+    size_t bytes() const { return offset_; }
+
+private:
+    enum class expect { value, value_or_end, key_or_end, key, colon, comma_or_end, done };
+    enum class lex { none, string, string_escape, string_unicode, number, literal };
+
+    bool dispatch(char c);
+    bool begin_value(char c);
+    bool end_container(char c);
+    bool complete_string();
+    bool complete_number();
+    bool complete_literal();
+    bool after_value();
+    bool fail(const std::string& message);
+    void append_utf8(uint32_t codepoint);
+
+    nlohmann::json_sax<json>& handler_;
+
+    expect expect_ = expect::value;
+    lex lex_ = lex::none;
+    // true for object, false for array
+    std::vector<bool> stack_;
+
+    std::string token_;
+    uint32_t unicode_ = 0;
+    int unicode_digits_ = 0;
+    uint32_t high_surrogate_ = 0;
+
+    size_t offset_ = 0;
+    // Input position of the character being processed, for error messages
+    size_t position_ = 0;
+    bool failed_ = false;
+    std::string error_;
+};
+
+}  // namespace jsonstream
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// In-process alternative to qchart:: that rasterizes the /market line chart
+// locally instead of round-tripping through quickchart.io.
+namespace localchart {
+
+// Render a 500x500 line chart (axes, grid, price and time labels, legend) of
+// `prices` over `timestamps` (Unix milliseconds) and return it as PNG bytes.
+// Returns an empty string when there is nothing to plot.
+std::string render_line_chart(const std::vector<long>& timestamps, const std::string& label,
+                              const std::vector<double>& prices);
+
+}  // namespace localchart
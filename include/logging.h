@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous leveled logger.
+//
+// Each thread formats its records into its own lock-free single-producer ring;
+// a background writer drains every ring and writes the batch to stdout. A full
+// ring drops the record (and counts it) instead of blocking the caller.
+//
+// Records are one line of logfmt-style text:
+//
+//   2026-01-01T12:00:00.123Z INFO  [t3] price reply coin=bitcoin latency_ms=12
+//
+// Use the LOG_* macros: their arguments are only evaluated when the level is
+// enabled, so LOG_DEBUG payload dumps cost one atomic load otherwise.
+namespace logging {
+
+enum class level { debug = 0, info = 1, warn = 2, error = 3 };
+
+// Start the writer thread. Until then (and after shutdown) records are
+// written synchronously to stderr.
+void init(level min_level);
+
+// Drain what's queued and stop the writer thread
+void shutdown();
+
+// Parse "debug", "info", "warn" or "error"; anything else gives `fallback`
+level parse_level(const std::string& name, level fallback);
+
+extern std::atomic<int> min_level;
+
+inline bool enabled(level lvl) {
+    return static_cast<int>(lvl) >= min_level.load(std::memory_order_relaxed);
+}
+
+// One key=value pair of a record
+template <typename T>
+struct field {
+    const char* key;
+    const T& value;
+};
+
+template <typename T>
+field<T> kv(const char* key, const T& value) {
+    return {key, value};
+}
+
+// Builds the text of one record. Small records stay in the inline buffer;
+// anything longer spills to the heap.
+class record;
+void submit(level lvl, record& rec);
+
+class record {
+public:
+    void append(std::string_view text);
+    void append(char c) { append(std::string_view(&c, 1)); }
+
+    // Field values: strings are quoted when they contain spaces or quotes
+    void value(std::string_view text);
+    void value(const std::string& text) { value(std::string_view(text)); }
+    void value(const char* text) { value(std::string_view(text)); }
+    void value(bool b) { append(b ? "true" : "false"); }
+
+    template <typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    void value(T number) {
+        char buffer[32];
+        auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        append(std::string_view(buffer, ec == std::errc() ? end - buffer : 0));
+    }
+
+    template <typename T>
+    void add(const field<T>& f) {
+        append(' ');
+        append(f.key);
+        append('=');
+        value(f.value);
+    }
+
+    std::string_view text() const;
+
+    static constexpr size_t kInline = 480;
+
+private:
+    friend void submit(level lvl, record& rec);
+
+    char inline_[kInline];
+    size_t size_ = 0;
+    std::string overflow_;
+    bool spilled_ = false;
+};
+
+template <typename... Fields>
+void write(level lvl, std::string_view message, const Fields&... fields) {
+    record rec;
+    rec.append(message);
+    (rec.add(fields), ...);
+    submit(lvl, rec);
+}
+
+}  // namespace logging
+
+#define LOG_AT(lvl, ...)                                  \
+    do {                                                  \
+        if (::logging::enabled(lvl)) {                    \
+            ::logging::write(lvl, __VA_ARGS__);           \
+        }                                                 \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(::logging::level::debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(::logging::level::info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(::logging::level::warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(::logging::level::error, __VA_ARGS__)
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process-wide counters, gauges and latency histograms, served in the
+// Prometheus text format by a small HTTP listener.
+//
+// Updating a metric is a few relaxed atomic adds. Looking one up by name and
+// labels takes a registry lock, so hot paths with fixed labels keep the
+// returned reference (it stays valid for the life of the process).
+namespace metrics {
+
+using labels = std::map<std::string, std::string>;
+
+class counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class gauge {
+public:
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    void set(int64_t n) { value_.store(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Latency histogram with fixed buckets from 1 ms to 10 s
+class histogram {
+public:
+    static constexpr std::array<double, 14> kBounds = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1,
+                                                       0.25,  0.5,    1.0,   2.0,  3.0,   5.0,  10.0};
+
+    void observe(double seconds);
+
+    template <typename Rep, typename Period>
+    void observe(std::chrono::duration<Rep, Period> elapsed) {
+        observe(std::chrono::duration<double>(elapsed).count());
+    }
+
+    // Observe the time since `start`
+    void observe_since(std::chrono::steady_clock::time_point start) {
+        observe(std::chrono::steady_clock::now() - start);
+    }
+
+    // Append the _bucket, _sum and _count samples
+    void render(std::string& out, const std::string& name, const std::string& label_text) const;
+
+private:
+    // Per-bucket (not cumulative) counts; the last one is +Inf
+    std::array<std::atomic<uint64_t>, kBounds.size() + 1> buckets_{};
+    std::atomic<uint64_t> sum_micros_{0};
+};
+
+// Find or create a metric. `help` is only used the first time a name is seen.
+counter& get_counter(const std::string& name, const std::string& help, const labels& labels = {});
+gauge& get_gauge(const std::string& name, const std::string& help, const labels& labels = {});
+histogram& get_histogram(const std::string& name, const std::string& help, const labels& labels = {});
+
+// One counter or histogram name with a reference to every label combination
+// already used, for hot paths whose label values come from a small set
+// (commands, upstream hosts, status codes) but aren't known up front. A
+// repeated lookup is a shared lock on this cache instead of building a
+// label map and taking the registry lock.
+template <typename Metric>
+class labeled {
+public:
+    // `keys` are the label names, in the order get() takes their values
+    labeled(std::string name, std::string help, std::vector<std::string> keys)
+        : name_(std::move(name)), help_(std::move(help)), keys_(std::move(keys)) {}
+
+    Metric& get(const std::string& value) { return find(value, {&value}); }
+
+    Metric& get(const std::string& first, const std::string& second) {
+        return find(first + '\0' + second, {&first, &second});
+    }
+
+private:
+    // `values` only become a label map when `key` isn't cached yet
+    Metric& find(const std::string& key, std::initializer_list<const std::string*> values);
+
+    std::string name_;
+    std::string help_;
+    std::vector<std::string> keys_;
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string, Metric*> cache_;
+};
+
+// A gauge whose value is read from `read` at scrape time, for state that is
+// already tracked elsewhere (queue lengths, cache sizes). Registering the
+// same name and labels again replaces the reader.
+void register_gauge(const std::string& name, const std::string& help, const labels& labels,
+                    std::function<double()> read);
+
+// The whole registry in Prometheus text exposition format (version 0.0.4)
+std::string render();
+
+// Serve GET /metrics on `address`:`port` from a background thread. Returns
+// false if the socket can't be bound.
+bool serve(const std::string& address, uint16_t port);
+void stop();
+
+}  // namespace metrics
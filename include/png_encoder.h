@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace png {
+
+// Encode an 8-bit RGB image (row-major, 3 bytes per pixel) as PNG bytes.
+// Returns an empty string if compression fails.
+std::string encode_rgb(int width, int height, const std::vector<uint8_t>& pixels);
+
+}  // namespace png
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <coingecko.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+enum class alert_currency { usd = 0, idr = 1 };
+
+// Fires once the price reaches the target from below (above) or from above (below)
+enum class alert_direction { above, below };
+
+struct price_alert {
+    uint64_t id = 0;
+    uint64_t user_id = 0;
+    // Where to post the notification
+    uint64_t channel_id = 0;
+    std::string coingecko_id;
+    alert_currency currency = alert_currency::usd;
+    alert_direction direction = alert_direction::above;
+    double target = 0;
+    std::chrono::system_clock::time_point created_at;
+};
+
+// Watches prices for user alerts.
+//
+// Every coin keeps its thresholds in two ordered maps per currency, keyed by
+// target price. A price update walks only the crossed prefix (above) or
+// suffix (below) of each, so it costs O(log n + k) for k triggered alerts no
+// matter how many are waiting. A background thread polls /simple/price for
+// every watched coin once per interval, `batch_size` ids per request at
+// background priority; coins the price cache already holds a fresh quote for
+// aren't fetched at all, and fetched quotes are stored back into the cache
+// for /price. Upstream load grows with the number of distinct coins watched,
+// not with the number of alerts.
+class alert_engine {
+public:
+    // Runs on the HTTP event loop thread (or the polling thread) for each
+    // triggered alert, which has already been removed
+    using notify_callback = std::function<void(const price_alert& alert, double price)>;
+
+    struct stats {
+        uint64_t alerts = 0;
+        uint64_t watched_coins = 0;
+        uint64_t ticks = 0;
+        uint64_t requests = 0;
+        uint64_t triggered = 0;
+        // Ticks skipped because the previous one's requests were still running
+        uint64_t skipped_ticks = 0;
+    };
+
+    static alert_engine& instance();
+
+    // `max_per_user` caps how many alerts one user may keep
+    void start(std::chrono::seconds interval, size_t batch_size, size_t max_per_user, notify_callback notify);
+    void stop();
+
+    // Register an alert; fills in its id. Returns false when the user
+    // already has `max_per_user` alerts.
+    bool add(price_alert& alert);
+
+    // Remove one of `user_id`'s alerts. Returns false if there is no such alert.
+    bool remove(uint64_t user_id, uint64_t alert_id);
+
+    // `user_id`'s alerts, oldest first
+    std::vector<price_alert> list(uint64_t user_id) const;
+
+    // Apply a price update: removes and returns the alerts it triggers
+    std::vector<price_alert> evaluate(const std::string& coingecko_id, const price_quote& quote);
+
+    stats get_stats() const;
+
+    // Every alert, for persisting across restarts
+    std::vector<price_alert> save() const;
+
+    // Re-add saved alerts, keeping their ids
+    void restore(const std::vector<price_alert>& saved);
+
+    ~alert_engine();
+
+private:
+    // target -> alert id
+    using threshold_map = std::multimap<double, uint64_t>;
+
+    struct watch {
+        // Indexed by alert_currency
+        threshold_map above[2];
+        threshold_map below[2];
+        size_t alerts = 0;
+    };
+
+    alert_engine() = default;
+    alert_engine(const alert_engine&) = delete;
+    alert_engine& operator=(const alert_engine&) = delete;
+
+    void run();
+    void tick();
+    void deliver(const std::string& coingecko_id, const price_quote& quote);
+    void insert(const price_alert& alert);
+    void erase(const price_alert& alert);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, price_alert> alerts_;
+    std::unordered_map<std::string, watch> watches_;
+    std::unordered_map<uint64_t, size_t> per_user_;
+    uint64_t next_id_ = 1;
+
+    std::chrono::seconds interval_{60};
+    size_t batch_size_ = 250;
+    size_t max_per_user_ = 25;
+    notify_callback notify_;
+    // Polling requests still in flight
+    size_t outstanding_ = 0;
+
+    std::thread worker_;
+    std::condition_variable worker_cv_;
+    bool stopping_ = false;
+
+    uint64_t ticks_ = 0;
+    uint64_t requests_ = 0;
+    uint64_t triggered_ = 0;
+    uint64_t skipped_ticks_ = 0;
+};
+
+// e.g. "#12 bitcoin rises to $70,000"
+std::string describe_alert(const price_alert& alert);
+
+// The message posted when `alert` triggers at `price`
+std::string alert_notification(const price_alert& alert, double price);
+
+}  // namespace gecko
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <coingecko.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// Collects single-coin price lookups for a short window and sends them as one
+// multi-id /simple/price request, then fans the parsed results back out to
+// every waiting caller.
+//
+// A batch is flushed when the window since its first lookup has elapsed or
+// when it reaches `max_ids` distinct ids, whichever comes first.
+class price_batcher {
+public:
+    using callback = std::function<void(const price_result&)>;
+
+    struct stats {
+        uint64_t lookups = 0;
+        uint64_t batches = 0;
+    };
+
+    static price_batcher& instance();
+
+    void start(std::chrono::milliseconds window, size_t max_ids);
+    void stop();
+
+    void enqueue(const std::string& coingecko_id, callback done);
+
+    stats get_stats() const;
+
+    ~price_batcher();
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct batch {
+        std::vector<std::string> ids;
+        std::unordered_map<std::string, std::vector<callback>> waiters;
+    };
+
+    price_batcher() = default;
+    price_batcher(const price_batcher&) = delete;
+    price_batcher& operator=(const price_batcher&) = delete;
+
+    void run();
+    void flush(batch pending);
+
+    std::chrono::milliseconds window_{25};
+    size_t max_ids_ = 50;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    batch pending_;
+    clock::time_point first_enqueued_;
+    bool stopping_ = false;
+    std::thread worker_;
+
+    uint64_t lookups_ = 0;
+    uint64_t batches_ = 0;
+};
+
+}  // namespace gecko
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <coingecko.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// TTL cache of /simple/price quotes keyed by CoinGecko id.
+//
+// Concurrent misses for the same id share one upstream fetch (single-flight):
+// the first caller starts it and everyone else just waits on its result.
+// With a non-zero stale window, entries past their TTL are still served
+// while a background fetch revalidates them. When a fetch fails (e.g. the
+// upstream is rate limiting us), waiters get the last known quote flagged as
+// stale, as long as it is younger than the fallback window.
+class price_cache {
+public:
+    using callback = std::function<void(const price_result&)>;
+
+    struct stats {
+        uint64_t hits = 0;
+        uint64_t stale_hits = 0;
+        uint64_t misses = 0;
+        uint64_t coalesced = 0;
+        uint64_t fallbacks = 0;
+        uint64_t entries = 0;
+    };
+
+    // A cached quote with a wall-clock timestamp, for persisting across restarts
+    struct saved_entry {
+        std::string coingecko_id;
+        price_quote quote;
+        std::chrono::system_clock::time_point fetched_at;
+    };
+
+    static price_cache& instance();
+
+    void configure(std::chrono::seconds ttl, std::chrono::seconds stale_ttl, std::chrono::seconds fallback_ttl);
+
+    // Fill `quote` from the cache without any I/O. Returns false on a miss.
+    bool lookup(const std::string& coingecko_id, price_quote& quote);
+
+    // Like lookup() for fresh entries only, but without counting a hit or
+    // starting a revalidation. For background readers like the alert engine.
+    bool peek(const std::string& coingecko_id, price_quote& quote) const;
+
+    // Add a quote fetched outside the cache, e.g. by the alert engine's polling
+    void store(const std::string& coingecko_id, const price_quote& quote);
+
+    // Fetch through the cache. `done` may run on the calling thread (when the
+    // entry was filled meanwhile) or later on the HTTP event loop thread.
+    void fetch(const std::string& coingecko_id, callback done);
+
+    stats get_stats() const;
+
+    // Every entry still usable as a fallback
+    std::vector<saved_entry> save() const;
+
+    // Add saved entries, keeping their age. Entries too old to serve even as
+    // a fallback are skipped, and newer in-memory ones win.
+    void restore(const std::vector<saved_entry>& saved);
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct entry {
+        price_quote quote;
+        clock::time_point fetched_at;
+    };
+
+    price_cache() = default;
+    price_cache(const price_cache&) = delete;
+    price_cache& operator=(const price_cache&) = delete;
+
+    void start_fetch(const std::string& coingecko_id);
+    void complete(const std::string& coingecko_id, const price_result& result);
+    void evict_expired(clock::time_point now);
+
+    mutable std::mutex mutex_;
+    std::chrono::seconds ttl_{30};
+    std::chrono::seconds stale_ttl_{0};
+    std::chrono::seconds fallback_ttl_{0};
+    std::unordered_map<std::string, entry> entries_;
+    // Waiters of each in-flight upstream fetch
+    std::unordered_map<std::string, std::vector<callback>> in_flight_;
+
+    uint64_t hits_ = 0;
+    uint64_t stale_hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t coalesced_ = 0;
+    uint64_t fallbacks_ = 0;
+};
+
+}  // namespace gecko
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace pricefmt {
+
+// Digit grouping and decimal rules for one currency
+struct number_style {
+    char group_separator;
+    char decimal_separator;
+    size_t group_size;
+};
+
+// en_US ($1,234.56) and id_ID (1.234,56) conventions. These are fixed
+// tables, so formatting never depends on which locales the host has installed.
+extern const number_style usd;
+extern const number_style idr;
+
+// Formats into an internal fixed-size buffer; nothing is allocated. The
+// returned view stays valid until the next call on the same formatter.
+class formatter {
+public:
+    std::string_view format(double value, int precision, const number_style& style);
+
+private:
+    // Plain to_chars output, enough for any double with up to 10 decimals
+    char digits_[336];
+    // The grouped result, with room for a separator every three digits
+    char buffer_[448];
+};
+
+// Decimal places CoinGecko used for `value`: the fractional digits of its
+// shortest round-trip representation, capped at 10
+int precision_of(double value);
+
+// Decimal places for a value computed locally (e.g. converted between
+// currencies), whose round-trip digits are only noise: 2 from 1 upwards,
+// otherwise enough for 4 significant digits, capped at 10
+int display_precision(double value);
+
+// Like format(), appended to `out`
+void append(std::string& out, double value, int precision, const number_style& style);
+
+}  // namespace pricefmt
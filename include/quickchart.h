@@ -1,14 +1,21 @@
-#include <curl/curl.h>
+#pragma once
 
 #include <cstdlib>
-#include <iostream>
+#include <functional>
+#include <string>
 #include <vector>
 
 #include "nlohmann/json.hpp"
 
 namespace qchart {
 
-std::string generate_chart(std::vector<long> data1, std::string label,
-                           std::vector<double> data2);
-size_t write_callback(char* ptr, size_t size, size_t nmemb, std::string* data);
+// QuickChart root, e.g. to point the bot at a local stand-in. Call once at
+// startup; defaults to https://quickchart.io.
+void configure_base_url(const std::string& url);
+
+// Render a line chart through QuickChart. `done` receives the chart URL, or
+// an empty string on failure, on the HTTP client's event loop thread.
+void generate_chart(std::vector<long> data1, std::string label,
+                    std::vector<double> data2,
+                    std::function<void(std::string)> done);
 }  // namespace qchart
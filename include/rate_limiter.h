@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace http {
+
+// Token bucket shared by every request to one upstream.
+//
+// The bucket refills at the configured rate up to `burst` tokens. A 429 pauses
+// the bucket for the server's Retry-After (or an exponential backoff when it
+// doesn't send one) and halves the refill rate; each later success adds back
+// a fraction of the configured rate (AIMD), so we settle just below whatever
+// the upstream actually tolerates.
+class rate_limiter {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct stats {
+        uint64_t granted = 0;
+        uint64_t throttled = 0;
+        double rate_per_minute = 0;
+        bool paused = false;
+    };
+
+    rate_limiter(std::string name, double requests_per_minute, double burst);
+
+    const std::string& name() const { return name_; }
+
+    // Take a token if one is available right now
+    bool try_acquire(clock::time_point now);
+
+    // Earliest time a token may be available
+    clock::time_point next_available(clock::time_point now);
+
+    void on_success();
+
+    // Record a 429. `retry_after` is zero when the server didn't say. Returns
+    // the time the bucket is paused until.
+    clock::time_point on_throttled(clock::time_point now, std::chrono::milliseconds retry_after);
+
+    stats get_stats() const;
+
+private:
+    void refill(clock::time_point now);
+
+    mutable std::mutex mutex_;
+    const std::string name_;
+    // Tokens per second
+    const double max_rate_;
+    double rate_;
+    const double burst_;
+    double tokens_;
+    clock::time_point last_refill_;
+    clock::time_point paused_until_;
+    std::chrono::milliseconds backoff_{0};
+
+    uint64_t granted_ = 0;
+    uint64_t throttled_ = 0;
+};
+
+}  // namespace http
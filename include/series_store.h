@@ -0,0 +1,245 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// Time span of a /market chart
+enum class chart_range { day = 0, week = 1, month = 2 };
+
+// "1d" / "7d" / "30d", as used in /market options
+const char* range_key(chart_range range);
+bool parse_range(const std::string& key, chart_range& out);
+int range_days(chart_range range);
+
+// USD price points (Unix milliseconds) of one coin
+struct price_history {
+    bool ok = false;
+    // User-facing error message when !ok
+    std::string error;
+    std::vector<long> timestamps;
+    std::vector<double> prices;
+};
+
+// Fixed-capacity buffer that overwrites its oldest element once full.
+// Index 0 is the oldest element.
+template <typename T>
+class ring {
+public:
+    explicit ring(size_t capacity) : items_(capacity) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return items_.size(); }
+
+    void push_back(const T& value) {
+        items_[(head_ + size_) % items_.size()] = value;
+        if (size_ < items_.size()) {
+            size_++;
+        } else {
+            head_ = (head_ + 1) % items_.size();
+        }
+    }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    T& operator[](size_t i) { return items_[(head_ + i) % items_.size()]; }
+    const T& operator[](size_t i) const { return items_[(head_ + i) % items_.size()]; }
+    T& back() { return (*this)[size_ - 1]; }
+    const T& back() const { return (*this)[size_ - 1]; }
+
+private:
+    std::vector<T> items_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+// Recent price history of one coin in USD, stored column-wise: raw points at
+// CoinGecko's 5 minute granularity, plus OHLC candles rolled up from them
+// at 1 hour and 4 hours. Each chart_range reads the finest level that holds
+// it (1d the raw points, 7d the hourly candles, 30d the 4 hour ones), so a
+// chart never has to re-aggregate the raw data.
+class price_series {
+public:
+    // One level's points, oldest first, for persisting across restarts.
+    // Candles keep only their start and close.
+    struct saved_level {
+        int64_t complete_from = 0;
+        int64_t last_ms = 0;
+        std::vector<int64_t> time;
+        std::vector<double> price;
+    };
+
+    price_series();
+
+    // Add 5 minute points (oldest first). Points not newer than what a level
+    // already holds are skipped.
+    void add_points(const std::vector<long>& timestamps, const std::vector<double>& prices);
+
+    // Replace the raw points with a freshly loaded day starting at `from_ms`
+    void load_points(const std::vector<long>& timestamps, const std::vector<double>& prices, int64_t from_ms);
+
+    // Rebuild the candles from hourly points loaded from `from_ms` on, then
+    // roll the newer raw points back in
+    void load_hourly(const std::vector<long>& timestamps, const std::vector<double>& prices, int64_t from_ms);
+
+    void clear();
+
+    // Whether the data reaches back over all of `range` ending at `now_ms`
+    bool covers(chart_range range, int64_t now_ms) const;
+
+    // Newest point at any level, or 0 when empty
+    int64_t latest() const { return latest_ms_; }
+
+    // Newest raw point, or 0 when there are none
+    int64_t latest_point() const;
+
+    // Points of `range` ending at `now_ms`: raw prices for 1d, candle closes otherwise
+    void read(chart_range range, int64_t now_ms, std::vector<long>& timestamps, std::vector<double>& prices) const;
+
+    // The raw points, then the 1 hour and 4 hour candles
+    std::vector<saved_level> save() const;
+
+    // Replace the contents with saved levels. Restored candles open, peak
+    // and bottom at their close. Returns false, leaving the series empty,
+    // if the levels are malformed.
+    bool restore(const std::vector<saved_level>& levels);
+
+private:
+    struct points {
+        ring<int64_t> time;
+        ring<double> price;
+        // Earliest time the buffer is known to be complete from
+        int64_t complete_from = 0;
+
+        explicit points(size_t capacity) : time(capacity), price(capacity) {}
+    };
+
+    struct candles {
+        int64_t width_ms;
+        // Start of each candle
+        ring<int64_t> start;
+        ring<double> open, high, low, close;
+        // Time of the last point rolled in
+        int64_t last_ms = 0;
+        int64_t complete_from = 0;
+
+        candles(int64_t width, size_t capacity)
+            : width_ms(width), start(capacity), open(capacity), high(capacity), low(capacity), close(capacity) {}
+
+        void add(int64_t ts, double price);
+        void clear();
+        saved_level save() const;
+        bool restore(const saved_level& level);
+    };
+
+    void roll_up(int64_t ts, double price);
+
+    points raw_;
+    candles hourly_;
+    candles four_hourly_;
+    int64_t latest_ms_ = 0;
+};
+
+// Price histories for /market, kept between charts.
+//
+// The first chart of a coin loads the range it needs; after that a fetch
+// only asks CoinGecko for the points newer than the ones held (at most once
+// per refresh interval), and any range the data already covers is served
+// without loading it again. Concurrent fetches of the same coin share one
+// upstream request. The least recently charted coins are dropped past
+// `max_series`.
+class series_store {
+public:
+    using callback = std::function<void(const price_history&)>;
+
+    struct stats {
+        uint64_t hits = 0;
+        // Fetched only the points newer than the stored ones
+        uint64_t refreshes = 0;
+        // Fetched a whole range
+        uint64_t loads = 0;
+        uint64_t coalesced = 0;
+        uint64_t series = 0;
+    };
+
+    // A coin's history and when upstream was last asked for it, for
+    // persisting across restarts
+    struct saved_entry {
+        std::string coingecko_id;
+        std::chrono::system_clock::time_point checked_at;
+        std::vector<price_series::saved_level> levels;
+    };
+
+    static series_store& instance();
+
+    void configure(std::chrono::seconds refresh_interval, size_t max_series);
+
+    // USD prices of `coingecko_id` over `range`. `done` runs on the calling
+    // thread when the stored data was fresh, otherwise on the HTTP event loop
+    // thread.
+    void fetch(const std::string& coingecko_id, chart_range range, callback done);
+
+    stats get_stats() const;
+
+    // Every coin with history, most recently charted first
+    std::vector<saved_entry> save() const;
+
+    // Add saved histories up to `max_series`, keeping their refresh times.
+    // Coins already held win, and histories too old to catch up are skipped.
+    void restore(const std::vector<saved_entry>& saved);
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct waiter {
+        chart_range range;
+        callback done;
+    };
+
+    struct entry {
+        price_series series;
+        // Last time upstream was asked for newer points
+        clock::time_point checked_at;
+        clock::time_point used_at;
+        bool in_flight = false;
+        std::vector<waiter> waiters;
+    };
+
+    // What to ask upstream for: `days` days from `from_ms` on, or with no
+    // days just the points since `from_ms`
+    struct load_plan {
+        int days = 0;
+        int64_t from_ms = 0;
+    };
+
+    series_store() = default;
+    series_store(const series_store&) = delete;
+    series_store& operator=(const series_store&) = delete;
+
+    void start_load(const std::string& coingecko_id, load_plan plan);
+    void complete(const std::string& coingecko_id, load_plan plan, const price_history& loaded);
+    void evict(const std::string& keep);
+
+    mutable std::mutex mutex_;
+    std::chrono::seconds refresh_interval_{60};
+    size_t max_series_ = 256;
+    std::unordered_map<std::string, entry> entries_;
+
+    uint64_t hits_ = 0;
+    uint64_t refreshes_ = 0;
+    uint64_t loads_ = 0;
+    uint64_t coalesced_ = 0;
+};
+
+}  // namespace gecko
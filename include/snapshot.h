@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Binary snapshot of the coin index (with its market cap ranks), the price
+// cache, price alerts, live tickers, exchange rates, watchlists and /market
+// price histories, so a restart answers from warm state instead of
+// re-downloading /coins/list and every chart's range and re-fetching every
+// quote, and no alert, ticker or watchlist is lost.
+//
+// File layout (native byte order, little-endian on every platform we ship):
+//
+//   header   magic "CPBS", u32 version, u64 created (Unix ms),
+//            u32 section count, u64 FNV-1a hash of everything after the header
+//   section  u32 tag, u64 payload size, payload
+//
+// Strings are a u32 length followed by the bytes. Unknown section tags are
+// skipped, so sections can be added without a version bump; changing an
+// existing section's layout needs one. A file with the wrong magic,
+// version or hash is ignored.
+namespace snapshot {
+
+// Write the current state to `path`. The file is replaced atomically via a
+// temporary file in the same directory.
+bool save(const std::string& path);
+
+// Load `path` (memory-mapped) into the coin index, price cache, alert engine,
+// ticker board, exchange rate table, watchlists and price histories. Returns
+// false if there is no usable snapshot; nothing is changed in that case.
+bool load(const std::string& path);
+
+// Save to `path` every `interval` from a background thread, and once more
+// on stop()
+void start(const std::string& path, std::chrono::seconds interval);
+void stop();
+
+}  // namespace snapshot
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <coingecko.h>
+#include <timer_wheel.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// A channel message kept up to date with one coin's price
+struct price_ticker {
+    uint64_t id = 0;
+    uint64_t channel_id = 0;
+    uint64_t message_id = 0;
+    uint64_t user_id = 0;
+    std::string coingecko_id;
+    std::chrono::seconds interval{60};
+    std::chrono::system_clock::time_point created_at;
+};
+
+// Live price ticker messages.
+//
+// Tickers sit in a hierarchical timer wheel with one-second ticks. Deadlines
+// are aligned to multiples of each ticker's interval, so every ticker due in
+// the same second fires together and their coins are refreshed with one
+// batched /simple/price request (coins with a fresh price cache entry need
+// none). The resulting message edits go through a per-channel pacer that
+// spaces them at least `edit_spacing` apart and keeps only the newest
+// content per message, staying inside Discord's per-channel rate limits.
+class ticker_board {
+public:
+    // Edit `ticker`'s message to `content`. Runs on the board's thread.
+    using edit_callback = std::function<void(const price_ticker& ticker, const std::string& content)>;
+
+    struct stats {
+        uint64_t tickers = 0;
+        // Seconds in which at least one ticker was due
+        uint64_t refresh_slots = 0;
+        uint64_t requests = 0;
+        uint64_t edits = 0;
+        // Edits replaced by a newer one before the pacer let them out
+        uint64_t coalesced_edits = 0;
+    };
+
+    static ticker_board& instance();
+
+    // `batch_size` caps ids per /simple/price request, `max_per_channel` the
+    // tickers one channel may hold
+    void start(size_t batch_size, size_t max_per_channel, std::chrono::milliseconds edit_spacing, edit_callback edit);
+    void stop();
+
+    // Register a ticker; fills in its id. Its first refresh is at the next
+    // multiple of its interval. Returns false when the channel already has
+    // `max_per_channel` tickers.
+    bool add(price_ticker& ticker);
+
+    // Attach the message a ticker edits, once it has been posted. Tickers
+    // without one are refreshed but not edited.
+    void set_message(uint64_t ticker_id, uint64_t message_id);
+
+    // Stop a ticker in `channel_id`. Returns false if there is no such ticker.
+    bool remove(uint64_t channel_id, uint64_t ticker_id);
+
+    // Stop a ticker wherever it is, e.g. after its message was deleted
+    void remove(uint64_t ticker_id);
+
+    // Tickers posted in `channel_id`
+    std::vector<price_ticker> list(uint64_t channel_id) const;
+
+    stats get_stats() const;
+
+    // Every ticker, for persisting across restarts
+    std::vector<price_ticker> save() const;
+
+    // Re-add saved tickers, keeping their ids
+    void restore(const std::vector<price_ticker>& saved);
+
+    ~ticker_board();
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    // Edits waiting for their channel's next slot
+    struct channel_queue {
+        clock::time_point next_edit;
+        // Ticker ids, each at most once
+        std::deque<uint64_t> waiting;
+    };
+
+    ticker_board();
+    ticker_board(const ticker_board&) = delete;
+    ticker_board& operator=(const ticker_board&) = delete;
+
+    // Due ticker ids by coin
+    using due_map = std::unordered_map<std::string, std::vector<uint64_t>>;
+
+    void run();
+    void refresh(due_map due);
+    void publish(const std::vector<uint64_t>& ticker_ids, const price_quote& quote);
+    void insert(const price_ticker& ticker);
+    void erase(uint64_t ticker_id);
+    uint64_t tick_at(clock::time_point t) const;
+    uint64_t next_slot(const price_ticker& ticker) const;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, price_ticker> tickers_;
+    std::unordered_map<uint64_t, size_t> per_channel_;
+    uint64_t next_id_ = 1;
+
+    clock::time_point epoch_;
+    timer_wheel wheel_;
+
+    std::unordered_map<uint64_t, channel_queue> channels_;
+    // Newest content for each ticker with an edit waiting
+    std::unordered_map<uint64_t, std::string> pending_;
+
+    size_t batch_size_ = 250;
+    size_t max_per_channel_ = 5;
+    std::chrono::milliseconds edit_spacing_{1000};
+    edit_callback edit_;
+
+    std::thread worker_;
+    std::condition_variable worker_cv_;
+    bool stopping_ = false;
+    // Set when publish() queued an edit the worker hasn't seen yet
+    bool edits_ready_ = false;
+
+    uint64_t refresh_slots_ = 0;
+    uint64_t requests_ = 0;
+    uint64_t edits_ = 0;
+    uint64_t coalesced_edits_ = 0;
+};
+
+// The ticker message for `quote`
+std::string ticker_message(const price_ticker& ticker, const price_quote& quote);
+
+}  // namespace gecko
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Hierarchical timing wheel (Varghese & Lauck) over abstract ticks.
+//
+// Four levels of 64 slots each cover 64^4 ticks ahead. A timer goes into the
+// lowest level whose span reaches its deadline; when a level's slot comes
+// up, its timers cascade down a level, so every timer moves at most three
+// times and scheduling, cancelling and firing are all O(1) regardless of how
+// many timers are pending. Not thread-safe: the owner serializes access.
+class timer_wheel {
+public:
+    using timer_id = uint64_t;
+
+    static constexpr int kLevelBits = 6;
+    static constexpr size_t kSlots = size_t{1} << kLevelBits;
+    static constexpr int kLevels = 4;
+    // Furthest deadline ahead of now(); later ones are clamped to it
+    static constexpr uint64_t kMaxDelay = (uint64_t{1} << (kLevelBits * kLevels)) - 1;
+
+    explicit timer_wheel(uint64_t now = 0) : now_(now) {}
+
+    // Fire `id` at tick `at` (at the next tick if `at` is not in the future).
+    // Rescheduling an id replaces its previous deadline.
+    void schedule(timer_id id, uint64_t at);
+
+    // Returns false if `id` wasn't pending
+    bool cancel(timer_id id);
+
+    // Move time forward to `to`, appending timers that expire on the way to
+    // `due` in deadline order. Expired timers are no longer pending.
+    void advance(uint64_t to, std::vector<timer_id>& due);
+
+    uint64_t now() const { return now_; }
+    size_t size() const { return timers_.size(); }
+    bool empty() const { return timers_.empty(); }
+
+private:
+    struct slot_entry {
+        timer_id id;
+        // Matches timers_[id].generation unless the timer was cancelled or
+        // rescheduled since; stale entries are dropped when their slot comes up
+        uint64_t generation;
+    };
+
+    struct timer {
+        uint64_t expires;
+        uint64_t generation;
+    };
+
+    using slot = std::vector<slot_entry>;
+
+    void place(timer_id id, const timer& t);
+    void cascade(int level, uint64_t tick);
+    bool current(const slot_entry& entry) const;
+
+    uint64_t now_;
+    uint64_t next_generation_ = 1;
+    std::unordered_map<timer_id, timer> timers_;
+    std::array<std::array<slot, kSlots>, kLevels> wheels_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gecko {
+
+// One user's saved coins for /prices, in the order they were added
+struct watchlist {
+    uint64_t user_id = 0;
+    std::vector<std::string> ids;
+};
+
+// Per-user watchlists of CoinGecko ids, shown by /prices without coins.
+// Each list holds at most `max_coins` ids.
+class watchlists {
+public:
+    struct stats {
+        uint64_t users = 0;
+        uint64_t coins = 0;
+    };
+
+    static watchlists& instance();
+
+    void configure(size_t max_coins);
+    size_t max_coins() const;
+
+    // Append `ids` to `user_id`'s list, skipping ones already on it. Returns
+    // the ids added; the rest of `ids` didn't fit once the list was full.
+    std::vector<std::string> add(uint64_t user_id, const std::vector<std::string>& ids);
+
+    // Remove `ids` from `user_id`'s list. Returns the ids that were on it.
+    std::vector<std::string> remove(uint64_t user_id, const std::vector<std::string>& ids);
+
+    // `user_id`'s list, oldest first
+    std::vector<std::string> get(uint64_t user_id) const;
+
+    stats get_stats() const;
+
+    // Every non-empty list, for persisting across restarts
+    std::vector<watchlist> save() const;
+
+    // Add saved lists; users who already have one keep theirs
+    void restore(const std::vector<watchlist>& saved);
+
+private:
+    watchlists() = default;
+    watchlists(const watchlists&) = delete;
+    watchlists& operator=(const watchlists&) = delete;
+
+    mutable std::mutex mutex_;
+    size_t max_coins_ = 25;
+    std::unordered_map<uint64_t, std::vector<std::string>> lists_;
+    size_t coins_ = 0;
+};
+
+}  // namespace gecko
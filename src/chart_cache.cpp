@@ -0,0 +1,110 @@
+#include <chart_cache.h>
+
+#include <algorithm>
+
+gecko::chart_cache& gecko::chart_cache::instance() {
+    static chart_cache cache;
+    return cache;
+}
+
+void gecko::chart_cache::configure(std::chrono::seconds bucket, size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bucket_ = std::max(bucket, std::chrono::seconds(1));
+    max_bytes_ = max_bytes;
+}
+
+void gecko::chart_cache::fetch(const std::string& token_id, const std::string& currency, chart_range range,
+                               render_fn render, reply_callback done) {
+    std::string key;
+    clock::time_point expires_at;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto now = clock::now();
+        auto width = bucket_ * range_days(range);
+        auto bucket = now.time_since_epoch() / width;
+        expires_at = clock::time_point(std::chrono::duration_cast<clock::duration>(width * (bucket + 1)));
+        key = token_id + '|' + currency + '|' + range_key(range) + '|' + std::to_string(bucket);
+
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            hits_++;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            reply chart = it->second->chart;
+            lock.unlock();
+            done(chart);
+            return;
+        }
+
+        auto flight = in_flight_.find(key);
+        if (flight != in_flight_.end()) {
+            coalesced_++;
+            flight->second.push_back(std::move(done));
+            return;
+        }
+
+        misses_++;
+        in_flight_[key].push_back(std::move(done));
+    }
+
+    render([this, key, expires_at](const reply& chart) { complete(key, expires_at, chart); });
+}
+
+void gecko::chart_cache::complete(const std::string& key, clock::time_point expires_at, const reply& chart) {
+    std::vector<reply_callback> waiters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = clock::now();
+        if (chart.ok && now < expires_at && entries_.find(key) == entries_.end()) {
+            entry e;
+            e.key = key;
+            e.chart = chart;
+            e.expires_at = expires_at;
+            e.bytes = key.size() + chart.content.size() + chart.file_name.size() + chart.file_data.size() +
+                      chart.file_type.size() + sizeof(entry);
+            bytes_ += e.bytes;
+            lru_.push_front(std::move(e));
+            entries_[key] = lru_.begin();
+        }
+        evict(now);
+
+        auto flight = in_flight_.find(key);
+        if (flight != in_flight_.end()) {
+            waiters = std::move(flight->second);
+            in_flight_.erase(flight);
+        }
+    }
+
+    for (const auto& waiter : waiters) waiter(chart);
+}
+
+void gecko::chart_cache::erase(std::list<entry>::iterator it) {
+    bytes_ -= it->bytes;
+    entries_.erase(it->key);
+    lru_.erase(it);
+}
+
+// Callers hold `mutex_`
+void gecko::chart_cache::evict(clock::time_point now) {
+    while (!lru_.empty() && bytes_ > max_bytes_) {
+        evictions_++;
+        erase(std::prev(lru_.end()));
+    }
+    // Past their bucket nothing can hit them any more
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        auto next = std::next(it);
+        if (it->expires_at <= now) erase(it);
+        it = next;
+    }
+}
+
+gecko::chart_cache::stats gecko::chart_cache::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats out;
+    out.hits = hits_;
+    out.misses = misses_;
+    out.coalesced = coalesced_;
+    out.evictions = evictions_;
+    out.entries = entries_.size();
+    out.bytes = bytes_;
+    return out;
+}
@@ -0,0 +1,432 @@
+#include <coin_index.h>
+#include <coin_listing.h>
+#include <coin_search.h>
+#include <http_client.h>
+#include <logging.h>
+#include <metrics.h>
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+// Retry a failed refresh sooner than the regular interval
+static constexpr std::chrono::seconds kRetryInterval{60};
+
+// Largest page /coins/markets serves
+static constexpr size_t kMarketsPageSize = 250;
+
+// Symbol and entry of each coin that differs between two lists
+struct coin_changes {
+    std::vector<std::pair<std::string, gecko::coin_entry>> added;
+    std::vector<std::pair<std::string, gecko::coin_entry>> removed;
+};
+
+static std::string coin_key(const std::string& symbol, const gecko::coin_entry& entry) {
+    std::string key;
+    key.reserve(entry.id.size() + symbol.size() + entry.name.size() + 2);
+    key.append(entry.id).append(1, '\0').append(symbol).append(1, '\0').append(entry.name);
+    return key;
+}
+
+// Coins in `next` that aren't in `previous` with the same id, symbol and
+// name, and the other way round. A coin listed twice counts twice.
+static coin_changes diff_coins(const gecko::coin_index::symbol_map& previous,
+                               const gecko::coin_index::symbol_map& next) {
+    std::unordered_map<std::string, size_t> unmatched;
+    for (const auto& [symbol, entries] : previous) {
+        for (const auto& entry : entries) unmatched[coin_key(symbol, entry)]++;
+    }
+
+    coin_changes changes;
+    for (const auto& [symbol, entries] : next) {
+        for (const auto& entry : entries) {
+            auto it = unmatched.find(coin_key(symbol, entry));
+            if (it != unmatched.end() && it->second > 0) {
+                it->second--;
+            } else {
+                changes.added.emplace_back(symbol, entry);
+            }
+        }
+    }
+    for (const auto& [symbol, entries] : previous) {
+        for (const auto& entry : entries) {
+            auto it = unmatched.find(coin_key(symbol, entry));
+            if (it->second == 0) continue;
+            it->second--;
+            changes.removed.emplace_back(symbol, entry);
+        }
+    }
+    return changes;
+}
+
+// A copy of `previous` with `changes` applied; every other coin keeps its
+// place in its symbol's list
+static std::shared_ptr<gecko::coin_index::symbol_map> apply_changes(const gecko::coin_index::symbol_map& previous,
+                                                                    const coin_changes& changes) {
+    auto next = std::make_shared<gecko::coin_index::symbol_map>(previous);
+    for (const auto& [symbol, removed] : changes.removed) {
+        auto it = next->find(symbol);
+        if (it == next->end()) continue;
+        auto& entries = it->second;
+        auto found = std::find_if(entries.begin(), entries.end(), [&removed = removed](const gecko::coin_entry& entry) {
+            return entry.id == removed.id && entry.name == removed.name;
+        });
+        if (found != entries.end()) entries.erase(found);
+        if (entries.empty()) next->erase(it);
+    }
+    for (const auto& [symbol, added] : changes.added) (*next)[symbol].push_back(added);
+    return next;
+}
+
+gecko::coin_list_handler::coin_list_handler(coin_index::symbol_map& index) : index_(index) {}
+
+bool gecko::coin_list_handler::start_array(std::size_t) {
+    depth_++;
+    return true;
+}
+
+bool gecko::coin_list_handler::end_array() {
+    depth_--;
+    return true;
+}
+
+bool gecko::coin_list_handler::start_object(std::size_t) {
+    // The top level must be an array of coins, anything else is an error payload
+    if (depth_ == 0) return false;
+    if (++depth_ == 2) {
+        id_.clear();
+        symbol_.clear();
+        name_.clear();
+    }
+    return true;
+}
+
+bool gecko::coin_list_handler::end_object() {
+    if (depth_-- == 2 && !id_.empty() && !symbol_.empty()) {
+        std::transform(symbol_.begin(), symbol_.end(), symbol_.begin(), ::tolower);
+        index_[symbol_].push_back({std::move(id_), std::move(name_)});
+        coins_++;
+    }
+    return true;
+}
+
+bool gecko::coin_list_handler::key(string_t& key) {
+    if (depth_ != 2) return true;
+    if (key == "id") {
+        field_ = &id_;
+    } else if (key == "symbol") {
+        field_ = &symbol_;
+    } else if (key == "name") {
+        field_ = &name_;
+    } else {
+        field_ = nullptr;
+    }
+    return true;
+}
+
+bool gecko::coin_list_handler::string(string_t& value) {
+    if (depth_ == 2 && field_ != nullptr) {
+        *field_ = std::move(value);
+        field_ = nullptr;
+    }
+    return true;
+}
+
+gecko::market_rank_handler::market_rank_handler(coin_index::rank_map& ranks) : ranks_(ranks) {}
+
+bool gecko::market_rank_handler::start_array(std::size_t) {
+    depth_++;
+    return true;
+}
+
+bool gecko::market_rank_handler::end_array() {
+    depth_--;
+    return true;
+}
+
+bool gecko::market_rank_handler::start_object(std::size_t) {
+    // The top level must be an array of coins, anything else is an error payload
+    if (depth_ == 0) return false;
+    if (++depth_ == 2) {
+        id_.clear();
+        rank_ = 0;
+    }
+    return true;
+}
+
+bool gecko::market_rank_handler::end_object() {
+    if (depth_-- == 2 && !id_.empty() && rank_ > 0 && rank_ <= UINT32_MAX) {
+        ranks_[std::move(id_)] = static_cast<uint32_t>(rank_);
+        coins_++;
+    }
+    return true;
+}
+
+bool gecko::market_rank_handler::key(string_t& key) {
+    if (depth_ != 2) return true;
+    if (key == "id") {
+        field_ = field::id;
+    } else if (key == "market_cap_rank") {
+        field_ = field::rank;
+    } else {
+        field_ = field::none;
+    }
+    return true;
+}
+
+bool gecko::market_rank_handler::string(string_t& value) {
+    if (depth_ == 2 && field_ == field::id) id_ = std::move(value);
+    field_ = field::none;
+    return true;
+}
+
+bool gecko::market_rank_handler::number_integer(number_integer_t value) {
+    if (depth_ == 2 && field_ == field::rank && value > 0) rank_ = static_cast<uint64_t>(value);
+    field_ = field::none;
+    return true;
+}
+
+bool gecko::market_rank_handler::number_unsigned(number_unsigned_t value) {
+    if (depth_ == 2 && field_ == field::rank) rank_ = value;
+    field_ = field::none;
+    return true;
+}
+
+gecko::coin_index& gecko::coin_index::instance() {
+    static coin_index index;
+    return index;
+}
+
+gecko::coin_index::~coin_index() {
+    stop();
+}
+
+void gecko::coin_index::configure_ranking(const std::string& markets_url, size_t ranked_coins) {
+    if (!markets_url.empty()) markets_url_ = markets_url;
+    ranked_coins_ = ranked_coins;
+}
+
+void gecko::coin_index::start(std::chrono::seconds refresh_interval, http::rate_limiter* limiter,
+                              const std::string& list_url) {
+    limiter_ = limiter;
+    if (!list_url.empty()) list_url_ = list_url;
+    if (!ready()) refresh();
+    worker_ = std::thread(&coin_index::run, this, std::max(refresh_interval, std::chrono::seconds(1)));
+}
+
+void gecko::coin_index::stop() {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        stopping_ = true;
+    }
+    worker_cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void gecko::coin_index::run(std::chrono::seconds refresh_interval) {
+    bool failed = false;
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    while (!stopping_) {
+        std::chrono::system_clock::duration wait = refresh_interval;
+        if (!ready() || failed) {
+            wait = std::min(refresh_interval, kRetryInterval);
+        } else {
+            // A restored index may already be partly (or fully) due
+            wait = std::max(std::chrono::system_clock::duration::zero(),
+                            built_at() + refresh_interval - std::chrono::system_clock::now());
+        }
+        if (worker_cv_.wait_for(lock, wait, [this] { return stopping_; })) break;
+
+        lock.unlock();
+        failed = !refresh();
+        lock.lock();
+    }
+}
+
+bool gecko::coin_index::ready() const {
+    return std::atomic_load(&snapshot_) != nullptr;
+}
+
+std::shared_ptr<const gecko::coin_index::symbol_map> gecko::coin_index::snapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+std::chrono::system_clock::time_point gecko::coin_index::built_at() const {
+    return std::chrono::system_clock::time_point(std::chrono::milliseconds(built_at_ms_.load()));
+}
+
+std::shared_ptr<const gecko::coin_search> gecko::coin_index::search() const {
+    return std::atomic_load(&search_);
+}
+
+std::shared_ptr<const gecko::coin_listing> gecko::coin_index::listing() const {
+    return std::atomic_load(&listing_);
+}
+
+std::shared_ptr<const gecko::coin_index::rank_map> gecko::coin_index::ranks() const {
+    return std::atomic_load(&ranks_);
+}
+
+void gecko::coin_index::restore(std::shared_ptr<const symbol_map> index, std::chrono::system_clock::time_point built_at,
+                                std::shared_ptr<const rank_map> ranks) {
+    if (!ranks) ranks = std::atomic_load(&ranks_);
+    if (!ranks) ranks = std::make_shared<rank_map>();
+
+    // Build the search index and listing before publishing anything, so they always match
+    auto started = std::chrono::steady_clock::now();
+    auto search = std::make_shared<const coin_search>(*index, *ranks);
+    auto listing = std::make_shared<const coin_listing>(*index, *ranks, built_at);
+    LOG_DEBUG("coin search index built", logging::kv("coins", search->size()), logging::kv("ranked", ranks->size()),
+              logging::kv("pages", listing->pages()),
+              logging::kv("ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count()));
+
+    built_at_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(built_at.time_since_epoch()).count();
+    std::atomic_store(&ranks_, std::move(ranks));
+    std::atomic_store(&search_, std::shared_ptr<const coin_search>(std::move(search)));
+    std::atomic_store(&listing_, std::shared_ptr<const coin_listing>(std::move(listing)));
+    std::atomic_store(&snapshot_, std::move(index));
+}
+
+std::vector<gecko::coin_entry> gecko::coin_index::find(const std::string& symbol) const {
+    auto snapshot = std::atomic_load(&snapshot_);
+    if (!snapshot) return {};
+
+    auto it = snapshot->find(symbol);
+    if (it == snapshot->end()) return {};
+    return it->second;
+}
+
+bool gecko::coin_index::refresh() {
+    auto current = snapshot();
+    auto index = std::make_shared<symbol_map>();
+    coin_list_handler handler(*index);
+    jsonstream::parser parser(handler);
+
+    // Parse the list as it downloads instead of buffering it and building a DOM
+    http::request req;
+    req.url = list_url_;
+    // Yield to user requests; a late refresh only means a slightly older index
+    req.prio = http::priority::background;
+    req.limiter = limiter_;
+    req.max_wait = std::chrono::minutes(5);
+    std::chrono::steady_clock::duration parse_time{0};
+    req.on_data = [&parser, &parse_time](const char* data, size_t size) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = parser.feed(data, size);
+        parse_time += std::chrono::steady_clock::now() - start;
+        return ok;
+    };
+
+    // Only worth asking when there is a snapshot built from that response to keep
+    bool conditional = current != nullptr && (!list_etag_.empty() || !list_last_modified_.empty());
+    if (conditional) {
+        if (!list_etag_.empty()) req.headers.push_back("If-None-Match: " + list_etag_);
+        if (!list_last_modified_.empty()) req.headers.push_back("If-Modified-Since: " + list_last_modified_);
+    }
+
+    http::response res = http::perform(req);
+    if (!res.ok()) {
+        LOG_ERROR("coin list refresh failed", logging::kv("error", res.error()),
+                  logging::kv("parse_error", parser.error()));
+        return false;
+    }
+    if (res.status == 304 && conditional) {
+        metrics::get_counter("bot_listing_refreshes_total", "Listing refreshes by outcome",
+                             {{"document", "coins_list"}, {"result", "not_modified"}})
+            .inc();
+        metrics::get_counter("bot_listing_saved_bytes_total",
+                             "Transfer skipped by revalidating listings, counted as the size of the last full response",
+                             {{"document", "coins_list"}})
+            .inc(list_received_bytes_);
+        LOG_INFO("coin list not modified", logging::kv("saved_bytes", list_received_bytes_),
+                 logging::kv("saved_parse_ms", std::chrono::duration<double, std::milli>(list_parse_time_).count()));
+        update_ranks(fetch_ranks());
+        return true;
+    }
+    if (res.status != 200) {
+        LOG_ERROR("coin list refresh failed", logging::kv("status", res.status));
+        return false;
+    }
+    if (!parser.finish()) {
+        LOG_ERROR("coin list refresh failed", logging::kv("parse_error", parser.error()));
+        return false;
+    }
+
+    metrics::get_histogram("bot_json_parse_seconds", "Time spent parsing upstream JSON", {{"document", "coins_list"}})
+        .observe(parse_time);
+    list_etag_ = res.header("etag");
+    list_last_modified_ = res.header("last-modified");
+    list_received_bytes_ = res.received_bytes;
+    list_parse_time_ = parse_time;
+
+    coin_changes changes;
+    if (current) changes = diff_coins(*current, *index);
+    LOG_INFO("coin index refreshed", logging::kv("coins", handler.coins()), logging::kv("symbols", index->size()),
+             logging::kv("added", changes.added.size()), logging::kv("removed", changes.removed.size()),
+             logging::kv("received_bytes", res.received_bytes), logging::kv("bytes", parser.bytes()));
+
+    // The search index and listing number coins in rank order, so any
+    // addition or removal rebuilds them; an identical list keeps everything
+    if (current && changes.added.empty() && changes.removed.empty()) {
+        metrics::get_counter("bot_listing_refreshes_total", "Listing refreshes by outcome",
+                             {{"document", "coins_list"}, {"result", "unchanged"}})
+            .inc();
+        update_ranks(fetch_ranks());
+        return true;
+    }
+    metrics::get_counter("bot_listing_refreshes_total", "Listing refreshes by outcome",
+                         {{"document", "coins_list"}, {"result", "changed"}})
+        .inc();
+    // Readers may still hold the current map, so the changes go into a copy
+    if (current) {
+        index.reset();
+        index = apply_changes(*current, changes);
+    }
+    restore(std::move(index), std::chrono::system_clock::now(), fetch_ranks());
+    return true;
+}
+
+void gecko::coin_index::update_ranks(std::shared_ptr<const rank_map> ranks) {
+    auto current = this->ranks();
+    if (ranks && (!current || *ranks != *current)) {
+        restore(snapshot(), std::chrono::system_clock::now(), std::move(ranks));
+        return;
+    }
+    // Nothing to rebuild; the list just counts as fresh again
+    built_at_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+}
+
+std::shared_ptr<const gecko::coin_index::rank_map> gecko::coin_index::fetch_ranks() {
+    if (ranked_coins_ == 0) return nullptr;
+
+    auto ranks = std::make_shared<rank_map>();
+    ranks->reserve(ranked_coins_);
+    size_t pages = (ranked_coins_ + kMarketsPageSize - 1) / kMarketsPageSize;
+    for (size_t page = 1; page <= pages; page++) {
+        market_rank_handler handler(*ranks);
+        jsonstream::parser parser(handler);
+
+        http::request req;
+        req.url = markets_url_ + "?vs_currency=usd&order=market_cap_desc&per_page=" + std::to_string(kMarketsPageSize) +
+                  "&page=" + std::to_string(page);
+        req.prio = http::priority::background;
+        req.limiter = limiter_;
+        req.max_wait = std::chrono::minutes(5);
+        req.on_data = [&parser](const char* data, size_t size) { return parser.feed(data, size); };
+
+        http::response res = http::perform(req);
+        if (!res.ok() || res.status != 200 || !parser.finish()) {
+            // Keep the previous ranks rather than publish a partial ranking
+            LOG_WARN("market cap rank refresh failed", logging::kv("page", page), logging::kv("status", res.status),
+                     logging::kv("error", res.ok() ? parser.error() : res.error()));
+            return nullptr;
+        }
+        // A short page means we've run out of ranked coins
+        if (handler.coins() < kMarketsPageSize) break;
+    }
+
+    LOG_INFO("market cap ranks refreshed", logging::kv("coins", ranks->size()));
+    return ranks;
+}
@@ -0,0 +1,147 @@
+#include <coin_listing.h>
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <string_view>
+
+namespace {
+
+constexpr uint32_t kUnranked = std::numeric_limits<uint32_t>::max();
+
+// Keeps the longest possible line short enough that a full page stays under
+// Discord's 2000 character message limit. Name and symbol limits count the
+// escaped text.
+constexpr size_t kMaxNameLength = 40;
+constexpr size_t kMaxSymbolLength = 12;
+constexpr size_t kMaxIdLength = 48;
+
+struct listed_coin {
+    const gecko::coin_entry* entry;
+    const std::string* symbol;
+    uint32_t rank;
+    std::string sort_name;
+};
+
+// Cut to `limit` bytes without splitting a UTF-8 sequence
+std::string_view clip(std::string_view text, size_t limit) {
+    if (text.size() <= limit) return text;
+    size_t end = limit;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) end--;
+    return text.substr(0, end);
+}
+
+bool is_markdown(char c) {
+    return c == '*' || c == '_' || c == '~' || c == '`' || c == '|' || c == '\\' || c == '>';
+}
+
+// Coin names are free text; keep them from turning into markdown. At most
+// `limit` bytes are appended, without splitting an escape or a UTF-8 sequence.
+void append_escaped(std::string& out, std::string_view text, size_t limit) {
+    size_t used = 0;
+    size_t end = 0;
+    for (; end < text.size(); end++) {
+        size_t cost = is_markdown(text[end]) ? 2 : 1;
+        if (used + cost > limit) break;
+        used += cost;
+    }
+    for (char c : clip(text, end)) {
+        if (is_markdown(c)) out += '\\';
+        out += c;
+    }
+}
+
+void append_upper(std::string& out, std::string_view text) {
+    for (char c : text) out += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+}
+
+std::vector<std::string> render(const std::vector<const listed_coin*>& coins, const char* title,
+                                std::chrono::system_clock::time_point built_at) {
+    size_t pages = std::max<size_t>(1, (coins.size() + gecko::coin_listing::kPageSize - 1) / gecko::coin_listing::kPageSize);
+    std::string footer = "\n_Coin list updated <t:" +
+                         std::to_string(std::chrono::duration_cast<std::chrono::seconds>(built_at.time_since_epoch()).count()) +
+                         ":R>_";
+
+    std::vector<std::string> out;
+    out.reserve(pages);
+    for (size_t page = 0; page < pages; page++) {
+        std::string content = ":coin: **Coins by ";
+        content += title;
+        content += "** (page " + std::to_string(page + 1) + "/" + std::to_string(pages) + ", " +
+                   std::to_string(coins.size()) + " coins)\n";
+
+        size_t first = page * gecko::coin_listing::kPageSize;
+        size_t last = std::min(coins.size(), first + gecko::coin_listing::kPageSize);
+        for (size_t i = first; i < last; i++) {
+            const listed_coin& coin = *coins[i];
+            content += "`" + std::to_string(i + 1) + ".` ";
+            append_escaped(content, coin.entry->name, kMaxNameLength);
+            content += " (";
+            std::string symbol;
+            append_upper(symbol, *coin.symbol);
+            append_escaped(content, symbol, kMaxSymbolLength);
+            content += ") - `";
+            content += clip(coin.entry->id, kMaxIdLength);
+            content += "`\n";
+        }
+        if (coins.empty()) content += "No coins listed yet.\n";
+        content += footer;
+        out.push_back(std::move(content));
+    }
+    return out;
+}
+
+}  // namespace
+
+const char* gecko::order_key(listing_order order) {
+    return order == listing_order::name ? "name" : "market_cap";
+}
+
+bool gecko::parse_order(const std::string& key, listing_order& out) {
+    if (key == "market_cap") {
+        out = listing_order::market_cap;
+    } else if (key == "name") {
+        out = listing_order::name;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+gecko::coin_listing::coin_listing(const coin_index::symbol_map& index, const coin_index::rank_map& ranks,
+                                  std::chrono::system_clock::time_point built_at) {
+    std::vector<listed_coin> coins;
+    for (const auto& [symbol, entries] : index) {
+        for (const auto& entry : entries) {
+            auto rank = ranks.find(entry.id);
+            std::string sort_name = entry.name;
+            std::transform(sort_name.begin(), sort_name.end(), sort_name.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            coins.push_back({&entry, &symbol, rank == ranks.end() ? kUnranked : rank->second, std::move(sort_name)});
+        }
+    }
+    coins_ = coins.size();
+
+    // Same order as autocomplete: market cap rank, then unranked coins by shorter id
+    std::vector<const listed_coin*> by_rank;
+    by_rank.reserve(coins.size());
+    for (const auto& coin : coins) by_rank.push_back(&coin);
+    std::sort(by_rank.begin(), by_rank.end(), [](const listed_coin* a, const listed_coin* b) {
+        if (a->rank != b->rank) return a->rank < b->rank;
+        if (a->entry->id.size() != b->entry->id.size()) return a->entry->id.size() < b->entry->id.size();
+        return a->entry->id < b->entry->id;
+    });
+
+    // Same-named coins stay in market cap order
+    std::vector<const listed_coin*> by_name = by_rank;
+    std::stable_sort(by_name.begin(), by_name.end(),
+                     [](const listed_coin* a, const listed_coin* b) { return a->sort_name < b->sort_name; });
+
+    pages_[static_cast<int>(listing_order::market_cap)] = render(by_rank, "market cap", built_at);
+    pages_[static_cast<int>(listing_order::name)] = render(by_name, "name", built_at);
+}
+
+const std::string& gecko::coin_listing::page(listing_order order, size_t index) const {
+    const auto& pages = pages_[static_cast<int>(order)];
+    return pages[std::min(index, pages.size() - 1)];
+}
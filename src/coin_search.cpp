@@ -0,0 +1,159 @@
+#include <coin_search.h>
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+namespace {
+
+constexpr uint32_t kUnranked = std::numeric_limits<uint32_t>::max();
+
+// Discord rejects choice names and values longer than this
+constexpr size_t kMaxChoiceLength = 100;
+
+std::string lowercase(std::string_view text) {
+    std::string out(text);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+}
+
+std::string uppercase(std::string_view text) {
+    std::string out(text);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return std::toupper(c); });
+    return out;
+}
+
+// What the user typed, as it appears in the keys
+std::string normalize(std::string_view typed) {
+    while (!typed.empty() && std::isspace(static_cast<unsigned char>(typed.front()))) typed.remove_prefix(1);
+    while (!typed.empty() && std::isspace(static_cast<unsigned char>(typed.back()))) typed.remove_suffix(1);
+    return lowercase(typed);
+}
+
+// Cut to Discord's limit without splitting a UTF-8 sequence
+std::string clip(std::string text) {
+    if (text.size() <= kMaxChoiceLength) return text;
+    size_t end = kMaxChoiceLength;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) end--;
+    text.resize(end);
+    return text;
+}
+
+bool starts_with(const std::string& text, std::string_view prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Keeps the `limit` best (lowest) distinct coin numbers offered, in order,
+// each with a count. Broad prefixes match thousands of coins; this never
+// holds more than `limit` of them and rejects most with one comparison.
+class best_matches {
+public:
+    using match = std::pair<uint32_t, size_t>;
+
+    explicit best_matches(size_t limit) : limit_(limit) { matches_.reserve(limit + 1); }
+
+    void offer(uint32_t coin, size_t count = 1) {
+        if (limit_ == 0 || (matches_.size() == limit_ && coin >= matches_.back().first)) return;
+        auto at = std::lower_bound(matches_.begin(), matches_.end(), coin,
+                                   [](const match& m, uint32_t c) { return m.first < c; });
+        if (at != matches_.end() && at->first == coin) return;
+        matches_.insert(at, {coin, count});
+        if (matches_.size() > limit_) matches_.pop_back();
+    }
+
+    const std::vector<match>& matches() const { return matches_; }
+
+private:
+    size_t limit_;
+    std::vector<match> matches_;
+};
+
+}  // namespace
+
+gecko::coin_search::coin_search(const coin_index::symbol_map& index, const coin_index::rank_map& ranks) {
+    for (const auto& [symbol, entries] : index) {
+        for (const auto& entry : entries) {
+            auto rank = ranks.find(entry.id);
+            coins_.push_back({entry.id, symbol, entry.name, rank == ranks.end() ? kUnranked : rank->second});
+        }
+    }
+    std::sort(coins_.begin(), coins_.end(), [](const coin& a, const coin& b) {
+        if (a.rank != b.rank) return a.rank < b.rank;
+        if (a.id.size() != b.id.size()) return a.id.size() < b.id.size();
+        return a.id < b.id;
+    });
+
+    by_symbol_.reserve(coins_.size());
+    by_id_.reserve(coins_.size());
+    by_name_.reserve(coins_.size());
+    for (uint32_t i = 0; i < coins_.size(); i++) {
+        by_symbol_.push_back({coins_[i].symbol, i});
+        by_id_.push_back({coins_[i].id, i});
+        by_name_.push_back({lowercase(coins_[i].name), i});
+    }
+
+    auto by_text = [](const key& a, const key& b) { return a.text != b.text ? a.text < b.text : a.coin < b.coin; };
+    std::sort(by_symbol_.begin(), by_symbol_.end(), by_text);
+    std::sort(by_id_.begin(), by_id_.end(), by_text);
+    std::sort(by_name_.begin(), by_name_.end(), by_text);
+
+    top_tickers_ = tickers("", kMaxChoices);
+}
+
+gecko::coin_search::key_range gecko::coin_search::find(const std::vector<key>& keys, std::string_view prefix) {
+    auto first = std::lower_bound(keys.begin(), keys.end(), prefix,
+                                  [](const key& k, std::string_view p) { return k.text < p; });
+    // Everything from `first` on is >= prefix, so the matches are a leading run
+    auto last = std::partition_point(first, keys.end(), [prefix](const key& k) { return starts_with(k.text, prefix); });
+    return {first, last};
+}
+
+std::vector<gecko::completion> gecko::coin_search::tickers(std::string_view prefix, size_t limit) const {
+    std::string typed = normalize(prefix);
+    if (!typed.empty() && typed.front() == '$') typed.erase(0, 1);
+    if (typed.empty() && limit <= top_tickers_.size()) {
+        return std::vector<completion>(top_tickers_.begin(), top_tickers_.begin() + limit);
+    }
+
+    // One candidate per symbol: its best-ranked coin and how many share the symbol
+    best_matches best(limit);
+    auto [first, last] = find(by_symbol_, typed);
+    for (auto it = first; it != last;) {
+        auto group_end = std::find_if(it, last, [it](const key& k) { return k.text != it->text; });
+        best.offer(it->coin, static_cast<size_t>(group_end - it));
+        it = group_end;
+    }
+
+    std::vector<completion> out;
+    out.reserve(best.matches().size());
+    for (const auto& [index, count] : best.matches()) {
+        const coin& c = coins_[index];
+        std::string name = uppercase(c.symbol) + " - " + c.name;
+        if (count > 1) name += " (+" + std::to_string(count - 1) + " more)";
+        out.push_back({clip(std::move(name)), clip(c.symbol)});
+    }
+    return out;
+}
+
+std::vector<gecko::completion> gecko::coin_search::coins(std::string_view prefix, size_t limit) const {
+    std::string typed = normalize(prefix);
+
+    best_matches best(limit);
+    if (typed.empty()) {
+        // Nothing typed yet: the top of the ranking
+        for (uint32_t i = 0; i < std::min(limit, coins_.size()); i++) best.offer(i);
+    } else {
+        for (const auto* keys : {&by_id_, &by_symbol_, &by_name_}) {
+            auto [first, last] = find(*keys, typed);
+            for (auto it = first; it != last; ++it) best.offer(it->coin);
+        }
+    }
+
+    std::vector<completion> out;
+    out.reserve(best.matches().size());
+    for (const auto& match : best.matches()) {
+        const coin& c = coins_[match.first];
+        out.push_back({clip(c.name + " (" + uppercase(c.symbol) + ") - " + c.id), clip(c.id)});
+    }
+    return out;
+}
@@ -1,416 +1,1336 @@
+#include <chart_cache.h>
+#include <coin_index.h>
+#include <coin_search.h>
 #include <coingecko.h>
+#include <command_router.h>
+#include <downsample.h>
 #include <exception>
+#include <fx_rates.h>
+#include <http_client.h>
+#include <json_stream.h>
+#include <local_chart.h>
+#include <logging.h>
+#include <metrics.h>
+#include <price_alerts.h>
+#include <price_batcher.h>
+#include <price_cache.h>
+#include <price_format.h>
 #include <quickchart.h>
-#include <iomanip>
-#include <locale>
+#include <series_store.h>
+#include <ticker_board.h>
+#include <watchlists.h>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
 
 using json = nlohmann::json;
 
-// CoinGecko requires a descriptive User-Agent or it returns HTTP 403.
-static const char* kUserAgent = "crypto-prices-slash-bot-cpp/1.0 (+https://github.com/asiantbd/crypto-prices-slash-bot-cpp)";
+using steady_clock = std::chrono::steady_clock;
 
-// Function to set locale (currency format) settings
-// Return locale::classic() if desired locale not available on running system
-std::locale get_locale(const std::string& name) {
-    try {
-        return std::locale(name);
-    } catch (const std::runtime_error&) {
-        std::cerr << "Warning: Locale '" << name << "' not available. Using classic locale." << std::endl;
-        return std::locale::classic();
+// Milliseconds since `start`, for the latency field of reply records
+static double elapsed_ms(steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+// First response to an interaction: a reply, or an edit of the "thinking..."
+// placeholder when the command router already deferred it
+static void respond(const dpp::interaction_create_t& event, const char* command, const dpp::message& msg) {
+    if (commands::deferred()) {
+        event.edit_original_response(msg);
+        return;
+    }
+    event.reply(msg);
+    commands::record_ack(event, command);
+}
+
+// Show "thinking..." while the reply is worked on, unless the router already did
+static void defer(const dpp::interaction_create_t& event, const char* command, bool ephemeral = false) {
+    if (commands::deferred()) return;
+    event.thinking(ephemeral);
+    commands::record_ack(event, command);
+}
+
+static metrics::labeled<metrics::histogram> command_durations(
+    "bot_command_duration_seconds", "Time from handling a command to its final reply", {"command"});
+static metrics::labeled<metrics::counter> command_errors("bot_command_errors_total",
+                                                          "Commands answered with an error", {"command"});
+static metrics::labeled<metrics::histogram> parse_times("bot_json_parse_seconds", "Time spent parsing upstream JSON",
+                                                        {"document"});
+static metrics::labeled<metrics::histogram> autocomplete_times("bot_autocomplete_seconds",
+                                                               "Time to build an autocomplete reply", {"option"});
+
+// Record the end-to-end latency and outcome of a command reply
+static void record_reply(const char* command, steady_clock::time_point start, bool ok) {
+    command_durations.get(command).observe_since(start);
+    if (!ok) command_errors.get(command).inc();
+}
+
+// Record CPU time spent parsing one upstream document
+static void record_parse(const char* document, steady_clock::duration elapsed) {
+    parse_times.get(document).observe(elapsed);
+}
+
+static gecko::reply text_reply(std::string content) {
+    gecko::reply r;
+    r.ok = true;
+    r.content = std::move(content);
+    return r;
+}
+
+static gecko::reply error_reply(const std::string& message) {
+    gecko::reply r;
+    r.content = message;
+    return r;
+}
+
+// Turn a reply into a Discord message
+static dpp::message to_message(const gecko::reply& r) {
+    dpp::message msg(r.content);
+    if (!r.file_name.empty()) msg.add_file(r.file_name, r.file_data, r.file_type);
+    for (const auto& embed : r.embeds) msg.add_embed(embed);
+    return msg;
+}
+
+// Record and log a reply that has just been sent
+static void replied(const char* command, steady_clock::time_point start, const gecko::reply& r) {
+    record_reply(command, start, r.ok);
+    if (r.ok) {
+        LOG_INFO("command reply", logging::kv("command", command), logging::kv("latency_ms", elapsed_ms(start)));
+    } else {
+        LOG_WARN("command failed", logging::kv("command", command), logging::kv("error", r.content),
+                 logging::kv("latency_ms", elapsed_ms(start)));
     }
 }
 
-// Determine precision value from str
-int determine_precision_from_str(std::string value) {
-    // Find the decimal point
-    size_t decimal_pos = value.find('.');
-    if (decimal_pos == std::string::npos) return 0;  // No decimal point
+// Replace a deferred ("thinking...") response with `r`
+static void edit_reply(const dpp::interaction_create_t& event, const char* command,
+                       steady_clock::time_point start, const gecko::reply& r) {
+    event.edit_original_response(to_message(r));
+    replied(command, start, r);
+}
+
+static gecko::chart_options chart_settings;
+
+void gecko::configure_charts(const chart_options& options) {
+    chart_settings = options;
+}
+
+static std::string coingecko_base_url = "https://api.coingecko.com/api/v3";
+
+void gecko::configure_base_url(const std::string& url) {
+    coingecko_base_url = url;
+    while (!coingecko_base_url.empty() && coingecko_base_url.back() == '/') coingecko_base_url.pop_back();
+}
+
+const std::string& gecko::base_url() {
+    return coingecko_base_url;
+}
+
+static std::unique_ptr<http::rate_limiter> coingecko_limiter;
+
+// Interactive lookups give up quickly; the user is already looking at "thinking..."
+static constexpr std::chrono::milliseconds kInteractiveMaxWait{10000};
+
+static const std::string kRateLimitMessage = ":exclamation: Rate limit exceeded. Please try again later.";
+
+// Lowercase `currency` and check the exchange rate table knows it. USD is
+// what CoinGecko is asked for, so it needs no table.
+static bool check_currency(std::string& currency, std::string& error) {
+    std::transform(currency.begin(), currency.end(), currency.begin(), ::tolower);
+    if (currency == "usd") return true;
+
+    auto& fx = gecko::fx_rates::instance();
+    gecko::currency_rate rate;
+    if (!fx.ready()) {
+        error = ":exclamation: Exchange rates are still loading, please try again shortly";
+        return false;
+    }
+    if (!fx.find(currency, rate)) {
+        error = ":exclamation: Unsupported currency: " + currency;
+        return false;
+    }
+    return true;
+}
 
-    // Calculate precision
-    int precision = value.length() - decimal_pos - 1;
+void gecko::configure_rate_limit(double requests_per_minute, double burst) {
+    coingecko_limiter = std::make_unique<http::rate_limiter>("coingecko", requests_per_minute, burst);
+}
 
-    // Ensure precision is under 10
-    return std::max(0, std::min(precision, 10));
+http::rate_limiter* gecko::rate_limiter() {
+    return coingecko_limiter.get();
 }
 
-// This callback function is called by curl_easy_perform() to write the response
-// data into a string
-size_t gecko::write_callback(char* ptr, size_t size, size_t nmemb,
-                             std::string* data) {
-  data->append(ptr, size * nmemb);
-  return size * nmemb;
+void gecko::ping(const dpp::slashcommand_t& event) {
+    respond(event, "ping", dpp::message("Pong!"));
 }
 
-void gecko::fetch_price(dpp::slashcommand_t event) {
+void gecko::fetch_price(const dpp::slashcommand_t& event) {
     bool has_id = event.get_parameter("coingecko_id").index() != 0;
     bool has_ticker = event.get_parameter("ticker").index() != 0;
 
-    std::cout << "=============================" << std::endl;
-    std::cout << ">> fetch_price called with:" << std::endl;
-    std::cout << "has_id: " << has_id << std::endl;
-    std::cout << "has_ticker: " << has_ticker << std::endl;
+    LOG_DEBUG("fetch_price", logging::kv("has_id", has_id), logging::kv("has_ticker", has_ticker));
 
     if (!has_id && !has_ticker) {
-        event.reply(":exclamation: Please provide either coingecko_id or ticker");
+        respond(event, "price", dpp::message(":exclamation: Please provide either coingecko_id or ticker"));
         return;
     }
 
+    // Optional; without it the reply shows USD and IDR
+    std::string currency;
+    if (event.get_parameter("currency").index() != 0) {
+        currency = std::get<std::string>(event.get_parameter("currency"));
+        std::string error;
+        if (!check_currency(currency, error)) {
+            respond(event, "price", dpp::message(error));
+            return;
+        }
+    }
+
     if (has_ticker) {
         std::string ticker = std::get<std::string>(event.get_parameter("ticker"));
 
         // Strip $ if it exists at the beginning
         if (!ticker.empty() && ticker[0] == '$') {
             ticker = ticker.substr(1);
-            std::cout << ">> stripped $ from ticker: " << ticker << std::endl;
         }
 
         // Convert ticker to lowercase
         std::transform(ticker.begin(), ticker.end(), ticker.begin(), ::tolower);
-        std::cout << ">> fetching by ticker (lowercase): " << ticker << std::endl;
 
-        CURL* list_curl = curl_easy_init();
-        if (!list_curl) {
-            std::cerr << "Error: could not initialize libcurl" << std::endl;
+        auto& index = coin_index::instance();
+        if (!index.ready()) {
+            respond(event, "price", dpp::message(":exclamation: Coin list is still loading, please try again shortly"));
             return;
         }
 
-        std::string list_url = "https://api.coingecko.com/api/v3/coins/list";
-        std::string list_response;
-
-        curl_easy_setopt(list_curl, CURLOPT_URL, list_url.c_str());
-        curl_easy_setopt(list_curl, CURLOPT_USERAGENT, kUserAgent);
-        curl_easy_setopt(list_curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(list_curl, CURLOPT_WRITEDATA, &list_response);
+        std::vector<coin_entry> matching_coins = index.find(ticker);
+        LOG_DEBUG("ticker lookup", logging::kv("ticker", ticker), logging::kv("matches", matching_coins.size()));
 
-        CURLcode list_res = curl_easy_perform(list_curl);
-        if (list_res != CURLE_OK) {
-            std::cerr << "Error: curl_easy_perform() failed: "
-                      << curl_easy_strerror(list_res) << std::endl;
-            curl_easy_cleanup(list_curl);
-            event.reply(":exclamation: Failed to fetch coin list");
+        if (matching_coins.empty()) {
+            respond(event, "price", dpp::message(":exclamation: No coins found with ticker: " + ticker));
             return;
         }
 
-        curl_easy_cleanup(list_curl);
-
-        try {
-            json coins_list = json::parse(list_response);
-            std::vector<std::pair<std::string, std::string>> matching_coins; // pairs of (id, name)
-
-            std::cout << ">> searching for matching IDs for ticker: " << ticker << std::endl;
-
-            for (const auto& coin : coins_list) {
-                // Convert coin symbol to lowercase for comparison
-                std::string coin_symbol = coin["symbol"].get<std::string>();
-                std::transform(coin_symbol.begin(), coin_symbol.end(), coin_symbol.begin(), ::tolower);
-
-                if (coin_symbol == ticker) {
-                    matching_coins.push_back({
-                        coin["id"].get<std::string>(),
-                        coin["name"].get<std::string>()
-                    });
-                }
+        if (matching_coins.size() == 1) {
+            // If only one match, fetch price directly
+            const dpp::interaction_create_t& interaction_event = event;
+            fetch_single_price(matching_coins[0].id, currency, interaction_event);
+        } else {
+            // Create a select menu for multiple matches
+            dpp::message msg(event.command.channel_id, "Multiple coins found with ticker " + ticker + ". Please select one:");
+
+            // Create select menu
+            dpp::component select_menu;
+            select_menu.type = dpp::cot_selectmenu;
+            // The currency rides along after the last ':' (empty for none) so the
+            // selection can be answered in it; tickers may contain ':' themselves
+            select_menu.custom_id = "coin_select_" + ticker + ":" + currency;
+            select_menu.placeholder = "Select a coin";
+
+            // Add options to the select menu
+            for (const auto& coin : matching_coins) {
+                dpp::select_option option;
+                option.label = coin.name;          // Display name
+                option.value = coin.id;            // CoinGecko ID
+                option.description = "CoinGecko ID: " + coin.id;
+                select_menu.options.push_back(option);
             }
 
-            std::cout << ">> found " << matching_coins.size() << " matching IDs" << std::endl;
+            // Create action row
+            dpp::component action_row;
+            action_row.type = dpp::cot_action_row;
+            action_row.components.push_back(select_menu);
 
-            if (matching_coins.empty()) {
-                event.reply(":exclamation: No coins found with ticker: " + ticker);
-                return;
-            }
+            // Add the action row to the message
+            msg.components.push_back(action_row);
 
-            if (matching_coins.size() == 1) {
-                // If only one match, fetch price directly
-                const dpp::interaction_create_t& interaction_event = event;
-                fetch_single_price(matching_coins[0].first, interaction_event);
-            } else {
-                // Create a select menu for multiple matches
-                dpp::message msg(event.command.channel_id, "Multiple coins found with ticker " + ticker + ". Please select one:");
-
-                // Create select menu
-                dpp::component select_menu;
-                select_menu.type = dpp::cot_selectmenu;
-                select_menu.custom_id = "coin_select_" + ticker;
-                select_menu.placeholder = "Select a coin";
-
-                // Add options to the select menu
-                for (const auto& coin : matching_coins) {
-                    dpp::select_option option;
-                    option.label = coin.second;         // Display name
-                    option.value = coin.first;          // CoinGecko ID
-                    option.description = "CoinGecko ID: " + coin.first;
-                    select_menu.options.push_back(option);
-                }
-
-                // Create action row
-                dpp::component action_row;
-                action_row.type = dpp::cot_action_row;
-                action_row.components.push_back(select_menu);
-
-                // Add the action row to the message
-                msg.components.push_back(action_row);
-
-                // Reply with the selection menu
-                event.reply(msg);
-            }
-
-        } catch (const std::exception& e) {
-            std::cerr << "Error parsing coin list: " << e.what() << std::endl;
-            event.reply(":exclamation: Error processing coin list");
-            return;
+            // Reply with the selection menu
+            respond(event, "price", msg);
         }
     } else {
         std::string coingecko_id = std::get<std::string>(event.get_parameter("coingecko_id"));
-        std::cout << ">> fetching by coingecko_id: " << coingecko_id << std::endl;
-        fetch_single_price(coingecko_id, event);
+        fetch_single_price(coingecko_id, currency, event);
     }
 }
 
-void gecko::fetch_single_price(const std::string& coingecko_id, const dpp::interaction_create_t& event) {
-    std::cout << "=============================" << std::endl;
-    std::cout << ">> fetch_single_price called for: " << coingecko_id << std::endl;
+static std::string not_found_message(const std::string& coingecko_id) {
+    return ":exclamation: No price data found for " + coingecko_id;
+}
+
+double gecko::idr_price(const price_quote& quote) {
+    double idr = 0;
+    if (!fx_rates::instance().from_usd(quote.usd, "idr", idr)) return 0;
+    return idr;
+}
 
-    // Acknowledge the interaction first
-    event.thinking();
+// Extract one coin's prices from a parsed /simple/price response
+static gecko::price_result parse_coin_price(const std::string& coingecko_id, const json& response_json) {
+    gecko::price_result result;
+    try {
+        // Check if the response contains data for the requested coin
+        if (response_json.empty() || !response_json.contains(coingecko_id)) {
+            result.error = not_found_message(coingecko_id);
+            return result;
+        }
 
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        std::cerr << "Error: could not initialize libcurl" << std::endl;
-        return;
-    }
+        const json& coin_json = response_json[coingecko_id];
 
-    std::string url = "https://api.coingecko.com/api/v3/simple/price?ids=" +
-                      coingecko_id + "&vs_currencies=usd%2Cidr";
+        // Only USD is requested; every other currency is converted locally
+        if (!coin_json.contains("usd")) {
+            result.error = ":exclamation: Incomplete price data for " + coingecko_id;
+            return result;
+        }
 
-    std::cout << ">> requesting URL: " << url << std::endl;
+        // Handle different numeric types in the JSON
+        if (!coin_json["usd"].is_number()) {
+            result.error = ":exclamation: Invalid USD price format for " + coingecko_id;
+            return result;
+        }
 
-    std::string response_data;
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, kUserAgent);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
+        result.quote.usd = coin_json["usd"].get<double>();
+        // Show as many decimals as CoinGecko sent
+        result.quote.usd_precision = pricefmt::precision_of(result.quote.usd);
 
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        std::cerr << "Error: curl_easy_perform() failed: "
-                  << curl_easy_strerror(res) << std::endl;
-        curl_easy_cleanup(curl);
-        event.reply(":exclamation: Failed to fetch price data for " + coingecko_id);
-        return;
+        // Null for coins without enough trading history
+        if (coin_json.contains("usd_24h_change") && coin_json["usd_24h_change"].is_number()) {
+            result.quote.has_change = true;
+            result.quote.usd_24h_change = coin_json["usd_24h_change"].get<double>();
+        }
+        result.ok = true;
+
+    } catch (const std::exception& e) {
+        LOG_ERROR("error processing price data", logging::kv("coin", coingecko_id), logging::kv("error", e.what()));
+        result.error = ":exclamation: Error processing price data for " + coingecko_id;
     }
+    return result;
+}
+
+// Parse a /simple/price response covering every id in `ids`
+static gecko::quote_map parse_price_response(const std::vector<std::string>& ids, const std::string& response_data) {
+    gecko::quote_map results;
+
+    // Give every id the same error when the response as a whole is unusable
+    auto fail_all = [&](const std::function<std::string(const std::string&)>& message) {
+        for (const auto& id : ids) {
+            results[id].error = message(id);
+        }
+        return results;
+    };
 
     try {
+        auto parse_start = steady_clock::now();
         json response_json = json::parse(response_data);
-        std::cout << ">> coingecko response: " << response_json << std::endl;
+        record_parse("simple_price", steady_clock::now() - parse_start);
+        LOG_DEBUG("coingecko response", logging::kv("body", response_data));
 
         // Check if the response contains error status
         if (response_json.contains("status") && response_json["status"].contains("error_code")) {
             if (response_json["status"]["error_code"] == 429) {
-                event.edit_original_response(dpp::message(":exclamation: Rate limit exceeded. Please try again later."));
-                curl_easy_cleanup(curl);
-                return;
+                return fail_all([](const std::string&) { return kRateLimitMessage; });
             }
-            std::stringstream error_msg;
-            error_msg << ":exclamation: Error fetching price data for " << coingecko_id
-                     << " , (" << response_json["status"]["error_code"].get<int>()
-                     << ") " << response_json["status"]["error_message"].get<std::string>();
-            event.edit_original_response(dpp::message(error_msg.str()));
-            curl_easy_cleanup(curl);
-            return;
+            int error_code = response_json["status"]["error_code"].get<int>();
+            std::string error_message = response_json["status"]["error_message"].get<std::string>();
+            return fail_all([&](const std::string& coingecko_id) {
+                std::stringstream error_msg;
+                error_msg << ":exclamation: Error fetching price data for " << coingecko_id
+                          << " , (" << error_code << ") " << error_message;
+                return error_msg.str();
+            });
         }
 
-        // Check if the response contains data for the requested coin
-        if (response_json.empty() || !response_json.contains(coingecko_id)) {
-            event.edit_original_response(dpp::message(":exclamation: No price data found for " + coingecko_id));
-            curl_easy_cleanup(curl);
-            return;
+        for (const auto& id : ids) {
+            results[id] = parse_coin_price(id, response_json);
         }
+    } catch (const json::parse_error& e) {
+        LOG_ERROR("failed to parse price response", logging::kv("error", e.what()));
+        return fail_all([](const std::string& coingecko_id) {
+            return ":exclamation: Failed to parse price data for " + coingecko_id;
+        });
+    } catch (const std::exception& e) {
+        LOG_ERROR("error processing price data", logging::kv("error", e.what()));
+        return fail_all([](const std::string& coingecko_id) {
+            return ":exclamation: Error processing price data for " + coingecko_id;
+        });
+    }
+    return results;
+}
 
-        // Check if the coin data contains both USD and IDR prices
-        if (!response_json[coingecko_id].contains("usd") ||
-            !response_json[coingecko_id].contains("idr")) {
-            event.edit_original_response(dpp::message(":exclamation: Incomplete price data for " + coingecko_id));
-            curl_easy_cleanup(curl);
-            return;
+// Append an amount in `currency`: "Rp.1.234,5" for IDR, "1,234.56 EUR" for
+// anything other than USD
+static void append_amount(std::string& out, double value, int precision, const std::string& currency) {
+    if (currency == "idr") {
+        out += "Rp.";
+        pricefmt::append(out, value, precision, pricefmt::idr);
+        return;
+    }
+    pricefmt::append(out, value, precision, pricefmt::usd);
+    out += ' ';
+    for (char c : currency) out += static_cast<char>(::toupper(static_cast<unsigned char>(c)));
+}
+
+// Build the user-facing price reply for a successful lookup. Without a
+// `currency` the price is shown in USD and IDR, otherwise in USD and that
+// currency.
+static std::string format_price_reply(const std::string& coingecko_id, const gecko::price_quote& quote,
+                                      const std::string& currency) {
+    std::string reply;
+    reply.reserve(64 + coingecko_id.size());
+    reply += ":information_source: ";
+    reply += coingecko_id;
+    reply += " price: $";
+    pricefmt::append(reply, quote.usd, quote.usd_precision, pricefmt::usd);
+    if (currency.empty()) {
+        // Not shown until the exchange rates have loaded
+        double idr = gecko::idr_price(quote);
+        if (idr > 0) {
+            reply += " / ";
+            append_amount(reply, idr, pricefmt::display_precision(idr), "idr");
+        }
+    } else if (currency != "usd") {
+        double converted = 0;
+        if (gecko::fx_rates::instance().from_usd(quote.usd, currency, converted)) {
+            reply += " / ";
+            append_amount(reply, converted, pricefmt::display_precision(converted), currency);
+        }
+    }
+    return reply;
+}
+
+bool gecko::valid_id(const std::string& coingecko_id) {
+    if (coingecko_id.empty()) return false;
+    return std::all_of(coingecko_id.begin(), coingecko_id.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_';
+    });
+}
+
+void gecko::fetch_quotes(const std::vector<std::string>& ids, std::function<void(const quote_map&)> done,
+                         http::priority prio) {
+    // Ids share the URL with other callers' ones, so anything that could
+    // change its meaning stays out of it
+    quote_map rejected;
+    std::string joined_ids;
+    for (const auto& id : ids) {
+        if (!valid_id(id)) {
+            rejected[id].error = not_found_message(id);
+            continue;
         }
+        if (!joined_ids.empty()) joined_ids += "%2C";
+        joined_ids += id;
+    }
+    if (joined_ids.empty()) {
+        done(rejected);
+        return;
+    }
 
-        // Safely extract price values
-        std::string usd_value_str;
-        std::string idr_value_str;
+    std::string url = base_url() + "/simple/price?ids=" +
+                      joined_ids + "&vs_currencies=usd&include_24hr_change=true";
 
-        // Handle different numeric types in the JSON
-        if (response_json[coingecko_id]["usd"].is_number()) {
-            usd_value_str = response_json[coingecko_id]["usd"].dump();
-            std::cout << ">> USD value string: " << usd_value_str << std::endl;
-        } else {
-            event.edit_original_response(dpp::message(":exclamation: Invalid USD price format for " + coingecko_id));
-            curl_easy_cleanup(curl);
+    LOG_DEBUG("requesting prices", logging::kv("url", url), logging::kv("ids", ids.size()));
+
+    http::request req;
+    req.url = url;
+    req.prio = prio;
+    req.limiter = rate_limiter();
+    if (prio == http::priority::interactive) req.max_wait = kInteractiveMaxWait;
+
+    http::perform_async(std::move(req), [ids, rejected, done](http::response res) {
+        quote_map results = rejected;
+        if (!res.ok() || res.status == 429) {
+            bool limited = res.throttled || res.status == 429;
+            for (const auto& id : ids) {
+                if (rejected.count(id)) continue;
+                results[id].error = limited ? kRateLimitMessage : ":exclamation: Failed to fetch price data for " + id;
+            }
+            done(results);
             return;
         }
+        for (auto& [id, result] : parse_price_response(ids, res.body)) {
+            if (!rejected.count(id)) results[id] = std::move(result);
+        }
+        done(results);
+    });
+}
 
-        if (response_json[coingecko_id]["idr"].is_number()) {
-            idr_value_str = response_json[coingecko_id]["idr"].dump();
-            std::cout << ">> IDR value string: " << idr_value_str << std::endl;
-        } else {
-            event.edit_original_response(dpp::message(":exclamation: Invalid IDR price format for " + coingecko_id));
-            curl_easy_cleanup(curl);
+void gecko::fetch_quote(const std::string& coingecko_id, std::function<void(const price_result&)> done) {
+    // Keep a malformed id from breaking the batch it would share
+    if (!valid_id(coingecko_id)) {
+        price_result result;
+        result.error = not_found_message(coingecko_id);
+        done(result);
+        return;
+    }
+    price_batcher::instance().enqueue(coingecko_id, std::move(done));
+}
+
+bool gecko::cached_price_reply(const std::string& coingecko_id, const std::string& currency, reply& out) {
+    price_quote cached;
+    if (!price_cache::instance().lookup(coingecko_id, cached)) return false;
+    out = text_reply(format_price_reply(coingecko_id, cached, currency));
+    return true;
+}
+
+void gecko::price_reply(const std::string& coingecko_id, const std::string& currency, reply_callback done) {
+    price_cache::instance().fetch(coingecko_id, [coingecko_id, currency, done](const price_result& result) {
+        if (!result.ok) {
+            done(error_reply(result.error));
             return;
         }
+        reply r = text_reply(format_price_reply(coingecko_id, result.quote, currency));
+        if (result.stale) r.content += "\n_CoinGecko is busy, showing the last cached price._";
+        done(r);
+    });
+}
+
+void gecko::fetch_single_price(const std::string& coingecko_id, const std::string& currency,
+                               const dpp::interaction_create_t& event) {
+    auto start = steady_clock::now();
+
+    // Answer straight from the cache when we can
+    reply cached;
+    if (cached_price_reply(coingecko_id, currency, cached)) {
+        respond(event, "price", dpp::message(cached.content));
+        replied("price", start, cached);
+        return;
+    }
+
+    // Acknowledge the interaction first
+    defer(event, "price");
 
-        // Remove any quotes that might be present in the string
-        usd_value_str.erase(remove(usd_value_str.begin(), usd_value_str.end(), '"'), usd_value_str.end());
-        idr_value_str.erase(remove(idr_value_str.begin(), idr_value_str.end(), '"'), idr_value_str.end());
+    price_reply(coingecko_id, currency, [event, start, slot = commands::hold()](const reply& r) {
+        edit_reply(event, "price", start, r);
+    });
+}
 
-        // Safe conversion to double with error checking
-        double usd_value, idr_value;
-        try {
-            size_t usd_pos, idr_pos;
-            usd_value = std::stod(usd_value_str, &usd_pos);
-            idr_value = std::stod(idr_value_str, &idr_pos);
+namespace {
 
-            std::cout << ">> Converted USD value: " << usd_value << std::endl;
-            std::cout << ">> Converted IDR value: " << idr_value << std::endl;
+// Streams /market_chart ({"prices": [[ts, price], ...], ...}) keeping only the
+// price series. Error payloads ({"error": ...} or {"status": {"error_code": ...}})
+// are picked up too.
+class market_chart_handler : public jsonstream::sax_handler {
+public:
+    std::vector<long> timestamps;
+    std::vector<double> prices;
+    std::string error;
+    long error_code = 0;
 
-            if (usd_pos != usd_value_str.length() || idr_pos != idr_value_str.length()) {
-                throw std::invalid_argument("Invalid number format");
+    bool start_object(std::size_t) override {
+        depth_++;
+        return true;
+    }
+
+    bool end_object() override {
+        depth_--;
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        if (++depth_ == 3 && section_ == section::prices) element_ = 0;
+        return true;
+    }
+
+    bool end_array() override {
+        if (depth_-- == 3 && section_ == section::prices && element_ == 2) {
+            timestamps.push_back(timestamp_);
+            prices.push_back(price_);
+        }
+        return true;
+    }
+
+    bool key(string_t& key) override {
+        if (depth_ == 1) {
+            if (key == "prices") {
+                section_ = section::prices;
+            } else if (key == "error") {
+                section_ = section::error;
+            } else if (key == "status") {
+                section_ = section::status;
+            } else {
+                section_ = section::other;
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Error converting price values: " << e.what() << std::endl;
-            event.edit_original_response(dpp::message(":exclamation: Invalid price format for " + coingecko_id));
-            curl_easy_cleanup(curl);
-            return;
+        } else if (depth_ == 2 && section_ == section::status) {
+            in_error_code_ = key == "error_code";
         }
+        return true;
+    }
 
-        // Format the values
-        std::stringstream ss_usd;
-        ss_usd.imbue(get_locale("en_US.UTF-8"));
-        ss_usd << std::fixed
-               << std::setprecision(determine_precision_from_str(usd_value_str))
-               << usd_value;
+    bool string(string_t& value) override {
+        if (depth_ == 1 && section_ == section::error) error = std::move(value);
+        return true;
+    }
 
-        std::stringstream ss_idr;
-        ss_idr.imbue(get_locale("id_ID.UTF-8"));
-        ss_idr << std::fixed
-               << std::setprecision(determine_precision_from_str(idr_value_str))
-               << idr_value;
+    bool number_integer(number_integer_t value) override {
+        return number(static_cast<double>(value));
+    }
 
-        std::cout << ">> Formatted USD: " << ss_usd.str() << std::endl;
-        std::cout << ">> Formatted IDR: " << ss_idr.str() << std::endl;
+    bool number_unsigned(number_unsigned_t value) override {
+        return number(static_cast<double>(value));
+    }
 
-        // Reply with formatted price
-        event.edit_original_response(dpp::message(":information_source: " + coingecko_id +
-                   " price: $" + ss_usd.str() +
-                   " / Rp." + ss_idr.str()));
+    bool number_float(number_float_t value, const string_t&) override {
+        return number(value);
+    }
 
-    } catch (const json::parse_error& e) {
-        std::cerr << "JSON parsing error: " << e.what() << std::endl;
-        event.edit_original_response(dpp::message(":exclamation: Failed to parse price data for " + coingecko_id));
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing price data: " << e.what() << std::endl;
-        event.edit_original_response(dpp::message(":exclamation: Error processing price data for " + coingecko_id));
+private:
+    enum class section { other, prices, error, status };
+
+    bool number(double value) {
+        if (depth_ == 3 && section_ == section::prices) {
+            if (element_ == 0) {
+                timestamp_ = static_cast<long>(value);
+            } else if (element_ == 1) {
+                price_ = value;
+            }
+            element_++;
+        } else if (depth_ == 2 && section_ == section::status && in_error_code_) {
+            error_code = static_cast<long>(value);
+        }
+        return true;
     }
 
-    curl_easy_cleanup(curl);
+    int depth_ = 0;
+    section section_ = section::other;
+    bool in_error_code_ = false;
+    int element_ = 0;
+    long timestamp_ = 0;
+    double price_ = 0;
+};
+
+// GET `url` and feed the body through `handler` as it arrives. `done` gets the
+// response and whether a complete document was parsed. Parse time is
+// recorded under `document`.
+void stream_json_async(const std::string& url, const char* document, std::shared_ptr<jsonstream::sax_handler> handler,
+                       std::function<void(const http::response&, bool parsed)> done) {
+    auto parser = std::make_shared<jsonstream::parser>(*handler);
+    // Only touched on the HTTP event loop thread
+    auto parse_time = std::make_shared<steady_clock::duration>(0);
+
+    http::request req;
+    req.url = url;
+    req.prio = http::priority::normal;
+    req.limiter = gecko::rate_limiter();
+    req.on_data = [parser, parse_time](const char* data, size_t size) {
+        auto start = steady_clock::now();
+        bool ok = parser->feed(data, size);
+        *parse_time += steady_clock::now() - start;
+        return ok;
+    };
+
+    http::perform_async(std::move(req), [url, document, handler, parser, parse_time, done](http::response res) {
+        bool parsed = res.ok() && parser->finish();
+        if (parsed) record_parse(document, *parse_time);
+        if (res.ok() && !parsed) {
+            LOG_ERROR("failed to parse JSON response", logging::kv("url", url), logging::kv("error", parser->error()));
+        }
+        done(res, parsed);
+    });
 }
 
-void gecko::fetch_tokens(dpp::slashcommand_t event) {
-  CURL* curl = curl_easy_init();
-  if (!curl) {
-    std::cerr << "Error: could not initialize libcurl" << std::endl;
-    return;
+}  // namespace
+
+gecko::reply gecko::coins_reply(listing_order order, size_t page) {
+  auto listing = coin_index::instance().listing();
+  if (!listing) return error_reply(":exclamation: Coin list is still loading, please try again shortly");
+  return text_reply(listing->page(order, page));
+}
+
+// A /coins page with buttons to the first, previous, next and last page. The
+// button ids carry the order and target page: "coins_page:<order>:<page>:<button>".
+static dpp::message coins_message(gecko::listing_order order, size_t page, gecko::reply& r) {
+  auto listing = gecko::coin_index::instance().listing();
+  if (!listing) {
+    r = error_reply(":exclamation: Coin list is still loading, please try again shortly");
+    return to_message(r);
   }
+  size_t last = listing->pages() - 1;
+  page = std::min(page, last);
+  r = text_reply(listing->page(order, page));
+
+  dpp::message msg = to_message(r);
+  if (last == 0) return msg;
+  auto button = [order](const char* tag, const char* label, size_t target, bool disabled) {
+    return dpp::component()
+        .set_type(dpp::cot_button)
+        .set_style(dpp::cos_secondary)
+        .set_label(label)
+        .set_id(std::string("coins_page:") + gecko::order_key(order) + ":" + std::to_string(target) + ":" + tag)
+        .set_disabled(disabled);
+  };
+  dpp::component row;
+  row.set_type(dpp::cot_action_row)
+      .add_component(button("first", "<<", 0, page == 0))
+      .add_component(button("prev", "< Prev", page == 0 ? 0 : page - 1, page == 0))
+      .add_component(button("next", "Next >", std::min(page + 1, last), page == last))
+      .add_component(button("last", ">>", last, page == last));
+  msg.add_component(row);
+  return msg;
+}
 
-  std::string url = "https://api.coingecko.com/api/v3/coins/";
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_USERAGENT, kUserAgent);
+void gecko::fetch_tokens(const dpp::slashcommand_t& event) {
+  auto start = steady_clock::now();
+  listing_order order = listing_order::market_cap;
+  auto sort_param = event.get_parameter("sort");
+  if (const std::string* sort = std::get_if<std::string>(&sort_param)) parse_order(*sort, order);
+  auto page_param = event.get_parameter("page");
+  const int64_t* page = std::get_if<int64_t>(&page_param);
+
+  // Served from the pre-rendered listing; nothing to wait for
+  reply r;
+  respond(event, "coins", coins_message(order, page ? static_cast<size_t>(std::max<int64_t>(*page, 1) - 1) : 0, r));
+  replied("coins", start, r);
+}
 
-  std::string response_data;
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
+void gecko::turn_coins_page(const dpp::button_click_t& event) {
+  auto start = steady_clock::now();
+  // "coins_page:<order>:<page>:<button>"
+  std::vector<std::string> parts;
+  std::stringstream id(event.custom_id);
+  for (std::string part; std::getline(id, part, ':');) parts.push_back(part);
+  listing_order order = listing_order::market_cap;
+  if (parts.size() != 4 || !parse_order(parts[1], order)) return;
+  size_t page = std::strtoul(parts[2].c_str(), nullptr, 10);
+
+  reply r;
+  event.reply(dpp::ir_update_message, coins_message(order, page, r));
+  commands::record_ack(event, "coins_page");
+  replied("coins_page", start, r);
+}
 
-  CURLcode res = curl_easy_perform(curl);
-  if (res != CURLE_OK) {
-    std::cerr << "Error: curl_easy_perform() failed: "
-              << curl_easy_strerror(res) << std::endl;
-    curl_easy_cleanup(curl);
+void gecko::fetch_price_history(const std::string& coingecko_id, int days, int64_t from_ms,
+                                std::function<void(const price_history&)> done) {
+  if (!valid_id(coingecko_id)) {
+    price_history history;
+    history.error = not_found_message(coingecko_id);
+    done(history);
     return;
   }
 
-  try {
-    json response_json = json::parse(response_data);
-    std::cout << "=============================" << std::endl;
-    std::cout << ">> coingecko response: " << response_json << std::endl;
-    std::string tokens;
-    for (auto& token : response_json) {
-      tokens.append("- ");
-      tokens.append(token["id"]);
-      tokens.append("\n");
+  std::string url = base_url() + "/coins/" + coingecko_id + "/market_chart";
+  if (days > 0) {
+    url += "?vs_currency=usd&days=" + std::to_string(days);
+  } else {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    url += "/range?vs_currency=usd&from=" + std::to_string(from_ms / 1000) + "&to=" + std::to_string(now);
+  }
+
+  auto handler = std::make_shared<market_chart_handler>();
+  stream_json_async(url, days > 0 ? "market_chart" : "market_chart_range", handler,
+                    [coingecko_id, days, handler, done](const http::response& res, bool parsed) {
+    price_history history;
+    if (res.throttled || res.status == 429 || handler->error_code == 429) {
+      history.error = kRateLimitMessage;
+    } else if (!parsed) {
+      history.error = ":exclamation: coins: error failed to call API data.";
+    } else if (!handler->error.empty()) {
+      history.error = ":exclamation: market: " + handler->error;
+    } else if (days > 0 && handler->prices.empty()) {
+      history.error = ":exclamation: market: no price data for " + coingecko_id;
+    } else {
+      // A refresh with nothing new is fine
+      history.ok = true;
+      history.timestamps = std::move(handler->timestamps);
+      history.prices = std::move(handler->prices);
+    }
+    done(history);
+  });
+}
+
+// Chart `token_id` over `range` in `vs_currency` (already validated)
+static void render_market_chart(const std::string& token_id, const std::string& vs_currency, gecko::chart_range range,
+                                gecko::reply_callback done) {
+  // The store only holds USD; other currencies are scaled by the current
+  // exchange rate
+  auto& store = gecko::series_store::instance();
+  store.fetch(token_id, range, [token_id, vs_currency, range, done](const gecko::price_history& history) {
+    if (!history.ok) {
+      done(error_reply(history.error));
+      return;
+    }
+    if (history.prices.empty()) {
+      done(error_reply(":exclamation: market: no price data for " + token_id));
+      return;
+    }
+
+    // Keep the shape of the whole range (including the latest tick) within the point budget
+    std::vector<long> timestamps = history.timestamps;
+    std::vector<double> prices = history.prices;
+    downsample::lttb(timestamps, prices, chart_settings.max_points);
+
+    if (vs_currency != "usd") {
+      double rate = 0;
+      if (!gecko::fx_rates::instance().from_usd(1.0, vs_currency, rate)) {
+        done(error_reply(":exclamation: Unsupported currency: " + vs_currency));
+        return;
+      }
+      for (double& price : prices) price *= rate;
     }
 
-    event.reply(tokens);
+    std::string label = token_id + " (" + gecko::range_key(range) + ")";
+    if (chart_settings.backend == gecko::chart_backend::local) {
+      std::string png = localchart::render_line_chart(timestamps, label, prices);
+      if (png.empty()) {
+        done(error_reply(":exclamation: market: failed to generate chart."));
+        return;
+      }
+      gecko::reply r = text_reply("");
+      r.file_name = token_id + ".png";
+      r.file_data = std::move(png);
+      r.file_type = "image/png";
+      done(r);
+      return;
+    }
 
-  } catch (const std::exception& e) {
-    std::cerr << "Error: failed to parse JSON response: " << e.what()
-              << std::endl;
-    curl_easy_cleanup(curl);
+    qchart::generate_chart(timestamps, label, prices, [done](std::string chart) {
+      if (chart.empty()) {
+        done(error_reply(":exclamation: market: failed to generate chart."));
+        return;
+      }
+      done(text_reply(std::move(chart)));
+    });
+  });
+}
 
-    event.reply(":exclamation: coins: error failed to call API data.");
+void gecko::market_chart_reply(const std::string& token_id, const std::string& currency, chart_range range,
+                               reply_callback done) {
+  std::string vs_currency = currency;
+  std::string error;
+  if (!check_currency(vs_currency, error)) {
+    done(error_reply(error));
+    return;
+  }
+  // Anything else would rewrite the upstream path, and still take a cache slot
+  if (!valid_id(token_id)) {
+    done(error_reply(not_found_message(token_id)));
+    return;
   }
 
-  curl_easy_cleanup(curl);
+  chart_cache::instance().fetch(
+      token_id, vs_currency, range,
+      [token_id, vs_currency, range](reply_callback rendered) {
+        render_market_chart(token_id, vs_currency, range, std::move(rendered));
+      },
+      std::move(done));
 }
 
-void gecko::fetch_market_chart(dpp::slashcommand_t event) {
+void gecko::fetch_market_chart(const dpp::slashcommand_t& event) {
   std::string token_id = std::get<std::string>(event.get_parameter("token_id"));
   std::string currency = std::get<std::string>(event.get_parameter("currency"));
+  chart_range range = chart_range::day;
+  auto range_param = event.get_parameter("range");
+  if (const std::string* key = std::get_if<std::string>(&range_param)) parse_range(*key, range);
+
+  auto start = steady_clock::now();
+  defer(event, "market");
+
+  market_chart_reply(token_id, currency, range, [event, start, slot = commands::hold()](const reply& r) {
+    edit_reply(event, "market", start, r);
+  });
+}
+
+// Most coins one /prices table shows, which keeps it well inside an embed's
+// 4096 character description
+static constexpr size_t kMaxTableCoins = 25;
+
+static constexpr uint32_t kUnranked = std::numeric_limits<uint32_t>::max();
+
+// Split a list like "btc, $ETH solana" into lowercase CoinGecko ids, dropping
+// duplicates. A ticker becomes its largest coin by market cap (unranked ones
+// by shorter id); a word that isn't a ticker, or is the id of a coin ranked
+// above every coin with that ticker, is taken as an id. A leading '$' always
+// means a ticker.
+static std::vector<std::string> resolve_coins(const std::string& coins) {
+  auto& index = gecko::coin_index::instance();
+  auto ranks = index.ranks();
+  auto rank_of = [&ranks](const std::string& id) {
+    if (!ranks) return kUnranked;
+    auto it = ranks->find(id);
+    return it == ranks->end() ? kUnranked : it->second;
+  };
+
+  std::string list = coins;
+  std::replace(list.begin(), list.end(), ',', ' ');
+  std::istringstream words(list);
+  std::vector<std::string> ids;
+  for (std::string word; words >> word;) {
+    std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+    bool ticker = word[0] == '$';
+    if (ticker) word.erase(0, 1);
+    if (word.empty()) continue;
+
+    std::string id = word;
+    std::vector<gecko::coin_entry> matches = index.find(word);
+    if (!matches.empty()) {
+      const gecko::coin_entry* best = &matches[0];
+      for (const auto& coin : matches) {
+        uint32_t rank = rank_of(coin.id), best_rank = rank_of(best->id);
+        if (rank < best_rank || (rank == best_rank && coin.id.size() < best->id.size())) best = &coin;
+      }
+      if (ticker || rank_of(best->id) <= rank_of(word)) id = best->id;
+    }
+    if (std::find(ids.begin(), ids.end(), id) == ids.end()) ids.push_back(std::move(id));
+  }
+  return ids;
+}
 
-  CURL* curl = curl_easy_init();
-  if (!curl) {
-    std::cerr << "Error: could not initialize libcurl" << std::endl;
+// Quotes for every id in `ids`, with their 24h change: fresh ones straight
+// from the price cache, all the others with a single /simple/price request
+// whose quotes are stored back into the cache. Words that can't be ids are
+// not found without asking.
+static void gather_quotes(const std::vector<std::string>& ids, std::function<void(const gecko::quote_map&)> done) {
+  auto& cache = gecko::price_cache::instance();
+  gecko::quote_map results;
+  std::vector<std::string> missing;
+  for (const auto& id : ids) {
+    if (!gecko::valid_id(id)) {
+      results[id].error = not_found_message(id);
+      continue;
+    }
+    gecko::price_quote cached;
+    // Quotes restored from a snapshot carry no 24h change
+    if (cache.peek(id, cached) && cached.has_change) {
+      results[id] = {true, cached, ""};
+    } else {
+      missing.push_back(id);
+    }
+  }
+  if (missing.empty()) {
+    done(results);
     return;
   }
 
-  std::string url = "https://api.coingecko.com/api/v3/coins/" + token_id +
-                    "/market_chart?vs_currency=" + currency + "&days=1";
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_USERAGENT, kUserAgent);
+  gecko::fetch_quotes(missing, [results, done](const gecko::quote_map& fetched) mutable {
+    for (const auto& [id, result] : fetched) {
+      if (result.ok) gecko::price_cache::instance().store(id, result.quote);
+      results[id] = result;
+    }
+    done(results);
+  });
+}
+
+// "`bitcoin`, `ethereum`"; words that weren't valid ids may hold backticks
+static std::string join_ids(const std::vector<std::string>& ids) {
+  std::string out;
+  for (const auto& id : ids) {
+    if (!out.empty()) out += ", ";
+    out += '`';
+    for (char c : id) {
+      if (c != '`') out += c;
+    }
+    out += '`';
+  }
+  return out;
+}
+
+// The error to show when none of `ids` has a price: the one they share (e.g.
+// the rate limit), or else which coins weren't found
+static std::string quotes_error(const std::vector<std::string>& ids, const gecko::quote_map& quotes) {
+  std::string error;
+  for (const auto& id : ids) {
+    auto it = quotes.find(id);
+    std::string message = it == quotes.end() ? "" : it->second.error;
+    if (error.empty()) {
+      error = message;
+    } else if (message != error) {
+      return ":exclamation: No price data found for " + join_ids(ids);
+    }
+  }
+  return error;
+}
 
-  std::string response_data;
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
+// An embed with a table of the coins' prices in USD and IDR (or `currency`)
+// and their 24h change
+static gecko::reply format_prices_table(const std::string& title, const std::vector<std::string>& ids,
+                                        const gecko::quote_map& quotes, const std::string& currency) {
+  std::string other = currency.empty() ? "idr" : currency;
+  std::string other_header;
+  for (char c : other) other_header += static_cast<char>(::toupper(static_cast<unsigned char>(c)));
+
+  std::vector<std::vector<std::string>> rows;
+  rows.push_back({"Coin", "USD", other_header, "24h"});
+  if (other == "usd") rows[0].erase(rows[0].begin() + 2);
+
+  std::vector<std::string> missing;
+  double total_change = 0;
+  for (const auto& id : ids) {
+    auto it = quotes.find(id);
+    if (it == quotes.end() || !it->second.ok) {
+      missing.push_back(id);
+      continue;
+    }
+    const gecko::price_quote& quote = it->second.quote;
+
+    std::vector<std::string> row;
+    row.push_back(id.size() > 24 ? id.substr(0, 23) + "~" : id);
+    std::string usd = "$";
+    pricefmt::append(usd, quote.usd, quote.usd_precision, pricefmt::usd);
+    row.push_back(std::move(usd));
+
+    // Same amounts as /price, without the currency code the header already shows
+    std::string converted;
+    double amount = 0;
+    if (other == "idr") {
+      amount = gecko::idr_price(quote);
+      if (amount > 0) append_amount(converted, amount, pricefmt::display_precision(amount), "idr");
+    } else if (other != "usd" && gecko::fx_rates::instance().from_usd(quote.usd, other, amount)) {
+      pricefmt::append(converted, amount, pricefmt::display_precision(amount), pricefmt::usd);
+    }
+    if (other != "usd") row.push_back(converted.empty() ? "-" : converted);
 
-  CURLcode res = curl_easy_perform(curl);
-  if (res != CURLE_OK) {
-    std::cerr << "Error: curl_easy_perform() failed: "
-              << curl_easy_strerror(res) << std::endl;
-    curl_easy_cleanup(curl);
+    if (quote.has_change) {
+      char change[32];
+      std::snprintf(change, sizeof(change), "%+.2f%%", quote.usd_24h_change);
+      row.push_back(change);
+      total_change += quote.usd_24h_change;
+    } else {
+      row.push_back("-");
+    }
+    rows.push_back(std::move(row));
+  }
+
+  // Coins left-aligned, amounts right-aligned
+  std::vector<size_t> widths(rows[0].size(), 0);
+  for (const auto& row : rows) {
+    for (size_t i = 0; i < row.size(); i++) widths[i] = std::max(widths[i], row[i].size());
+  }
+  std::string table = "```\n";
+  for (const auto& row : rows) {
+    for (size_t i = 0; i < row.size(); i++) {
+      std::string padding(widths[i] - row[i].size(), ' ');
+      if (i > 0) table += "  ";
+      table += i == 0 ? row[i] + padding : padding + row[i];
+    }
+    while (!table.empty() && table.back() == ' ') table.pop_back();
+    table += '\n';
+  }
+  table += "```";
+  if (!missing.empty()) table += "\nNo price data found for " + join_ids(missing);
+
+  dpp::embed embed;
+  embed.set_title(title)
+      .set_description(table)
+      .set_color(total_change < 0 ? 0xE74C3C : 0x2ECC71)
+      .set_footer(dpp::embed_footer().set_text("24h change in USD. Data from CoinGecko"))
+      .set_timestamp(std::time(nullptr));
+
+  gecko::reply r = text_reply("");
+  r.embeds.push_back(std::move(embed));
+  return r;
+}
+
+void gecko::prices_reply(uint64_t user_id, const std::string& coins, const std::string& currency,
+                         reply_callback done) {
+  // Optional; without it the table shows USD and IDR
+  std::string vs_currency = currency;
+  std::string error;
+  if (!vs_currency.empty() && !check_currency(vs_currency, error)) {
+    done(error_reply(error));
     return;
   }
 
-  try {
-    json response_json = json::parse(response_data);
-    std::vector<long> timestamps;
-    std::vector<double> prices;
-    for (auto& chart : response_json["prices"]) {
-      if (timestamps.size() == 250 && prices.size() == 250) {
-        break;
-      }
-      timestamps.push_back(chart.at(0));
-      prices.push_back(chart.at(1));
+  bool from_watchlist = coins.find_first_not_of(" ,") == std::string::npos;
+  std::vector<std::string> ids = from_watchlist ? watchlists::instance().get(user_id) : resolve_coins(coins);
+  if (ids.empty()) {
+    done(error_reply(from_watchlist ? ":exclamation: Your watchlist is empty. Add coins with /watch, or list them in coins."
+                                    : ":exclamation: Please list some coins, e.g. btc eth solana"));
+    return;
+  }
+  if (ids.size() > kMaxTableCoins) {
+    done(error_reply(":exclamation: At most " + std::to_string(kMaxTableCoins) + " coins fit in one table"));
+    return;
+  }
+
+  std::string title = from_watchlist ? "Your watchlist" : "Prices";
+  gather_quotes(ids, [title, ids, vs_currency, done](const quote_map& quotes) {
+    bool any = std::any_of(ids.begin(), ids.end(), [&quotes](const std::string& id) {
+      auto it = quotes.find(id);
+      return it != quotes.end() && it->second.ok;
+    });
+    done(any ? format_prices_table(title, ids, quotes, vs_currency) : error_reply(quotes_error(ids, quotes)));
+  });
+}
+
+void gecko::watch_reply(uint64_t user_id, const std::string& coins, reply_callback done) {
+  std::vector<std::string> ids = resolve_coins(coins);
+  if (ids.empty()) {
+    done(error_reply(":exclamation: Please list the coins to watch, e.g. btc eth solana"));
+    return;
+  }
+  if (ids.size() > kMaxTableCoins) {
+    done(error_reply(":exclamation: At most " + std::to_string(kMaxTableCoins) + " coins at a time"));
+    return;
+  }
+
+  // A coin without a price would only ever show up as missing, so unknown ids fail here
+  gather_quotes(ids, [user_id, ids, done](const quote_map& quotes) {
+    std::vector<std::string> priced;
+    std::vector<std::string> unknown;
+    for (const auto& id : ids) {
+      auto it = quotes.find(id);
+      (it != quotes.end() && it->second.ok ? priced : unknown).push_back(id);
+    }
+    if (priced.empty()) {
+      done(error_reply(quotes_error(ids, quotes)));
+      return;
+    }
+
+    auto& lists = watchlists::instance();
+    std::vector<std::string> added = lists.add(user_id, priced);
+    size_t watched = lists.get(user_id).size();
+    size_t max_coins = lists.max_coins();
+
+    std::string content = added.empty() ? ":information_source: Those coins are already on your watchlist"
+                                        : ":white_check_mark: Added " + join_ids(added) + " to your watchlist";
+    content += " (" + std::to_string(watched) + "/" + std::to_string(max_coins) + "). Show it with /prices.";
+    if (watched >= max_coins && added.size() < priced.size()) {
+      content += "\nYour watchlist is full; make room with /unwatch.";
+    }
+    if (!unknown.empty()) content += "\nNo price data found for " + join_ids(unknown);
+    done(text_reply(content));
+  });
+}
+
+gecko::reply gecko::unwatch_reply(uint64_t user_id, const std::string& coins) {
+  std::vector<std::string> ids = resolve_coins(coins);
+  if (ids.empty()) return error_reply(":exclamation: Please list the coins to remove, e.g. btc eth");
+
+  auto& lists = watchlists::instance();
+  std::vector<std::string> removed = lists.remove(user_id, ids);
+  if (removed.empty()) return error_reply(":exclamation: None of those coins are on your watchlist");
+  return text_reply(":white_check_mark: Removed " + join_ids(removed) + " from your watchlist (" +
+                    std::to_string(lists.get(user_id).size()) + "/" + std::to_string(lists.max_coins()) + ")");
+}
+
+void gecko::fetch_prices(const dpp::slashcommand_t& event) {
+  auto coins_param = event.get_parameter("coins");
+  const std::string* coins = std::get_if<std::string>(&coins_param);
+  auto currency_param = event.get_parameter("currency");
+  const std::string* currency = std::get_if<std::string>(&currency_param);
+
+  auto start = steady_clock::now();
+  defer(event, "prices");
+
+  prices_reply(event.command.usr.id, coins ? *coins : "", currency ? *currency : "",
+               [event, start, slot = commands::hold()](const reply& r) { edit_reply(event, "prices", start, r); });
+}
+
+void gecko::watch_coins(const dpp::slashcommand_t& event) {
+  std::string coins = std::get<std::string>(event.get_parameter("coins"));
+
+  auto start = steady_clock::now();
+  defer(event, "watch", true);
+
+  watch_reply(event.command.usr.id, coins,
+              [event, start, slot = commands::hold()](const reply& r) { edit_reply(event, "watch", start, r); });
+}
+
+void gecko::unwatch_coins(const dpp::slashcommand_t& event) {
+  auto start = steady_clock::now();
+  std::string coins = std::get<std::string>(event.get_parameter("coins"));
+  reply r = unwatch_reply(event.command.usr.id, coins);
+  respond(event, "unwatch", to_message(r).set_flags(dpp::m_ephemeral));
+  replied("unwatch", start, r);
+}
+
+void gecko::alert_reply(uint64_t user_id, uint64_t channel_id, const std::string& coingecko_id, double target,
+                        const std::string& currency, reply_callback done) {
+  if (!(target > 0)) {
+    done(error_reply(":exclamation: The alert price must be above zero"));
+    return;
+  }
+
+  // The current price decides the direction, and an unknown id fails here
+  price_cache::instance().fetch(coingecko_id, [=](const price_result& result) {
+    if (!result.ok) {
+      done(error_reply(result.error));
+      return;
     }
-    auto chart = qchart::generate_chart(timestamps, token_id, prices);
-    event.reply(chart);
-    std::cout << chart << std::endl;
 
-  } catch (const std::exception& e) {
-    std::cerr << "Error: failed to parse JSON response: " << e.what()
-              << std::endl;
-    curl_easy_cleanup(curl);
+    price_alert alert;
+    alert.user_id = user_id;
+    alert.channel_id = channel_id;
+    alert.coingecko_id = coingecko_id;
+    alert.currency = currency == "idr" ? alert_currency::idr : alert_currency::usd;
+    alert.target = target;
+    alert.created_at = std::chrono::system_clock::now();
+
+    double price = alert.currency == alert_currency::idr ? idr_price(result.quote) : result.quote.usd;
+    // Without a price there's no telling which way the alert should go
+    if (!(price > 0)) {
+      done(error_reply(":exclamation: Exchange rates are still loading, please try again shortly"));
+      return;
+    }
+    if (price == target) {
+      done(error_reply(":exclamation: " + coingecko_id + " is already at that price"));
+      return;
+    }
+    alert.direction = target > price ? alert_direction::above : alert_direction::below;
 
-    event.reply(":exclamation: coins: error failed to call API data.");
+    if (!alert_engine::instance().add(alert)) {
+      done(error_reply(":exclamation: You have too many alerts. Remove one with /unalert first."));
+      return;
+    }
+    done(text_reply(":bell: Alert " + describe_alert(alert) + " set. I'll ping you here."));
+  });
+}
+
+gecko::reply gecko::alerts_reply(uint64_t user_id) {
+  auto alerts = alert_engine::instance().list(user_id);
+  if (alerts.empty()) return text_reply(":information_source: You have no price alerts. Add one with /alert.");
+
+  std::string content = ":bell: Your price alerts:";
+  for (const auto& alert : alerts) {
+    content += "\n- ";
+    content += describe_alert(alert);
   }
+  return text_reply(content);
+}
 
-  curl_easy_cleanup(curl);
+gecko::reply gecko::unalert_reply(uint64_t user_id, uint64_t alert_id) {
+  if (!alert_engine::instance().remove(user_id, alert_id)) {
+    return error_reply(":exclamation: You have no alert #" + std::to_string(alert_id));
+  }
+  return text_reply(":white_check_mark: Alert #" + std::to_string(alert_id) + " removed");
+}
+
+void gecko::create_alert(const dpp::slashcommand_t& event) {
+  std::string coin = std::get<std::string>(event.get_parameter("coin"));
+  double target = std::get<double>(event.get_parameter("price"));
+  auto currency_param = event.get_parameter("currency");
+  const std::string* currency = std::get_if<std::string>(&currency_param);
+
+  auto start = steady_clock::now();
+  defer(event, "alert");
+
+  alert_reply(event.command.usr.id, event.command.channel_id, coin, target, currency ? *currency : "usd",
+              [event, start, slot = commands::hold()](const reply& r) { edit_reply(event, "alert", start, r); });
+}
+
+void gecko::list_alerts(const dpp::slashcommand_t& event) {
+  auto start = steady_clock::now();
+  reply r = alerts_reply(event.command.usr.id);
+  respond(event, "alerts", to_message(r).set_flags(dpp::m_ephemeral));
+  replied("alerts", start, r);
+}
+
+void gecko::remove_alert(const dpp::slashcommand_t& event) {
+  auto start = steady_clock::now();
+  int64_t id = std::get<int64_t>(event.get_parameter("id"));
+  reply r = unalert_reply(event.command.usr.id, static_cast<uint64_t>(std::max<int64_t>(id, 0)));
+  respond(event, "unalert", to_message(r).set_flags(dpp::m_ephemeral));
+  replied("unalert", start, r);
+}
+
+gecko::reply gecko::tickers_reply(uint64_t channel_id) {
+  auto tickers = ticker_board::instance().list(channel_id);
+  if (tickers.empty()) return text_reply(":information_source: No live tickers in this channel. Start one with /ticker.");
+
+  std::string content = ":chart_with_upwards_trend: Live tickers in this channel:";
+  for (const auto& ticker : tickers) {
+    content += "\n- #" + std::to_string(ticker.id) + " " + ticker.coingecko_id + ", every " +
+               std::to_string(ticker.interval.count()) + "s";
+  }
+  return text_reply(content);
+}
+
+gecko::reply gecko::untick_reply(uint64_t channel_id, uint64_t ticker_id) {
+  if (!ticker_board::instance().remove(channel_id, ticker_id)) {
+    return error_reply(":exclamation: There is no ticker #" + std::to_string(ticker_id) + " in this channel");
+  }
+  return text_reply(":white_check_mark: Ticker #" + std::to_string(ticker_id) + " stopped");
+}
+
+void gecko::create_ticker(dpp::cluster& bot, const dpp::slashcommand_t& event) {
+  std::string coin = std::get<std::string>(event.get_parameter("coin"));
+  auto interval_param = event.get_parameter("interval");
+  const int64_t* interval = std::get_if<int64_t>(&interval_param);
+
+  auto start = steady_clock::now();
+  defer(event, "ticker", true);
+
+  price_ticker ticker;
+  ticker.channel_id = event.command.channel_id;
+  ticker.user_id = event.command.usr.id;
+  ticker.coingecko_id = coin;
+  ticker.interval = std::chrono::seconds(interval ? std::max<int64_t>(*interval, 30) : 60);
+  ticker.created_at = std::chrono::system_clock::now();
+
+  // Validate the id and get the first price before posting anything
+  price_cache::instance().fetch(coin, [&bot, event, start, ticker, slot = commands::hold()](const price_result& result) mutable {
+    if (!result.ok) {
+      edit_reply(event, "ticker", start, error_reply(result.error));
+      return;
+    }
+    if (!ticker_board::instance().add(ticker)) {
+      edit_reply(event, "ticker", start,
+                 error_reply(":exclamation: This channel has too many tickers. Stop one with /untick first."));
+      return;
+    }
+
+    dpp::message msg(ticker.channel_id, ticker_message(ticker, result.quote));
+    bot.message_create(msg, [&bot, event, start, ticker, slot](const dpp::confirmation_callback_t& posted) {
+      if (posted.is_error()) {
+        ticker_board::instance().remove(ticker.id);
+        edit_reply(event, "ticker", start,
+                   error_reply(":exclamation: Couldn't post the ticker here: " + posted.get_error().message));
+        return;
+      }
+      auto message = posted.get<dpp::message>();
+      ticker_board::instance().set_message(ticker.id, message.id);
+      // Pinning needs Manage Messages; the ticker works without it
+      bot.message_pin(ticker.channel_id, message.id, [id = ticker.id](const dpp::confirmation_callback_t& pinned) {
+        if (pinned.is_error()) {
+          LOG_DEBUG("could not pin ticker", logging::kv("ticker", id), logging::kv("error", pinned.get_error().message));
+        }
+      });
+      edit_reply(event, "ticker", start,
+                 text_reply(":white_check_mark: Ticker #" + std::to_string(ticker.id) + " started. Stop it with /untick id:" +
+                            std::to_string(ticker.id) + "."));
+    });
+  });
+}
+
+void gecko::list_tickers(const dpp::slashcommand_t& event) {
+  auto start = steady_clock::now();
+  reply r = tickers_reply(event.command.channel_id);
+  respond(event, "tickers", to_message(r).set_flags(dpp::m_ephemeral));
+  replied("tickers", start, r);
+}
+
+void gecko::remove_ticker(const dpp::slashcommand_t& event) {
+  auto start = steady_clock::now();
+  int64_t id = std::get<int64_t>(event.get_parameter("id"));
+  reply r = untick_reply(event.command.channel_id, static_cast<uint64_t>(std::max<int64_t>(id, 0)));
+  respond(event, "untick", to_message(r).set_flags(dpp::m_ephemeral));
+  replied("untick", start, r);
+}
+
+void gecko::autocomplete(dpp::cluster& bot, const dpp::autocomplete_t& event) {
+  auto start = steady_clock::now();
+  for (const auto& option : event.options) {
+    if (!option.focused) continue;
+
+    const std::string* typed = std::get_if<std::string>(&option.value);
+    std::vector<completion> choices;
+    if (option.name == "currency") {
+      std::string prefix = typed != nullptr ? *typed : "";
+      std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::tolower);
+      for (auto& code : fx_rates::instance().codes(prefix, 25)) {
+        currency_rate rate;
+        if (fx_rates::instance().find(code, rate)) choices.push_back({code + " - " + rate.name, code});
+      }
+    } else if (auto search = coin_index::instance().search(); typed != nullptr && search) {
+      // Answered from memory only; Discord gives us 3 seconds but users type fast
+      choices = option.name == "ticker" ? search->tickers(*typed) : search->coins(*typed);
+    }
+
+    dpp::interaction_response response(dpp::ir_autocomplete_reply);
+    for (const auto& choice : choices) {
+      response.add_autocomplete_choice(dpp::command_option_choice(choice.name, choice.value));
+    }
+    autocomplete_times.get(option.name).observe_since(start);
+    bot.interaction_response_create(event.command.id, event.command.token, response);
+    return;
+  }
 }
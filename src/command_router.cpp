@@ -0,0 +1,279 @@
+#include <command_router.h>
+#include <logging.h>
+#include <metrics.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+using steady_clock = std::chrono::steady_clock;
+using system_clock = std::chrono::system_clock;
+
+// Discord drops interactions that aren't acknowledged within this long of being created
+constexpr std::chrono::seconds kAckDeadline{3};
+
+struct route_state;
+
+struct job {
+    dpp::slashcommand_t event;
+    route_state* route = nullptr;
+    steady_clock::time_point queued_at;
+    // Defer once this passes without the job having started
+    system_clock::time_point ack_by;
+    bool deferred = false;
+};
+
+struct route_state {
+    commands::route route;
+    size_t running = 0;
+    std::deque<job> queue;
+    // Moving average of how long a command holds its slot, for admission
+    double hold_seconds = 0;
+
+    // This command's metrics, looked up once in start()
+    metrics::counter* deferred_total = nullptr;
+    metrics::counter* expired_total = nullptr;
+    metrics::counter* shed_total = nullptr;
+    metrics::histogram* queue_seconds = nullptr;
+};
+
+// The routed command running on this thread
+struct running_job {
+    route_state* route = nullptr;
+    steady_clock::time_point started;
+    bool deferred = false;
+    bool held = false;
+};
+
+thread_local running_job* current = nullptr;
+
+std::mutex mutex;
+std::condition_variable cv;
+std::unordered_map<std::string, std::unique_ptr<route_state>> routes;
+std::vector<std::thread> workers;
+size_t busy_workers = 0;
+bool stopping = false;
+std::chrono::milliseconds ack_budget{1500};
+commands::stats totals;
+
+// record_ack() also sees interactions that aren't routed (buttons, select menus)
+metrics::labeled<metrics::histogram> ack_times("bot_interaction_ack_seconds",
+                                               "Time from interaction creation to our first response", {"command"});
+metrics::labeled<metrics::counter> late_acks("bot_interaction_ack_late_total",
+                                             "Interactions acknowledged after Discord's deadline", {"command"});
+
+system_clock::time_point created_at(const dpp::interaction_create_t& event) {
+    auto created = std::chrono::duration<double>(event.command.id.get_creation_time());
+    return system_clock::time_point(std::chrono::duration_cast<system_clock::duration>(created));
+}
+
+// Callers hold `mutex`
+void defer(job& j) {
+    j.deferred = true;
+    j.event.thinking(j.route->route.ephemeral);
+    commands::record_ack(j.event, j.route->route.name);
+    totals.deferred++;
+    j.route->deferred_total->inc();
+}
+
+// Defer every waiting job whose acknowledgement budget ran out, and drop the
+// ones that can no longer be acknowledged at all. Returns when the next
+// budget runs out. Callers hold `mutex`.
+system_clock::time_point sweep(system_clock::time_point now) {
+    auto next = system_clock::time_point::max();
+    for (auto& [name, state] : routes) {
+        auto& queue = state->queue;
+        for (auto it = queue.begin(); it != queue.end();) {
+            if (!it->deferred && it->ack_by <= now) {
+                if (now - created_at(it->event) >= kAckDeadline) {
+                    totals.expired++;
+                    state->expired_total->inc();
+                    LOG_WARN("dropping command past its deadline", logging::kv("command", name));
+                    it = queue.erase(it);
+                    continue;
+                }
+                defer(*it);
+            }
+            if (!it->deferred) next = std::min(next, it->ack_by);
+            ++it;
+        }
+    }
+    return next;
+}
+
+// Rough time until `state` has a slot for one more job
+double expected_wait(const route_state& state) {
+    const auto& route = state.route;
+    if (state.queue.empty() && state.running < route.max_running && busy_workers < workers.size()) return 0;
+    return static_cast<double>(state.queue.size() / route.max_running + 1) * state.hold_seconds;
+}
+
+void release(route_state* state, steady_clock::time_point started) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        state->running--;
+        double held = std::chrono::duration<double>(steady_clock::now() - started).count();
+        state->hold_seconds = state->hold_seconds == 0 ? held : state->hold_seconds * 0.9 + held * 0.1;
+    }
+    cv.notify_all();
+}
+
+// The route with room to run whose oldest job has waited longest. Callers hold `mutex`.
+route_state* next_runnable() {
+    route_state* best = nullptr;
+    for (auto& [name, state] : routes) {
+        if (state->queue.empty() || state->running >= state->route.max_running) continue;
+        if (best == nullptr || state->queue.front().queued_at < best->queue.front().queued_at) best = state.get();
+    }
+    return best;
+}
+
+void work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        auto next_ack = sweep(system_clock::now());
+        route_state* state = next_runnable();
+        if (state == nullptr) {
+            if (next_ack == system_clock::time_point::max()) {
+                cv.wait(lock);
+            } else {
+                cv.wait_until(lock, next_ack);
+            }
+            continue;
+        }
+
+        job j = std::move(state->queue.front());
+        state->queue.pop_front();
+        state->running++;
+        busy_workers++;
+        lock.unlock();
+
+        state->queue_seconds->observe_since(j.queued_at);
+
+        running_job running;
+        running.route = state;
+        running.started = steady_clock::now();
+        running.deferred = j.deferred;
+        current = &running;
+        try {
+            state->route.run(j.event);
+        } catch (const std::exception& e) {
+            LOG_ERROR("command handler failed", logging::kv("command", state->route.name),
+                      logging::kv("error", e.what()));
+        }
+        current = nullptr;
+        if (!running.held) release(state, running.started);
+
+        lock.lock();
+        busy_workers--;
+    }
+}
+
+}  // namespace
+
+void commands::start(std::vector<route> table, size_t worker_count, std::chrono::milliseconds budget) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ack_budget = std::max(budget, std::chrono::milliseconds(1));
+    stopping = false;
+    for (auto& r : table) {
+        auto state = std::make_unique<route_state>();
+        r.max_running = std::max<size_t>(r.max_running, 1);
+        state->route = std::move(r);
+        metrics::labels labels = {{"command", state->route.name}};
+        state->deferred_total = &metrics::get_counter(
+            "bot_commands_deferred_total", "Commands deferred by the router while they waited", labels);
+        state->expired_total =
+            &metrics::get_counter("bot_commands_expired_total", "Commands dropped past Discord's deadline", labels);
+        state->shed_total = &metrics::get_counter("bot_commands_shed_total",
+                                                  "Commands turned away because their queue was full", labels);
+        state->queue_seconds =
+            &metrics::get_histogram("bot_command_queue_seconds", "Time commands waited for a worker", labels);
+        routes[state->route.name] = std::move(state);
+    }
+    for (size_t i = 0; i < std::max<size_t>(worker_count, 1); i++) workers.emplace_back(work);
+}
+
+void commands::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+}
+
+void commands::dispatch(const dpp::slashcommand_t& event) {
+    std::string name = event.command.get_command_name();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = routes.find(name);
+        if (it == routes.end()) {
+            LOG_WARN("unknown command", logging::kv("command", name));
+            return;
+        }
+        route_state& state = *it->second;
+        totals.dispatched++;
+
+        if (state.queue.size() < state.route.max_queued) {
+            auto now = system_clock::now();
+            job j;
+            j.event = event;
+            j.route = &state;
+            j.queued_at = steady_clock::now();
+            j.ack_by = created_at(event) + ack_budget;
+            // No point waiting for the budget to run out when the queue says it will
+            bool late = now + std::chrono::duration_cast<system_clock::duration>(
+                                  std::chrono::duration<double>(expected_wait(state))) >= j.ack_by;
+            if (late || j.ack_by <= now) defer(j);
+            state.queue.push_back(std::move(j));
+            sweep(now);
+        } else {
+            totals.shed++;
+            state.shed_total->inc();
+            event.reply(dpp::message(":hourglass: The bot is busy right now, please try again in a moment.")
+                            .set_flags(dpp::m_ephemeral));
+            record_ack(event, name);
+            LOG_WARN("command queue full", logging::kv("command", name), logging::kv("queued", state.queue.size()));
+            return;
+        }
+    }
+    cv.notify_one();
+}
+
+bool commands::deferred() {
+    return current != nullptr && current->deferred;
+}
+
+std::shared_ptr<void> commands::hold() {
+    if (current == nullptr) return nullptr;
+    current->held = true;
+    route_state* state = current->route;
+    auto started = current->started;
+    // Released when the last copy of the token goes away
+    return std::shared_ptr<void>(state, [started](void* held) { release(static_cast<route_state*>(held), started); });
+}
+
+void commands::record_ack(const dpp::interaction_create_t& event, const std::string& command) {
+    double now = std::chrono::duration<double>(system_clock::now().time_since_epoch()).count();
+    double age = std::max(0.0, now - event.command.id.get_creation_time());
+    ack_times.get(command).observe(age);
+    if (age > std::chrono::duration<double>(kAckDeadline).count()) late_acks.get(command).inc();
+}
+
+commands::stats commands::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats out = totals;
+    out.queued = 0;
+    out.running = 0;
+    for (const auto& [name, state] : routes) {
+        out.queued += state->queue.size();
+        out.running += state->running;
+    }
+    return out;
+}
@@ -0,0 +1,34 @@
+#include <config.h>
+#include <logging.h>
+
+#include <cstdlib>
+
+std::string config::get_string(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') return fallback;
+    return value;
+}
+
+long config::get_long(const char* name, long fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || *value == '\0') return fallback;
+
+    char* end = nullptr;
+    long parsed = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0') {
+        LOG_WARN("config value is not a number", logging::kv("name", name), logging::kv("value", value),
+                 logging::kv("fallback", fallback));
+        return fallback;
+    }
+    return parsed;
+}
+
+size_t config::get_size(const char* name, size_t fallback) {
+    long parsed = get_long(name, static_cast<long>(fallback));
+    if (parsed < 0) {
+        LOG_WARN("config value is negative", logging::kv("name", name), logging::kv("value", parsed),
+                 logging::kv("fallback", fallback));
+        return fallback;
+    }
+    return static_cast<size_t>(parsed);
+}
@@ -0,0 +1,64 @@
+#include <downsample.h>
+
+#include <algorithm>
+#include <cmath>
+
+void downsample::lttb(std::vector<long>& timestamps, std::vector<double>& values, size_t target) {
+    const size_t n = std::min(timestamps.size(), values.size());
+    if (target < 3 || n <= target) return;
+
+    // Work on contiguous doubles so the per-bucket area pass vectorizes
+    std::vector<double> xs(n);
+    for (size_t i = 0; i < n; i++) xs[i] = static_cast<double>(timestamps[i]);
+    const double* x = xs.data();
+    const double* y = values.data();
+
+    std::vector<size_t> keep;
+    keep.reserve(target);
+    keep.push_back(0);
+
+    std::vector<double> areas;
+    const double every = static_cast<double>(n - 2) / static_cast<double>(target - 2);
+    size_t a = 0;
+
+    for (size_t bucket = 0; bucket < target - 2; bucket++) {
+        // Average of the next bucket is the third corner of the triangle
+        size_t next_begin = static_cast<size_t>(std::floor((bucket + 1) * every)) + 1;
+        size_t next_end = std::min(static_cast<size_t>(std::floor((bucket + 2) * every)) + 1, n);
+        double avg_x = 0, avg_y = 0;
+        for (size_t i = next_begin; i < next_end; i++) {
+            avg_x += x[i];
+            avg_y += y[i];
+        }
+        size_t next_count = next_end - next_begin;
+        if (next_count == 0) {
+            avg_x = x[n - 1];
+            avg_y = y[n - 1];
+        } else {
+            avg_x /= next_count;
+            avg_y /= next_count;
+        }
+
+        size_t begin = static_cast<size_t>(std::floor(bucket * every)) + 1;
+        size_t end = std::min(static_cast<size_t>(std::floor((bucket + 1) * every)) + 1, n - 1);
+
+        // Doubled triangle area for every candidate, then pick the largest
+        const double ax = x[a], ay = y[a];
+        const double dx = avg_x - ax, dy = avg_y - ay;
+        areas.resize(end - begin);
+        for (size_t i = begin; i < end; i++) {
+            areas[i - begin] = std::abs((x[i] - ax) * dy - (y[i] - ay) * dx);
+        }
+        a = begin + static_cast<size_t>(std::max_element(areas.begin(), areas.end()) - areas.begin());
+        keep.push_back(a);
+    }
+
+    keep.push_back(n - 1);
+
+    for (size_t i = 0; i < keep.size(); i++) {
+        timestamps[i] = timestamps[keep[i]];
+        values[i] = values[keep[i]];
+    }
+    timestamps.resize(keep.size());
+    values.resize(keep.size());
+}
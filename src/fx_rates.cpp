@@ -0,0 +1,215 @@
+#include <fx_rates.h>
+#include <http_client.h>
+#include <logging.h>
+#include <metrics.h>
+
+#include <algorithm>
+#include <cctype>
+
+// Retry a failed refresh sooner than the regular interval
+static constexpr std::chrono::seconds kRetryInterval{60};
+
+gecko::exchange_rates_handler::exchange_rates_handler(fx_rates::rate_map& rates) : rates_(rates) {}
+
+bool gecko::exchange_rates_handler::start_object(std::size_t) {
+    if (++depth_ == 3 && in_rates_) rate_ = currency_rate();
+    return true;
+}
+
+bool gecko::exchange_rates_handler::end_object() {
+    if (depth_-- == 3 && in_rates_ && !code_.empty() && rate_.per_btc > 0) {
+        std::transform(code_.begin(), code_.end(), code_.begin(), ::tolower);
+        rates_[std::move(code_)] = std::move(rate_);
+    }
+    if (depth_ == 1) in_rates_ = false;
+    return true;
+}
+
+bool gecko::exchange_rates_handler::start_array(std::size_t) {
+    ++depth_;
+    return true;
+}
+
+bool gecko::exchange_rates_handler::end_array() {
+    depth_--;
+    return true;
+}
+
+bool gecko::exchange_rates_handler::key(string_t& key) {
+    field_ = nullptr;
+    value_field_ = false;
+    if (depth_ == 1) {
+        in_rates_ = key == "rates";
+    } else if (depth_ == 2 && in_rates_) {
+        code_ = std::move(key);
+    } else if (depth_ == 3 && in_rates_) {
+        if (key == "name") {
+            field_ = &rate_.name;
+        } else if (key == "unit") {
+            field_ = &rate_.unit;
+        } else if (key == "type") {
+            field_ = &rate_.type;
+        } else if (key == "value") {
+            value_field_ = true;
+        }
+    }
+    return true;
+}
+
+bool gecko::exchange_rates_handler::string(string_t& value) {
+    if (depth_ == 3 && field_ != nullptr) *field_ = std::move(value);
+    field_ = nullptr;
+    return true;
+}
+
+void gecko::exchange_rates_handler::number(double value) {
+    if (depth_ == 3 && value_field_) rate_.per_btc = value;
+    value_field_ = false;
+}
+
+bool gecko::exchange_rates_handler::number_integer(number_integer_t value) {
+    number(static_cast<double>(value));
+    return true;
+}
+
+bool gecko::exchange_rates_handler::number_unsigned(number_unsigned_t value) {
+    number(static_cast<double>(value));
+    return true;
+}
+
+bool gecko::exchange_rates_handler::number_float(number_float_t value, const string_t&) {
+    number(value);
+    return true;
+}
+
+gecko::fx_rates& gecko::fx_rates::instance() {
+    static fx_rates rates;
+    return rates;
+}
+
+gecko::fx_rates::~fx_rates() {
+    stop();
+}
+
+void gecko::fx_rates::start(std::chrono::seconds refresh_interval, http::rate_limiter* limiter,
+                            const std::string& url) {
+    limiter_ = limiter;
+    if (!url.empty()) url_ = url;
+    if (!ready()) refresh();
+    worker_ = std::thread(&fx_rates::run, this, std::max(refresh_interval, std::chrono::seconds(1)));
+}
+
+void gecko::fx_rates::stop() {
+    {
+        std::lock_guard<std::mutex> lock(worker_mutex_);
+        stopping_ = true;
+    }
+    worker_cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void gecko::fx_rates::run(std::chrono::seconds refresh_interval) {
+    bool failed = false;
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    while (!stopping_) {
+        std::chrono::system_clock::duration wait = refresh_interval;
+        if (!ready() || failed) {
+            wait = std::min(refresh_interval, kRetryInterval);
+        } else {
+            // A restored table may already be due
+            wait = std::max(std::chrono::system_clock::duration::zero(),
+                            built_at() + refresh_interval - std::chrono::system_clock::now());
+        }
+        if (worker_cv_.wait_for(lock, wait, [this] { return stopping_; })) break;
+
+        lock.unlock();
+        failed = !refresh();
+        lock.lock();
+    }
+}
+
+bool gecko::fx_rates::ready() const {
+    return std::atomic_load(&rates_) != nullptr;
+}
+
+bool gecko::fx_rates::from_usd(double usd, const std::string& currency, double& out) const {
+    auto rates = std::atomic_load(&rates_);
+    if (!rates) return false;
+    auto to = rates->find(currency);
+    auto from = rates->find("usd");
+    if (to == rates->end() || from == rates->end()) return false;
+    out = usd * to->second.per_btc / from->second.per_btc;
+    return true;
+}
+
+bool gecko::fx_rates::find(const std::string& currency, currency_rate& out) const {
+    auto rates = std::atomic_load(&rates_);
+    if (!rates) return false;
+    auto it = rates->find(currency);
+    if (it == rates->end()) return false;
+    out = it->second;
+    return true;
+}
+
+std::vector<std::string> gecko::fx_rates::codes(const std::string& prefix, size_t limit) const {
+    std::vector<std::string> out;
+    auto rates = std::atomic_load(&rates_);
+    if (!rates) return out;
+
+    std::vector<std::pair<bool, std::string>> matches;
+    for (const auto& [code, rate] : *rates) {
+        if (code.compare(0, prefix.size(), prefix) == 0) matches.emplace_back(rate.type != "fiat", code);
+    }
+    std::sort(matches.begin(), matches.end());
+    for (size_t i = 0; i < matches.size() && i < limit; i++) out.push_back(std::move(matches[i].second));
+    return out;
+}
+
+std::shared_ptr<const gecko::fx_rates::rate_map> gecko::fx_rates::snapshot() const {
+    return std::atomic_load(&rates_);
+}
+
+std::chrono::system_clock::time_point gecko::fx_rates::built_at() const {
+    return std::chrono::system_clock::time_point(std::chrono::milliseconds(built_at_ms_.load()));
+}
+
+void gecko::fx_rates::restore(std::shared_ptr<const rate_map> rates, std::chrono::system_clock::time_point built_at) {
+    built_at_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(built_at.time_since_epoch()).count();
+    std::atomic_store(&rates_, std::move(rates));
+}
+
+bool gecko::fx_rates::refresh() {
+    auto rates = std::make_shared<rate_map>();
+    exchange_rates_handler handler(*rates);
+    jsonstream::parser parser(handler);
+
+    http::request req;
+    req.url = url_;
+    req.prio = http::priority::background;
+    req.limiter = limiter_;
+    req.max_wait = std::chrono::minutes(5);
+    std::chrono::steady_clock::duration parse_time{0};
+    req.on_data = [&parser, &parse_time](const char* data, size_t size) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = parser.feed(data, size);
+        parse_time += std::chrono::steady_clock::now() - start;
+        return ok;
+    };
+
+    http::response res = http::perform(req);
+    if (!res.ok() || res.status != 200 || !parser.finish()) {
+        LOG_ERROR("exchange rate refresh failed", logging::kv("status", res.status),
+                  logging::kv("error", res.ok() ? parser.error() : res.error()));
+        return false;
+    }
+    if (rates->count("usd") == 0) {
+        LOG_ERROR("exchange rate refresh failed", logging::kv("error", "no usd rate"));
+        return false;
+    }
+
+    metrics::get_histogram("bot_json_parse_seconds", "Time spent parsing upstream JSON", {{"document", "exchange_rates"}})
+        .observe(parse_time);
+    LOG_INFO("exchange rates refreshed", logging::kv("currencies", rates->size()));
+    restore(std::move(rates), std::chrono::system_clock::now());
+    return true;
+}
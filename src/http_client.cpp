@@ -0,0 +1,568 @@
+#include <http_client.h>
+#include <logging.h>
+#include <metrics.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+const char* const http::user_agent = "crypto-prices-slash-bot-cpp/1.0 (+https://github.com/asiantbd/crypto-prices-slash-bot-cpp)";
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+CURLSH* share = nullptr;
+std::mutex share_locks[CURL_LOCK_DATA_LAST];
+
+std::atomic<uint64_t> requests{0};
+std::atomic<uint64_t> failures{0};
+std::atomic<uint64_t> new_connections{0};
+std::atomic<uint64_t> reused_connections{0};
+std::atomic<uint64_t> shed{0};
+std::atomic<uint64_t> throttled{0};
+std::atomic<uint64_t> retried{0};
+std::atomic<uint64_t> received_bytes{0};
+std::atomic<uint64_t> decoded_bytes{0};
+
+void share_lock(CURL*, curl_lock_data data, curl_lock_access, void*) {
+    share_locks[data].lock();
+}
+
+void share_unlock(CURL*, curl_lock_data data, void*) {
+    share_locks[data].unlock();
+}
+
+// Where a transfer's response goes
+struct body_sink {
+    CURL* curl;
+    http::response* res;
+    const std::function<bool(const char*, size_t)>* on_data;
+};
+
+size_t write_callback(char* ptr, size_t size, size_t nmemb, body_sink* sink) {
+    size_t bytes = size * nmemb;
+    sink->res->decoded_bytes += bytes;
+    if (*sink->on_data) {
+        long status = 0;
+        curl_easy_getinfo(sink->curl, CURLINFO_RESPONSE_CODE, &status);
+        // Returning anything other than `bytes` makes curl abort the transfer
+        if (status != 429) return (*sink->on_data)(ptr, bytes) ? bytes : 0;
+    }
+    sink->res->body.append(ptr, bytes);
+    return bytes;
+}
+
+size_t header_callback(char* ptr, size_t size, size_t nmemb, body_sink* sink) {
+    size_t bytes = size * nmemb;
+    std::string line(ptr, bytes);
+
+    // A new status line starts a new header block (redirects, 100-continue)
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        sink->res->headers.clear();
+        return bytes;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) return bytes;
+
+    std::string name = line.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    size_t value_begin = line.find_first_not_of(" \t", colon + 1);
+    size_t value_end = line.find_last_not_of(" \t\r\n");
+    sink->res->headers[name] =
+        value_begin == std::string::npos || value_end < value_begin ? "" : line.substr(value_begin, value_end - value_begin + 1);
+    return bytes;
+}
+
+// Reset a handle and apply the options common to every request.
+// curl_easy_reset() keeps the handle's live connections and caches.
+void configure_handle(CURL* curl) {
+    curl_easy_reset(curl);
+    curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, http::user_agent);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 5000L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 20000L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    // Empty means every encoding this libcurl supports
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+}
+
+// Apply the per-request options. Returns the header list, which must stay
+// alive until the transfer is done, as must `sink`.
+curl_slist* prepare_request(CURL* curl, const http::request& req, body_sink* sink) {
+    struct curl_slist* headers = nullptr;
+    for (const auto& header : req.headers) {
+        headers = curl_slist_append(headers, header.c_str());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, req.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, sink);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, sink);
+    if (req.post) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, req.body.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)req.body.size());
+    }
+    return headers;
+}
+
+// Collect status and connection reuse info once a transfer has finished
+void finish_request(CURL* curl, http::response& res) {
+    if (res.code != CURLE_OK) {
+        LOG_ERROR("curl transfer failed", logging::kv("error", res.error()));
+        failures++;
+        return;
+    }
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &res.status);
+
+    // Counted before content decoding
+    curl_off_t downloaded = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    res.received_bytes = static_cast<uint64_t>(downloaded);
+    received_bytes += res.received_bytes;
+    decoded_bytes += res.decoded_bytes;
+
+    long num_connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &num_connects);
+    if (num_connects == 0) {
+        reused_connections++;
+    } else {
+        new_connections += num_connects;
+    }
+}
+
+// Upstream label for metrics: the URL's host
+std::string host_of(const std::string& url) {
+    size_t begin = url.find("://");
+    begin = begin == std::string::npos ? 0 : begin + 3;
+    size_t end = url.find_first_of(":/?", begin);
+    return url.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+// Looked up once per label combination; every transfer records into these
+metrics::labeled<metrics::counter> upstream_errors("bot_upstream_errors_total",
+                                                   "Upstream requests that got no HTTP response", {"upstream", "reason"});
+metrics::labeled<metrics::histogram> request_times("bot_upstream_request_seconds", "Upstream transfer time, per attempt",
+                                                   {"upstream"});
+metrics::labeled<metrics::counter> responses_total("bot_upstream_responses_total", "Upstream responses by HTTP status",
+                                                   {"upstream", "code"});
+metrics::labeled<metrics::counter> received_bytes_total("bot_upstream_received_bytes_total",
+                                                        "Upstream response body bytes as transferred", {"upstream"});
+metrics::labeled<metrics::counter> decoded_bytes_total("bot_upstream_decoded_bytes_total",
+                                                       "Upstream response body bytes after content decoding",
+                                                       {"upstream"});
+metrics::labeled<metrics::histogram> queue_waits("bot_upstream_queue_wait_seconds",
+                                                 "Time upstream requests waited for a free slot or rate limit token",
+                                                 {"upstream"});
+
+// Count a request that never got a response
+void record_failure(const std::string& url, const char* reason) {
+    upstream_errors.get(host_of(url), reason).inc();
+}
+
+// Record one finished transfer attempt
+void record_transfer(const std::string& url, const http::response& res, clock::duration elapsed) {
+    std::string upstream = host_of(url);
+    request_times.get(upstream).observe(elapsed);
+
+    if (res.code != CURLE_OK) {
+        record_failure(url, "transport");
+        return;
+    }
+    responses_total.get(upstream, std::to_string(res.status)).inc();
+    received_bytes_total.get(upstream).inc(res.received_bytes);
+    decoded_bytes_total.get(upstream).inc(res.decoded_bytes);
+}
+
+// Parse Retry-After, which is either delay-seconds or an HTTP date
+std::chrono::milliseconds parse_retry_after(const std::string& value) {
+    if (value.empty()) return std::chrono::milliseconds(0);
+
+    if (std::all_of(value.begin(), value.end(), ::isdigit)) {
+        return std::chrono::seconds(std::strtol(value.c_str(), nullptr, 10));
+    }
+
+    time_t at = curl_getdate(value.c_str(), nullptr);
+    time_t now = time(nullptr);
+    if (at <= now) return std::chrono::milliseconds(0);
+    return std::chrono::seconds(at - now);
+}
+
+// One easy handle per thread for the blocking API
+struct thread_handle {
+    CURL* curl = nullptr;
+
+    thread_handle() : curl(curl_easy_init()) {}
+    ~thread_handle() {
+        if (curl) curl_easy_cleanup(curl);
+    }
+};
+
+// curl multi event loop behind the async API
+class async_engine {
+public:
+    async_engine(size_t max_in_flight, size_t max_queued)
+        : max_in_flight_(max_in_flight), max_queued_(max_queued), multi_(curl_multi_init()) {
+        curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        worker_ = std::thread(&async_engine::run, this);
+    }
+
+    ~async_engine() {
+        stopping_ = true;
+        curl_multi_wakeup(multi_);
+        if (worker_.joinable()) worker_.join();
+
+        for (CURL* curl : idle_handles_) curl_easy_cleanup(curl);
+        curl_multi_cleanup(multi_);
+    }
+
+    void submit(http::request req, http::callback done) {
+        auto now = clock::now();
+        auto deadline = now + req.max_wait;
+        std::string url = req.url;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            if (queued_ < max_queued_) {
+                queues_[index(req.prio)].push_back({std::move(req), std::move(done), deadline, now});
+                queued_++;
+                done = nullptr;
+            }
+        }
+
+        if (done) {
+            shed++;
+            record_failure(url, "shed");
+            http::response res;
+            res.shed = true;
+            done(std::move(res));
+            return;
+        }
+        curl_multi_wakeup(multi_);
+    }
+
+    size_t in_flight() const { return in_flight_; }
+
+    size_t queued() {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        return queued_;
+    }
+
+private:
+    struct pending {
+        http::request req;
+        http::callback done;
+        clock::time_point deadline;
+        clock::time_point enqueued;
+    };
+
+    struct transfer {
+        http::request req;
+        http::callback done;
+        clock::time_point deadline;
+        http::response res;
+        body_sink sink{};
+        curl_slist* headers = nullptr;
+        clock::time_point started;
+    };
+
+    static size_t index(http::priority prio) { return static_cast<size_t>(prio); }
+
+    void run() {
+        while (!stopping_) {
+            auto wake = start_queued();
+
+            int running = 0;
+            curl_multi_perform(multi_, &running);
+
+            int remaining = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi_, &remaining)) {
+                if (msg->msg == CURLMSG_DONE) complete(msg->easy_handle, msg->data.result);
+            }
+
+            auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(wake - clock::now());
+            int timeout_ms = static_cast<int>(std::clamp<long long>(timeout.count(), 0, 1000));
+            curl_multi_poll(multi_, nullptr, 0, timeout_ms, nullptr);
+        }
+    }
+
+    // Start whatever the in-flight cap and rate limiters allow, highest
+    // priority first. Returns when the loop should look at the queue again.
+    clock::time_point start_queued() {
+        auto now = clock::now();
+        auto wake = now + std::chrono::seconds(1);
+        std::vector<pending> expired;
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            for (auto& queue : queues_) {
+                for (auto it = queue.begin(); it != queue.end() && in_flight_ < max_in_flight_;) {
+                    if (now >= it->deadline) {
+                        expired.push_back(std::move(*it));
+                        it = queue.erase(it);
+                        queued_--;
+                        continue;
+                    }
+
+                    http::rate_limiter* limiter = it->req.limiter;
+                    if (limiter != nullptr && !limiter->try_acquire(now)) {
+                        wake = std::min(wake, std::min(limiter->next_available(now), it->deadline));
+                        ++it;
+                        continue;
+                    }
+
+                    if (!start(std::move(*it))) break;
+                    it = queue.erase(it);
+                    queued_--;
+                }
+            }
+        }
+
+        for (auto& p : expired) {
+            throttled++;
+            record_failure(p.req.url, "throttled");
+            http::response res;
+            res.throttled = true;
+            p.done(std::move(res));
+        }
+        return wake;
+    }
+
+    bool start(pending&& p) {
+        CURL* curl = acquire();
+        if (!curl) {
+            LOG_ERROR("could not initialize libcurl");
+            return false;
+        }
+
+        auto now = clock::now();
+        queue_waits.get(host_of(p.req.url)).observe(now - p.enqueued);
+
+        auto* t = new transfer{std::move(p.req), std::move(p.done), p.deadline, {}, {}, nullptr, now};
+        t->sink = {curl, &t->res, &t->req.on_data};
+        t->headers = prepare_request(curl, t->req, &t->sink);
+        curl_easy_setopt(curl, CURLOPT_PRIVATE, t);
+        curl_multi_add_handle(multi_, curl);
+        in_flight_++;
+        return true;
+    }
+
+    void complete(CURL* curl, CURLcode result) {
+        transfer* raw = nullptr;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, &raw);
+        std::unique_ptr<transfer> t(raw);
+
+        t->res.code = result;
+        finish_request(curl, t->res);
+        record_transfer(t->req.url, t->res, clock::now() - t->started);
+
+        curl_multi_remove_handle(multi_, curl);
+        curl_slist_free_all(t->headers);
+        idle_handles_.push_back(curl);
+        in_flight_--;
+
+        if (t->req.limiter != nullptr && t->res.ok()) {
+            if (t->res.status == 429) {
+                auto now = clock::now();
+                auto paused_until = t->req.limiter->on_throttled(now, parse_retry_after(t->res.header("retry-after")));
+                LOG_WARN("upstream returned 429", logging::kv("upstream", t->req.limiter->name()),
+                         logging::kv("backoff_ms",
+                                     std::chrono::duration_cast<std::chrono::milliseconds>(paused_until - now).count()));
+
+                // Retry once the pause is over, if the caller can still wait that long
+                if (paused_until < t->deadline) {
+                    retried++;
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    queues_[index(t->req.prio)].push_front(
+                        {std::move(t->req), std::move(t->done), t->deadline, clock::now()});
+                    queued_++;
+                    return;
+                }
+                throttled++;
+                record_failure(t->req.url, "throttled");
+                t->res.throttled = true;
+            } else {
+                t->req.limiter->on_success();
+            }
+        }
+
+        try {
+            t->done(std::move(t->res));
+        } catch (const std::exception& e) {
+            LOG_ERROR("unhandled exception in http callback", logging::kv("error", e.what()));
+        }
+    }
+
+    CURL* acquire() {
+        CURL* curl = nullptr;
+        if (!idle_handles_.empty()) {
+            curl = idle_handles_.back();
+            idle_handles_.pop_back();
+        } else {
+            curl = curl_easy_init();
+            if (!curl) return nullptr;
+        }
+        configure_handle(curl);
+        return curl;
+    }
+
+    const size_t max_in_flight_;
+    const size_t max_queued_;
+    CURLM* multi_;
+
+    std::mutex queue_mutex_;
+    // One queue per priority, most urgent first
+    std::array<std::deque<pending>, 3> queues_;
+    size_t queued_ = 0;
+
+    // Only touched by the worker thread
+    std::vector<CURL*> idle_handles_;
+    std::atomic<size_t> in_flight_{0};
+
+    std::atomic<bool> stopping_{false};
+    std::thread worker_;
+};
+
+std::unique_ptr<async_engine> engine;
+
+// The default transport: a per-thread easy handle for blocking requests and
+// the multi event loop for async ones
+class curl_backend : public http::backend {
+public:
+    http::response perform(const http::request& req) override {
+        // Rate limited requests have to go through the scheduler
+        if (req.limiter != nullptr) {
+            std::promise<http::response> promise;
+            auto result = promise.get_future();
+            perform_async(req, [&promise](http::response res) { promise.set_value(std::move(res)); });
+            return result.get();
+        }
+
+        thread_local thread_handle handle;
+
+        http::response res;
+        if (!handle.curl) {
+            LOG_ERROR("could not initialize libcurl");
+            failures++;
+            res.code = CURLE_FAILED_INIT;
+            return res;
+        }
+
+        configure_handle(handle.curl);
+        body_sink sink{handle.curl, &res, &req.on_data};
+        curl_slist* headers = prepare_request(handle.curl, req, &sink);
+        auto started = clock::now();
+        res.code = curl_easy_perform(handle.curl);
+        curl_slist_free_all(headers);
+
+        finish_request(handle.curl, res);
+        record_transfer(req.url, res, clock::now() - started);
+        return res;
+    }
+
+    void perform_async(http::request req, http::callback done) override {
+        engine->submit(std::move(req), std::move(done));
+    }
+};
+
+std::unique_ptr<http::backend> transport;
+
+}  // namespace
+
+void http::init(size_t max_in_flight, size_t max_queued) {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    share = curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // Not CURL_LOCK_DATA_CONNECT: libcurl doesn't support sharing a connection
+    // cache between handles used on different threads at once. The multi
+    // loop pools its own connections and every thread's handle keeps its own.
+
+    // With no transfer slot nothing queued would ever start
+    engine = std::make_unique<async_engine>(std::max<size_t>(max_in_flight, 1), max_queued);
+    transport = std::make_unique<curl_backend>();
+
+    metrics::register_gauge("bot_upstream_in_flight", "Async upstream transfers in progress", {},
+                            [] { return static_cast<double>(engine->in_flight()); });
+    metrics::register_gauge("bot_upstream_queued", "Async upstream requests waiting to start", {},
+                            [] { return static_cast<double>(engine->queued()); });
+}
+
+void http::set_backend(std::unique_ptr<backend> replacement) {
+    transport = std::move(replacement);
+}
+
+http::response http::perform(const request& req) {
+    requests++;
+    return transport->perform(req);
+}
+
+http::response http::get(const std::string& url) {
+    request req;
+    req.url = url;
+    return perform(req);
+}
+
+http::response http::post_json(const std::string& url, const std::string& body) {
+    request req;
+    req.url = url;
+    req.post = true;
+    req.body = body;
+    req.headers = {"Content-Type: application/json", "Accept: application/json", "charset: utf-8"};
+    return perform(req);
+}
+
+void http::perform_async(request req, callback done) {
+    requests++;
+    transport->perform_async(std::move(req), std::move(done));
+}
+
+void http::get_async(const std::string& url, callback done) {
+    request req;
+    req.url = url;
+    perform_async(std::move(req), std::move(done));
+}
+
+void http::post_json_async(const std::string& url, const std::string& body, callback done) {
+    request req;
+    req.url = url;
+    req.post = true;
+    req.body = body;
+    req.headers = {"Content-Type: application/json", "Accept: application/json", "charset: utf-8"};
+    perform_async(std::move(req), std::move(done));
+}
+
+http::stats http::get_stats() {
+    stats s;
+    s.requests = requests;
+    s.failures = failures;
+    s.new_connections = new_connections;
+    s.reused_connections = reused_connections;
+    s.shed = shed;
+    s.throttled = throttled;
+    s.retried = retried;
+    s.received_bytes = received_bytes;
+    s.decoded_bytes = decoded_bytes;
+    if (engine) {
+        s.in_flight = engine->in_flight();
+        s.queued = engine->queued();
+    }
+    return s;
+}
@@ -0,0 +1,375 @@
+#include <json_stream.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool is_number_char(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Validate against the JSON number grammar: -?(0|[1-9]\d*)(\.\d+)?([eE][+-]?\d+)?
+bool is_valid_number(const std::string& s, bool& is_float) {
+    size_t i = 0, n = s.size();
+    is_float = false;
+
+    if (i < n && s[i] == '-') i++;
+    if (i >= n) return false;
+    if (s[i] == '0') {
+        i++;
+    } else if (is_digit(s[i])) {
+        while (i < n && is_digit(s[i])) i++;
+    } else {
+        return false;
+    }
+
+    if (i < n && s[i] == '.') {
+        is_float = true;
+        i++;
+        if (i >= n || !is_digit(s[i])) return false;
+        while (i < n && is_digit(s[i])) i++;
+    }
+
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        is_float = true;
+        i++;
+        if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+        if (i >= n || !is_digit(s[i])) return false;
+        while (i < n && is_digit(s[i])) i++;
+    }
+    return i == n;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+}  // namespace
+
+jsonstream::parser::parser(nlohmann::json_sax<json>& handler) : handler_(handler) {}
+
+bool jsonstream::parser::feed(const char* data, size_t size) {
+    if (failed_) return false;
+
+    size_t i = 0;
+    while (i < size) {
+        position_ = offset_ + i;
+        switch (lex_) {
+            case lex::string: {
+                if (high_surrogate_ != 0 && data[i] != '\\') {
+                    return fail("unpaired UTF-16 surrogate");
+                }
+
+                // Copy plain runs in one go; stop at a quote, escape or the end of the chunk
+                size_t start = i;
+                while (i < size && data[i] != '"' && data[i] != '\\') {
+                    if (static_cast<unsigned char>(data[i]) < 0x20) {
+                        return fail("control character in string");
+                    }
+                    i++;
+                }
+                token_.append(data + start, i - start);
+                if (i == size) break;
+
+                if (data[i++] == '"') {
+                    lex_ = lex::none;
+                    if (!complete_string()) {
+                        return false;
+                    }
+                } else {
+                    lex_ = lex::string_escape;
+                }
+                break;
+            }
+
+            case lex::string_escape: {
+                char c = data[i++];
+                if (high_surrogate_ != 0 && c != 'u') {
+                    return fail("unpaired UTF-16 surrogate");
+                }
+
+                lex_ = lex::string;
+                switch (c) {
+                    case '"': token_ += '"'; break;
+                    case '\\': token_ += '\\'; break;
+                    case '/': token_ += '/'; break;
+                    case 'b': token_ += '\b'; break;
+                    case 'f': token_ += '\f'; break;
+                    case 'n': token_ += '\n'; break;
+                    case 'r': token_ += '\r'; break;
+                    case 't': token_ += '\t'; break;
+                    case 'u':
+                        lex_ = lex::string_unicode;
+                        unicode_ = 0;
+                        unicode_digits_ = 0;
+                        break;
+                    default:
+                        return fail("invalid escape sequence");
+                }
+                break;
+            }
+
+            case lex::string_unicode: {
+                int digit = hex_value(data[i++]);
+                if (digit < 0) {
+                    return fail("invalid \\u escape");
+                }
+                unicode_ = (unicode_ << 4) | static_cast<uint32_t>(digit);
+                if (++unicode_digits_ < 4) break;
+
+                lex_ = lex::string;
+                if (unicode_ >= 0xD800 && unicode_ <= 0xDBFF) {
+                    if (high_surrogate_ != 0) {
+                        return fail("unpaired UTF-16 surrogate");
+                    }
+                    high_surrogate_ = unicode_;
+                } else if (unicode_ >= 0xDC00 && unicode_ <= 0xDFFF) {
+                    if (high_surrogate_ == 0) {
+                        return fail("unpaired UTF-16 surrogate");
+                    }
+                    append_utf8(0x10000 + ((high_surrogate_ - 0xD800) << 10) + (unicode_ - 0xDC00));
+                    high_surrogate_ = 0;
+                } else {
+                    if (high_surrogate_ != 0) {
+                        return fail("unpaired UTF-16 surrogate");
+                    }
+                    append_utf8(unicode_);
+                }
+                break;
+            }
+
+            case lex::number: {
+                while (i < size && is_number_char(data[i])) token_ += data[i++];
+                if (i == size) break;
+
+                lex_ = lex::none;
+                if (!complete_number()) {
+                    return false;
+                }
+                break;
+            }
+
+            case lex::literal: {
+                while (i < size && data[i] >= 'a' && data[i] <= 'z') token_ += data[i++];
+                if (i == size) break;
+
+                lex_ = lex::none;
+                if (!complete_literal()) {
+                    return false;
+                }
+                break;
+            }
+
+            case lex::none: {
+                char c = data[i++];
+                if (is_whitespace(c)) break;
+                if (!dispatch(c)) {
+                    return false;
+                }
+                break;
+            }
+        }
+    }
+
+    offset_ += size;
+    return true;
+}
+
+bool jsonstream::parser::finish() {
+    if (failed_) return false;
+    position_ = offset_;
+
+    switch (lex_) {
+        case lex::none:
+            break;
+        case lex::number:
+            lex_ = lex::none;
+            if (!complete_number()) return false;
+            break;
+        case lex::literal:
+            lex_ = lex::none;
+            if (!complete_literal()) return false;
+            break;
+        default:
+            return fail("unexpected end of input inside a string");
+    }
+
+    if (expect_ != expect::done) return fail("unexpected end of input");
+    return true;
+}
+
+bool jsonstream::parser::dispatch(char c) {
+    switch (expect_) {
+        case expect::done:
+            return fail("unexpected content after the end of the document");
+
+        case expect::colon:
+            if (c != ':') return fail("expected ':'");
+            expect_ = expect::value;
+            return true;
+
+        case expect::comma_or_end:
+            if (c == ',') {
+                expect_ = stack_.back() ? expect::key : expect::value;
+                return true;
+            }
+            if (c == ']' || c == '}') return end_container(c);
+            return fail("expected ',' or end of container");
+
+        case expect::key_or_end:
+            if (c == '}') return end_container(c);
+            // fall through
+        case expect::key:
+            if (c != '"') return fail("expected object key");
+            token_.clear();
+            lex_ = lex::string;
+            return true;
+
+        case expect::value_or_end:
+            if (c == ']') return end_container(c);
+            return begin_value(c);
+
+        case expect::value:
+            return begin_value(c);
+    }
+    return fail("invalid parser state");
+}
+
+bool jsonstream::parser::begin_value(char c) {
+    switch (c) {
+        case '{':
+            if (!handler_.start_object(static_cast<std::size_t>(-1))) return fail("parsing stopped by handler");
+            stack_.push_back(true);
+            expect_ = expect::key_or_end;
+            return true;
+        case '[':
+            if (!handler_.start_array(static_cast<std::size_t>(-1))) return fail("parsing stopped by handler");
+            stack_.push_back(false);
+            expect_ = expect::value_or_end;
+            return true;
+        case '"':
+            token_.clear();
+            lex_ = lex::string;
+            return true;
+        case 't':
+        case 'f':
+        case 'n':
+            token_.assign(1, c);
+            lex_ = lex::literal;
+            return true;
+        default:
+            if (c == '-' || is_digit(c)) {
+                token_.assign(1, c);
+                lex_ = lex::number;
+                return true;
+            }
+            return fail(std::string("unexpected character '") + c + "'");
+    }
+}
+
+bool jsonstream::parser::end_container(char c) {
+    bool is_object = c == '}';
+    if (stack_.empty() || stack_.back() != is_object) return fail("mismatched closing bracket");
+
+    stack_.pop_back();
+    bool ok = is_object ? handler_.end_object() : handler_.end_array();
+    if (!ok) return fail("parsing stopped by handler");
+    return after_value();
+}
+
+bool jsonstream::parser::complete_string() {
+    if (expect_ == expect::key || expect_ == expect::key_or_end) {
+        if (!handler_.key(token_)) return fail("parsing stopped by handler");
+        expect_ = expect::colon;
+        return true;
+    }
+
+    if (!handler_.string(token_)) return fail("parsing stopped by handler");
+    return after_value();
+}
+
+bool jsonstream::parser::complete_number() {
+    bool is_float = false;
+    if (!is_valid_number(token_, is_float)) return fail("invalid number '" + token_ + "'");
+
+    bool ok = true;
+    if (!is_float) {
+        errno = 0;
+        if (token_[0] == '-') {
+            long long value = std::strtoll(token_.c_str(), nullptr, 10);
+            if (errno != ERANGE) {
+                ok = handler_.number_integer(value);
+                return ok ? after_value() : fail("parsing stopped by handler");
+            }
+        } else {
+            unsigned long long value = std::strtoull(token_.c_str(), nullptr, 10);
+            if (errno != ERANGE) {
+                ok = handler_.number_unsigned(value);
+                return ok ? after_value() : fail("parsing stopped by handler");
+            }
+        }
+    }
+
+    // Floats, and integers too large for 64 bits. Like nlohmann::json, reject
+    // ones too large for a double rather than pass on infinity.
+    double value = std::strtod(token_.c_str(), nullptr);
+    if (!std::isfinite(value)) return fail("number out of range '" + token_ + "'");
+    ok = handler_.number_float(value, token_);
+    return ok ? after_value() : fail("parsing stopped by handler");
+}
+
+bool jsonstream::parser::complete_literal() {
+    bool ok;
+    if (token_ == "true") {
+        ok = handler_.boolean(true);
+    } else if (token_ == "false") {
+        ok = handler_.boolean(false);
+    } else if (token_ == "null") {
+        ok = handler_.null();
+    } else {
+        return fail("invalid literal '" + token_ + "'");
+    }
+    return ok ? after_value() : fail("parsing stopped by handler");
+}
+
+bool jsonstream::parser::after_value() {
+    expect_ = stack_.empty() ? expect::done : expect::comma_or_end;
+    return true;
+}
+
+bool jsonstream::parser::fail(const std::string& message) {
+    failed_ = true;
+    error_ = message + " (near byte " + std::to_string(position_) + ")";
+    return false;
+}
+
+void jsonstream::parser::append_utf8(uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        token_ += static_cast<char>(codepoint);
+    } else if (codepoint < 0x800) {
+        token_ += static_cast<char>(0xC0 | (codepoint >> 6));
+        token_ += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint < 0x10000) {
+        token_ += static_cast<char>(0xE0 | (codepoint >> 12));
+        token_ += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        token_ += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else {
+        token_ += static_cast<char>(0xF0 | (codepoint >> 18));
+        token_ += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        token_ += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        token_ += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
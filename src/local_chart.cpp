@@ -0,0 +1,267 @@
+#include <local_chart.h>
+#include <png_encoder.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <unordered_map>
+
+namespace {
+
+constexpr int kWidth = 500;
+constexpr int kHeight = 500;
+
+// Plot area margins
+constexpr int kLeft = 72;
+constexpr int kRight = 16;
+constexpr int kTop = 36;
+constexpr int kBottom = 36;
+
+constexpr int kGridRows = 6;
+constexpr int kGridColumns = 6;
+
+struct color {
+    uint8_t r, g, b;
+};
+
+// Same palette as QuickChart's default line chart
+constexpr color kBackground{255, 255, 255};
+constexpr color kGrid{230, 230, 230};
+constexpr color kAxis{120, 120, 120};
+constexpr color kText{80, 80, 80};
+constexpr color kLine{54, 162, 235};
+
+// 5x7 bitmap font. Each glyph is 7 rows, '#' marks a set pixel.
+// Uppercase letters are drawn with the lowercase glyphs.
+using glyph = std::array<const char*, 7>;
+
+const std::unordered_map<char, glyph>& glyphs() {
+    static const std::unordered_map<char, glyph> font = {
+        {'0', {".###.", "#...#", "#..##", "#.#.#", "##..#", "#...#", ".###."}},
+        {'1', {"..#..", ".##..", "..#..", "..#..", "..#..", "..#..", ".###."}},
+        {'2', {".###.", "#...#", "....#", "...#.", "..#..", ".#...", "#####"}},
+        {'3', {".###.", "#...#", "....#", "..##.", "....#", "#...#", ".###."}},
+        {'4', {"...#.", "..##.", ".#.#.", "#..#.", "#####", "...#.", "...#."}},
+        {'5', {"#####", "#....", "####.", "....#", "....#", "#...#", ".###."}},
+        {'6', {"..##.", ".#...", "#....", "####.", "#...#", "#...#", ".###."}},
+        {'7', {"#####", "....#", "...#.", "..#..", ".#...", ".#...", ".#..."}},
+        {'8', {".###.", "#...#", "#...#", ".###.", "#...#", "#...#", ".###."}},
+        {'9', {".###.", "#...#", "#...#", ".####", "....#", "...#.", ".##.."}},
+        {'.', {".....", ".....", ".....", ".....", ".....", ".##..", ".##.."}},
+        {',', {".....", ".....", ".....", ".....", ".##..", "..#..", ".#..."}},
+        {':', {".....", ".##..", ".##..", ".....", ".##..", ".##..", "....."}},
+        {'-', {".....", ".....", ".....", "#####", ".....", ".....", "....."}},
+        {'_', {".....", ".....", ".....", ".....", ".....", ".....", "#####"}},
+        {'/', {"....#", "...#.", "...#.", "..#..", ".#...", ".#...", "#...."}},
+        {'$', {"..#..", ".####", "#.#..", ".###.", "..#.#", "####.", "..#.."}},
+        {'(', {"...#.", "..#..", ".#...", ".#...", ".#...", "..#..", "...#."}},
+        {')', {".#...", "..#..", "...#.", "...#.", "...#.", "..#..", ".#..."}},
+        {' ', {".....", ".....", ".....", ".....", ".....", ".....", "....."}},
+        {'a', {".....", ".....", ".###.", "....#", ".####", "#...#", ".####"}},
+        {'b', {"#....", "#....", "####.", "#...#", "#...#", "#...#", "####."}},
+        {'c', {".....", ".....", ".###.", "#....", "#....", "#...#", ".###."}},
+        {'d', {"....#", "....#", ".####", "#...#", "#...#", "#...#", ".####"}},
+        {'e', {".....", ".....", ".###.", "#...#", "#####", "#....", ".###."}},
+        {'f', {"..##.", ".#..#", ".#...", "###..", ".#...", ".#...", ".#..."}},
+        {'g', {".....", ".####", "#...#", "#...#", ".####", "....#", ".###."}},
+        {'h', {"#....", "#....", "#.##.", "##..#", "#...#", "#...#", "#...#"}},
+        {'i', {"..#..", ".....", ".##..", "..#..", "..#..", "..#..", ".###."}},
+        {'j', {"...#.", ".....", "..##.", "...#.", "...#.", "#..#.", ".##.."}},
+        {'k', {"#....", "#....", "#..#.", "#.#..", "##...", "#.#..", "#..#."}},
+        {'l', {".##..", "..#..", "..#..", "..#..", "..#..", "..#..", ".###."}},
+        {'m', {".....", ".....", "##.#.", "#.#.#", "#.#.#", "#...#", "#...#"}},
+        {'n', {".....", ".....", "#.##.", "##..#", "#...#", "#...#", "#...#"}},
+        {'o', {".....", ".....", ".###.", "#...#", "#...#", "#...#", ".###."}},
+        {'p', {".....", ".....", "####.", "#...#", "####.", "#....", "#...."}},
+        {'q', {".....", ".....", ".####", "#...#", ".####", "....#", "....#"}},
+        {'r', {".....", ".....", "#.##.", "##..#", "#....", "#....", "#...."}},
+        {'s', {".....", ".....", ".####", "#....", ".###.", "....#", "####."}},
+        {'t', {".#...", ".#...", "###..", ".#...", ".#...", ".#..#", "..##."}},
+        {'u', {".....", ".....", "#...#", "#...#", "#...#", "#..##", ".##.#"}},
+        {'v', {".....", ".....", "#...#", "#...#", "#...#", ".#.#.", "..#.."}},
+        {'w', {".....", ".....", "#...#", "#...#", "#.#.#", "#.#.#", ".#.#."}},
+        {'x', {".....", ".....", "#...#", ".#.#.", "..#..", ".#.#.", "#...#"}},
+        {'y', {".....", ".....", "#...#", "#...#", ".####", "....#", ".###."}},
+        {'z', {".....", ".....", "#####", "...#.", "..#..", ".#...", "#####"}},
+    };
+    return font;
+}
+
+class canvas {
+public:
+    canvas() : pixels_(static_cast<size_t>(kWidth) * kHeight * 3) {
+        for (size_t i = 0; i < pixels_.size(); i += 3) {
+            pixels_[i] = kBackground.r;
+            pixels_[i + 1] = kBackground.g;
+            pixels_[i + 2] = kBackground.b;
+        }
+    }
+
+    void set(int x, int y, color c) {
+        if (x < 0 || y < 0 || x >= kWidth || y >= kHeight) return;
+        uint8_t* p = &pixels_[(static_cast<size_t>(y) * kWidth + x) * 3];
+        p[0] = c.r;
+        p[1] = c.g;
+        p[2] = c.b;
+    }
+
+    void hline(int x0, int x1, int y, color c) {
+        for (int x = x0; x <= x1; x++) set(x, y, c);
+    }
+
+    void vline(int x, int y0, int y1, color c) {
+        for (int y = y0; y <= y1; y++) set(x, y, c);
+    }
+
+    void fill_rect(int x0, int y0, int x1, int y1, color c) {
+        for (int y = y0; y <= y1; y++) hline(x0, x1, y, c);
+    }
+
+    // Bresenham line, two pixels thick
+    void line(int x0, int y0, int x1, int y1, color c) {
+        int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+        int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+        int err = dx + dy;
+        while (true) {
+            set(x0, y0, c);
+            set(x0 + 1, y0, c);
+            set(x0, y0 + 1, c);
+            if (x0 == x1 && y0 == y1) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) {
+                err += dy;
+                x0 += sx;
+            }
+            if (e2 <= dx) {
+                err += dx;
+                y0 += sy;
+            }
+        }
+    }
+
+    static int text_width(const std::string& text) {
+        return text.empty() ? 0 : static_cast<int>(text.size()) * 6 - 1;
+    }
+
+    void text(int x, int y, const std::string& text, color c) {
+        const auto& font = glyphs();
+        for (char ch : text) {
+            auto it = font.find(static_cast<char>(std::tolower(static_cast<unsigned char>(ch))));
+            if (it != font.end()) {
+                for (int row = 0; row < 7; row++) {
+                    for (int col = 0; col < 5; col++) {
+                        if (it->second[row][col] == '#') set(x + col, y + row, c);
+                    }
+                }
+            }
+            x += 6;
+        }
+    }
+
+    std::string encode() const { return png::encode_rgb(kWidth, kHeight, pixels_); }
+
+private:
+    std::vector<uint8_t> pixels_;
+};
+
+// Pick a "nice" grid step (1, 2 or 5 times a power of ten) covering `range` in about `ticks` steps
+double nice_step(double range, int ticks) {
+    double raw = range / ticks;
+    double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+    double normalized = raw / magnitude;
+    double nice = normalized <= 1 ? 1 : normalized <= 2 ? 2 : normalized <= 5 ? 5 : 10;
+    return nice * magnitude;
+}
+
+std::string format_price_label(double value, double step) {
+    // Enough decimals to tell neighbouring grid lines apart
+    int decimals = step >= 1 ? 0 : std::min(10, static_cast<int>(std::ceil(-std::log10(step))));
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    return buffer;
+}
+
+// Time of day for charts up to two days long, the date beyond that
+std::string format_time_label(long timestamp_ms, long span_ms) {
+    std::time_t seconds = static_cast<std::time_t>(timestamp_ms / 1000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char buffer[16];
+    std::strftime(buffer, sizeof(buffer), span_ms > 2L * 24 * 3600 * 1000 ? "%b %d" : "%H:%M", &utc);
+    return buffer;
+}
+
+}  // namespace
+
+std::string localchart::render_line_chart(const std::vector<long>& timestamps, const std::string& label,
+                                          const std::vector<double>& prices) {
+    size_t count = std::min(timestamps.size(), prices.size());
+    if (count == 0) return "";
+
+    auto [min_it, max_it] = std::minmax_element(prices.begin(), prices.begin() + count);
+    double min_price = *min_it, max_price = *max_it;
+    if (max_price == min_price) {
+        double pad = min_price == 0 ? 1 : std::abs(min_price) * 0.01;
+        min_price -= pad;
+        max_price += pad;
+    }
+
+    double step = nice_step(max_price - min_price, kGridRows);
+    double axis_min = std::floor(min_price / step) * step;
+    double axis_max = std::ceil(max_price / step) * step;
+
+    const int plot_w = kWidth - kLeft - kRight;
+    const int plot_h = kHeight - kTop - kBottom;
+    long t_first = timestamps.front();
+    long t_span = std::max(1L, timestamps[count - 1] - t_first);
+
+    auto to_x = [&](long t) { return kLeft + static_cast<int>(std::lround(double(t - t_first) / t_span * plot_w)); };
+    auto to_y = [&](double p) {
+        return kTop + plot_h - static_cast<int>(std::lround((p - axis_min) / (axis_max - axis_min) * plot_h));
+    };
+
+    canvas img;
+
+    // Horizontal grid and price labels
+    for (double value = axis_min; value <= axis_max + step / 2; value += step) {
+        int y = to_y(value);
+        img.hline(kLeft, kLeft + plot_w, y, kGrid);
+        std::string text = format_price_label(value, step);
+        img.text(kLeft - 6 - canvas::text_width(text), y - 3, text, kText);
+    }
+
+    // Vertical grid and time labels
+    for (int i = 0; i <= kGridColumns; i++) {
+        long t = t_first + t_span * i / kGridColumns;
+        int x = to_x(t);
+        img.vline(x, kTop, kTop + plot_h, kGrid);
+        std::string text = format_time_label(t, t_span);
+        int text_x = std::clamp(x - canvas::text_width(text) / 2, 0, kWidth - 1 - canvas::text_width(text));
+        img.text(text_x, kTop + plot_h + 8, text, kText);
+    }
+
+    // Axes
+    img.vline(kLeft, kTop, kTop + plot_h, kAxis);
+    img.hline(kLeft, kLeft + plot_w, kTop + plot_h, kAxis);
+
+    // Legend
+    int legend_w = 30 + canvas::text_width(label);
+    int legend_x = (kWidth - legend_w) / 2;
+    img.fill_rect(legend_x, 12, legend_x + 23, 20, kLine);
+    img.text(legend_x + 30, 13, label, kText);
+
+    // Price series
+    int prev_x = to_x(timestamps[0]), prev_y = to_y(prices[0]);
+    for (size_t i = 1; i < count; i++) {
+        int x = to_x(timestamps[i]), y = to_y(prices[i]);
+        img.line(prev_x, prev_y, x, y, kLine);
+        prev_x = x;
+        prev_y = y;
+    }
+
+    return img.encode();
+}
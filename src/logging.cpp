@@ -0,0 +1,274 @@
+#include <logging.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<int> logging::min_level{static_cast<int>(level::info)};
+
+namespace {
+
+using system_clock = std::chrono::system_clock;
+
+// Records per thread ring; a full ring drops new records
+constexpr size_t kRingSize = 256;
+
+// How often the writer wakes up when nobody pokes it
+constexpr std::chrono::milliseconds kFlushInterval{20};
+
+struct slot {
+    logging::level lvl;
+    system_clock::time_point time;
+    size_t size = 0;
+    char text[logging::record::kInline];
+    // Records that didn't fit inline; ownership moves to the writer with the slot
+    std::string overflow;
+};
+
+// Single-producer (the owning thread), single-consumer (the writer) ring
+struct ring {
+    explicit ring(unsigned id) : id(id) {}
+
+    const unsigned id;
+    std::array<slot, kRingSize> slots;
+    std::atomic<size_t> head{0};  // next slot to write, owned by the producer
+    std::atomic<size_t> tail{0};  // next slot to read, owned by the writer
+    std::atomic<uint64_t> dropped{0};
+    // Set once the owning thread has exited; the writer forgets the ring when it's empty
+    std::atomic<bool> orphaned{false};
+};
+
+std::mutex rings_mutex;
+std::vector<std::shared_ptr<ring>> rings;
+unsigned next_ring_id = 0;
+
+std::atomic<bool> running{false};
+std::mutex writer_mutex;
+std::condition_variable writer_cv;
+bool stopping = false;
+std::thread writer;
+
+// Registers the calling thread's ring on first use and orphans it at thread exit
+struct ring_owner {
+    std::shared_ptr<ring> r;
+
+    ring_owner() {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        r = std::make_shared<ring>(next_ring_id++);
+        rings.push_back(r);
+    }
+
+    ~ring_owner() { r->orphaned.store(true, std::memory_order_release); }
+};
+
+ring& thread_ring() {
+    thread_local ring_owner owner;
+    return *owner.r;
+}
+
+const char* level_name(logging::level lvl) {
+    switch (lvl) {
+        case logging::level::debug: return "DEBUG";
+        case logging::level::info: return "INFO ";
+        case logging::level::warn: return "WARN ";
+        case logging::level::error: return "ERROR";
+    }
+    return "?    ";
+}
+
+// Append "2026-01-01T12:00:00.123Z LEVEL [tN] " to `out`
+void append_prefix(std::string& out, system_clock::time_point time, logging::level lvl, unsigned thread) {
+    auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch());
+    time_t seconds = static_cast<time_t>(since_epoch.count() / 1000);
+    tm utc{};
+    gmtime_r(&seconds, &utc);
+
+    char buffer[64];
+    int n = std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ %s [t%u] ",
+                          utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+                          static_cast<int>(since_epoch.count() % 1000), level_name(lvl), thread);
+    out.append(buffer, n > 0 ? static_cast<size_t>(n) : 0);
+}
+
+// Move everything queued in `r` into `out`. Returns the number of records.
+size_t drain(ring& r, std::string& out) {
+    size_t tail = r.tail.load(std::memory_order_relaxed);
+    size_t head = r.head.load(std::memory_order_acquire);
+    size_t count = head - tail;
+
+    for (; tail != head; tail++) {
+        slot& s = r.slots[tail % kRingSize];
+        append_prefix(out, s.time, s.lvl, r.id);
+        if (s.overflow.empty()) {
+            out.append(s.text, s.size);
+        } else {
+            out.append(s.overflow);
+            std::string().swap(s.overflow);
+        }
+        out.push_back('\n');
+    }
+    r.tail.store(tail, std::memory_order_release);
+
+    uint64_t dropped = r.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        append_prefix(out, system_clock::now(), logging::level::warn, r.id);
+        out.append("log records dropped, ring full count=");
+        out.append(std::to_string(dropped));
+        out.push_back('\n');
+    }
+    return count;
+}
+
+// Drain every ring once and write the batch out
+void drain_all(std::string& batch) {
+    std::vector<std::shared_ptr<ring>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        snapshot = rings;
+    }
+
+    batch.clear();
+    for (const auto& r : snapshot) {
+        // Check before draining so a record pushed right before thread exit isn't lost
+        bool orphaned = r->orphaned.load(std::memory_order_acquire);
+        drain(*r, batch);
+        if (orphaned) {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            rings.erase(std::remove(rings.begin(), rings.end(), r), rings.end());
+        }
+    }
+
+    if (!batch.empty()) {
+        std::fwrite(batch.data(), 1, batch.size(), stdout);
+        std::fflush(stdout);
+    }
+}
+
+void run() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (!stopping) {
+        writer_cv.wait_for(lock, kFlushInterval);
+        lock.unlock();
+        drain_all(batch);
+        lock.lock();
+    }
+    lock.unlock();
+    drain_all(batch);
+}
+
+// Used before init() and after shutdown()
+void write_sync(logging::level lvl, std::string_view text) {
+    std::string line;
+    line.reserve(text.size() + 48);
+    append_prefix(line, system_clock::now(), lvl, thread_ring().id);
+    line.append(text);
+    line.push_back('\n');
+    std::fwrite(line.data(), 1, line.size(), stderr);
+}
+
+}  // namespace
+
+void logging::init(level lvl) {
+    min_level.store(static_cast<int>(lvl), std::memory_order_relaxed);
+    if (running.exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopping = false;
+    }
+    writer = std::thread(run);
+}
+
+void logging::shutdown() {
+    if (!running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        stopping = true;
+    }
+    writer_cv.notify_one();
+    writer.join();
+}
+
+logging::level logging::parse_level(const std::string& name, level fallback) {
+    if (name == "debug") return level::debug;
+    if (name == "info") return level::info;
+    if (name == "warn") return level::warn;
+    if (name == "error") return level::error;
+    return fallback;
+}
+
+void logging::record::append(std::string_view text) {
+    if (!spilled_ && size_ + text.size() <= kInline) {
+        std::memcpy(inline_ + size_, text.data(), text.size());
+        size_ += text.size();
+        return;
+    }
+    if (!spilled_) {
+        overflow_.reserve(size_ + text.size() + kInline);
+        overflow_.assign(inline_, size_);
+        spilled_ = true;
+    }
+    overflow_.append(text);
+}
+
+void logging::record::value(std::string_view text) {
+    bool quote = text.empty() || text.find_first_of(" \"=\n\t\\") != std::string_view::npos;
+    if (!quote) {
+        append(text);
+        return;
+    }
+
+    append('"');
+    size_t run_start = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c != '"' && c != '\\' && c != '\n' && c != '\t') continue;
+        append(text.substr(run_start, i - run_start));
+        append(c == '\n' ? "\\n" : c == '\t' ? "\\t" : c == '"' ? "\\\"" : "\\\\");
+        run_start = i + 1;
+    }
+    append(text.substr(run_start));
+    append('"');
+}
+
+std::string_view logging::record::text() const {
+    if (spilled_) return overflow_;
+    return std::string_view(inline_, size_);
+}
+
+void logging::submit(level lvl, record& rec) {
+    if (!running.load(std::memory_order_acquire)) {
+        write_sync(lvl, rec.text());
+        return;
+    }
+
+    ring& r = thread_ring();
+    size_t head = r.head.load(std::memory_order_relaxed);
+    if (head - r.tail.load(std::memory_order_acquire) >= kRingSize) {
+        r.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    slot& s = r.slots[head % kRingSize];
+    s.lvl = lvl;
+    s.time = system_clock::now();
+    if (rec.spilled_) {
+        s.overflow = std::move(rec.overflow_);
+        s.size = s.overflow.size();
+    } else {
+        std::memcpy(s.text, rec.inline_, rec.size_);
+        s.size = rec.size_;
+    }
+    r.head.store(head + 1, std::memory_order_release);
+
+    // Errors shouldn't sit in the ring until the next tick
+    if (lvl >= level::warn) writer_cv.notify_one();
+}
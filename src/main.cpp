@@ -1,56 +1,90 @@
+#include <chart_cache.h>
+#include <coin_index.h>
 #include <coingecko.h>
+#include <command_router.h>
+#include <config.h>
+#include <fx_rates.h>
+#include <http_client.h>
+#include <logging.h>
+#include <metrics.h>
+#include <price_alerts.h>
+#include <price_batcher.h>
+#include <price_cache.h>
+#include <quickchart.h>
+#include <series_store.h>
+#include <snapshot.h>
+#include <ticker_board.h>
+#include <watchlists.h>
 #include <dpp/dpp.h>
 
+static metrics::labeled<metrics::counter> commands_received("bot_commands_total", "Slash commands received",
+                                                            {"command"});
+static metrics::labeled<metrics::histogram> dispatch_times(
+    "bot_command_dispatch_seconds", "Time spent in the slash command handler itself", {"command"});
+
 int main() {
+    logging::init(logging::parse_level(config::get_string("LOG_LEVEL", "info"), logging::level::info));
+    http::init(config::get_size("HTTP_MAX_IN_FLIGHT", 16), config::get_size("HTTP_MAX_QUEUED", 256));
+
     // For slash commands and components, we only need default intents
     dpp::cluster bot(std::getenv("DISCORD_TOKEN"), dpp::i_default_intents);
 
     bot.on_slashcommand([](const dpp::slashcommand_t& event) {
-        std::cout << "Received slash command: " << event.command.get_command_name() << std::endl;
-
+        auto dispatch_start = std::chrono::steady_clock::now();
         auto input = event.command.get_command_name();
-        if (input == "ping") {
-            event.reply("Pong!");
-        }
-        if (input == "price") {
-            gecko::fetch_price(event);
-        }
-        if (input == "coins") {
-            gecko::fetch_tokens(event);
-        }
-        if (input == "market") {
-            gecko::fetch_market_chart(event);
-        }
+        LOG_INFO("slash command", logging::kv("command", input));
+        commands_received.get(input).inc();
+
+        commands::dispatch(event);
+
+        // Commands are only queued here, so this should stay well under a millisecond
+        dispatch_times.get(input).observe_since(dispatch_start);
     });
 
+    bot.on_autocomplete([&bot](const dpp::autocomplete_t& event) { gecko::autocomplete(bot, event); });
+
     // Add select menu handler
     bot.on_select_click([](const dpp::select_click_t& event) {
-        std::cout << "Received select menu interaction with custom_id: " << event.custom_id << std::endl;
+        LOG_INFO("select menu", logging::kv("custom_id", event.custom_id));
 
         if (event.custom_id.find("coin_select_") == 0) {
-            std::cout << "Processing coin selection..." << std::endl;
             std::string selected_id = event.values[0];
-            std::cout << "Selected coin ID: " << selected_id << std::endl;
+            LOG_DEBUG("coin selected", logging::kv("coin", selected_id));
+
+            // "coin_select_<ticker>:[<currency>]"; tickers may contain ':' but currency codes don't
+            size_t colon = event.custom_id.rfind(':');
+            std::string currency = colon == std::string::npos ? "" : event.custom_id.substr(colon + 1);
 
             // Then fetch and send the price
             try {
-                gecko::fetch_single_price(selected_id, event);
+                gecko::fetch_single_price(selected_id, currency, event);
             } catch (const std::exception& e) {
-                std::cerr << "Error in select menu handler: " << e.what() << std::endl;
+                LOG_ERROR("select menu handler failed", logging::kv("error", e.what()));
                 event.edit_response(":exclamation: Error processing selection");
             }
         }
     });
 
+    // /coins page buttons, answered from the pre-rendered listing
+    bot.on_button_click([](const dpp::button_click_t& event) {
+        if (event.custom_id.find("coins_page:") == 0) gecko::turn_coins_page(event);
+    });
+
     bot.on_ready([&bot](const dpp::ready_t& event) {
-        std::cout << "Bot is ready!" << std::endl;
+        LOG_INFO("bot ready");
         if (dpp::run_once<struct register_bot_commands>()) {
-            std::cout << "Registering commands..." << std::endl;
+            LOG_INFO("registering commands");
 
             dpp::slashcommand command_coins;
             command_coins.set_name("coins")
                 .set_description("List of available tokens from Coingecko.")
-                .set_application_id(bot.me.id);
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "sort", "Order of the list (default market cap)", false)
+                        .add_choice(dpp::command_option_choice("Market cap", std::string("market_cap")))
+                        .add_choice(dpp::command_option_choice("Name", std::string("name"))))
+                .add_option(
+                    dpp::command_option(dpp::co_integer, "page", "Page to start on", false).set_min_value(1));
             bot.global_command_create(command_coins);
 
             dpp::slashcommand command_price;
@@ -60,31 +94,351 @@ int main() {
                 .set_application_id(bot.me.id)
                 .add_option(
                     dpp::command_option(dpp::co_string, "ticker",
-                                      "Ticker ($) symbol of the token", false))
+                                      "Ticker ($) symbol of the token", false)
+                        .set_auto_complete(true))
                 .add_option(
                     dpp::command_option(dpp::co_string, "coingecko_id",
-                                      "Coingecko ID of the token", false));
+                                      "Coingecko ID of the token", false)
+                        .set_auto_complete(true))
+                .add_option(
+                    dpp::command_option(dpp::co_string, "currency",
+                                      "Currency to show the price in besides USD (default IDR)", false)
+                        .set_auto_complete(true));
 
             bot.global_command_create(command_price);
 
             dpp::slashcommand command_market;
             command_market.set_name("market")
                 .set_description(
-                    "Get market chart of a crypto token (1 day interval).")
+                    "Get market chart of a crypto token.")
                 .set_application_id(bot.me.id)
                 .add_option(
                     dpp::command_option(dpp::co_string, "token_id",
-                                      "(Coingecko) Id of the token: ", true))
+                                      "(Coingecko) Id of the token: ", true)
+                        .set_auto_complete(true))
                 .add_option(
                     dpp::command_option(dpp::co_string, "currency",
-                                      "(Coingecko) Currency for the price: ", true));
+                                      "(Coingecko) Currency for the price: ", true)
+                        .set_auto_complete(true))
+                .add_option(
+                    dpp::command_option(dpp::co_string, "range", "Time span of the chart (default 1 day)", false)
+                        .add_choice(dpp::command_option_choice("1 day", std::string("1d")))
+                        .add_choice(dpp::command_option_choice("7 days", std::string("7d")))
+                        .add_choice(dpp::command_option_choice("30 days", std::string("30d"))));
             bot.global_command_create(command_market);
 
-            std::cout << "Commands registered successfully!" << std::endl;
+            dpp::slashcommand command_prices;
+            command_prices.set_name("prices")
+                .set_description("Get the prices of several tokens in one table.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "coins",
+                                      "Tickers or Coingecko IDs, e.g. btc eth solana (default your watchlist)", false))
+                .add_option(
+                    dpp::command_option(dpp::co_string, "currency",
+                                      "Currency to show the prices in besides USD (default IDR)", false)
+                        .set_auto_complete(true));
+            bot.global_command_create(command_prices);
+
+            dpp::slashcommand command_watch;
+            command_watch.set_name("watch")
+                .set_description("Add tokens to your watchlist for /prices.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "coins", "Tickers or Coingecko IDs, e.g. btc eth solana", true));
+            bot.global_command_create(command_watch);
+
+            dpp::slashcommand command_unwatch;
+            command_unwatch.set_name("unwatch")
+                .set_description("Remove tokens from your watchlist.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "coins", "Tickers or Coingecko IDs, e.g. btc eth", true));
+            bot.global_command_create(command_unwatch);
+
+            dpp::slashcommand command_alert;
+            command_alert.set_name("alert")
+                .set_description("Get pinged here when a token reaches a price.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "coin", "Coingecko ID of the token", true)
+                        .set_auto_complete(true))
+                .add_option(
+                    dpp::command_option(dpp::co_number, "price", "Target price", true)
+                        .set_min_value(0))
+                .add_option(
+                    dpp::command_option(dpp::co_string, "currency", "Currency of the target price (default USD)", false)
+                        .add_choice(dpp::command_option_choice("USD", std::string("usd")))
+                        .add_choice(dpp::command_option_choice("IDR", std::string("idr"))));
+            bot.global_command_create(command_alert);
+
+            dpp::slashcommand command_alerts;
+            command_alerts.set_name("alerts")
+                .set_description("List your price alerts.")
+                .set_application_id(bot.me.id);
+            bot.global_command_create(command_alerts);
+
+            dpp::slashcommand command_unalert;
+            command_unalert.set_name("unalert")
+                .set_description("Remove one of your price alerts.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_integer, "id", "Alert number, as shown by /alerts", true));
+            bot.global_command_create(command_unalert);
+
+            dpp::slashcommand command_ticker;
+            command_ticker.set_name("ticker")
+                .set_description("Post a price message that keeps itself up to date.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "coin", "Coingecko ID of the token", true)
+                        .set_auto_complete(true))
+                .add_option(
+                    dpp::command_option(dpp::co_integer, "interval", "How often to update (default 1 minute)", false)
+                        .add_choice(dpp::command_option_choice("30 seconds", int64_t{30}))
+                        .add_choice(dpp::command_option_choice("1 minute", int64_t{60}))
+                        .add_choice(dpp::command_option_choice("5 minutes", int64_t{300}))
+                        .add_choice(dpp::command_option_choice("15 minutes", int64_t{900}))
+                        .add_choice(dpp::command_option_choice("1 hour", int64_t{3600})));
+            bot.global_command_create(command_ticker);
+
+            dpp::slashcommand command_tickers;
+            command_tickers.set_name("tickers")
+                .set_description("List the live tickers in this channel.")
+                .set_application_id(bot.me.id);
+            bot.global_command_create(command_tickers);
+
+            dpp::slashcommand command_untick;
+            command_untick.set_name("untick")
+                .set_description("Stop a live ticker in this channel.")
+                .set_application_id(bot.me.id)
+                .add_option(
+                    dpp::command_option(dpp::co_integer, "id", "Ticker number, as shown by /tickers", true));
+            bot.global_command_create(command_untick);
+
+            LOG_INFO("commands registered");
+
+            // Periodically report connection reuse, price cache and batching effectiveness
+            bot.start_timer([](dpp::timer) {
+                http::stats stats = http::get_stats();
+                LOG_INFO("http stats", logging::kv("requests", stats.requests),
+                         logging::kv("failures", stats.failures),
+                         logging::kv("new_connections", stats.new_connections),
+                         logging::kv("reused_connections", stats.reused_connections),
+                         logging::kv("throttled", stats.throttled),
+                         logging::kv("retried", stats.retried),
+                         logging::kv("received_bytes", stats.received_bytes),
+                         logging::kv("decoded_bytes", stats.decoded_bytes));
+
+                if (http::rate_limiter* limiter = gecko::rate_limiter()) {
+                    http::rate_limiter::stats limits = limiter->get_stats();
+                    LOG_INFO("coingecko rate limit", logging::kv("granted", limits.granted),
+                             logging::kv("throttled", limits.throttled),
+                             logging::kv("rate_per_minute", limits.rate_per_minute),
+                             logging::kv("paused", limits.paused));
+                }
+
+                gecko::price_cache::stats cache = gecko::price_cache::instance().get_stats();
+                LOG_INFO("price cache stats", logging::kv("hits", cache.hits),
+                         logging::kv("stale_hits", cache.stale_hits),
+                         logging::kv("misses", cache.misses),
+                         logging::kv("coalesced", cache.coalesced),
+                         logging::kv("fallbacks", cache.fallbacks),
+                         logging::kv("entries", cache.entries));
+
+                gecko::series_store::stats series = gecko::series_store::instance().get_stats();
+                LOG_INFO("price history stats", logging::kv("hits", series.hits),
+                         logging::kv("refreshes", series.refreshes),
+                         logging::kv("loads", series.loads),
+                         logging::kv("coalesced", series.coalesced),
+                         logging::kv("series", series.series));
+
+                gecko::chart_cache::stats charts = gecko::chart_cache::instance().get_stats();
+                LOG_INFO("chart cache stats", logging::kv("hits", charts.hits),
+                         logging::kv("misses", charts.misses),
+                         logging::kv("coalesced", charts.coalesced),
+                         logging::kv("evictions", charts.evictions),
+                         logging::kv("entries", charts.entries),
+                         logging::kv("bytes", charts.bytes));
+
+                gecko::price_batcher::stats batcher = gecko::price_batcher::instance().get_stats();
+                LOG_INFO("price batcher stats", logging::kv("lookups", batcher.lookups),
+                         logging::kv("batches", batcher.batches));
+
+                gecko::alert_engine::stats alerts = gecko::alert_engine::instance().get_stats();
+                LOG_INFO("price alert stats", logging::kv("alerts", alerts.alerts),
+                         logging::kv("watched_coins", alerts.watched_coins),
+                         logging::kv("requests", alerts.requests),
+                         logging::kv("triggered", alerts.triggered),
+                         logging::kv("skipped_ticks", alerts.skipped_ticks));
+
+                commands::stats routed = commands::get_stats();
+                LOG_INFO("command router stats", logging::kv("dispatched", routed.dispatched),
+                         logging::kv("deferred", routed.deferred),
+                         logging::kv("shed", routed.shed),
+                         logging::kv("expired", routed.expired),
+                         logging::kv("queued", routed.queued),
+                         logging::kv("running", routed.running));
+
+                gecko::ticker_board::stats tickers = gecko::ticker_board::instance().get_stats();
+                LOG_INFO("ticker stats", logging::kv("tickers", tickers.tickers),
+                         logging::kv("refresh_slots", tickers.refresh_slots),
+                         logging::kv("requests", tickers.requests),
+                         logging::kv("edits", tickers.edits),
+                         logging::kv("coalesced_edits", tickers.coalesced_edits));
+
+                gecko::watchlists::stats watched = gecko::watchlists::instance().get_stats();
+                LOG_INFO("watchlist stats", logging::kv("users", watched.users),
+                         logging::kv("coins", watched.coins));
+            }, 600);
         }
     });
 
-    std::cout << "Starting bot..." << std::endl;
+    // Point these at a local stand-in (bench/mock_upstream) for load testing
+    gecko::configure_base_url(config::get_string("COINGECKO_BASE_URL", "https://api.coingecko.com/api/v3"));
+    qchart::configure_base_url(config::get_string("QUICKCHART_BASE_URL", "https://quickchart.io"));
+
+    gecko::configure_rate_limit(config::get_long("COINGECKO_RATE_PER_MINUTE", 30),
+                                config::get_long("COINGECKO_BURST", 10));
+
+    gecko::price_cache::instance().configure(
+        std::chrono::seconds(config::get_long("PRICE_CACHE_TTL_SECONDS", 30)),
+        std::chrono::seconds(config::get_long("PRICE_CACHE_STALE_SECONDS", 0)),
+        std::chrono::seconds(config::get_long("PRICE_CACHE_FALLBACK_SECONDS", 3600)));
+
+    gecko::price_batcher::instance().start(
+        std::chrono::milliseconds(config::get_long("PRICE_BATCH_WINDOW_MS", 25)),
+        config::get_size("PRICE_BATCH_MAX_IDS", 50));
+
+    gecko::chart_options chart_options;
+    chart_options.backend = config::get_string("CHART_BACKEND", "quickchart") == "local"
+                                ? gecko::chart_backend::local
+                                : gecko::chart_backend::quickchart;
+    chart_options.max_points = config::get_size("MARKET_CHART_POINTS", 250);
+    gecko::configure_charts(chart_options);
+
+    gecko::series_store::instance().configure(
+        std::chrono::seconds(config::get_long("MARKET_REFRESH_SECONDS", 60)),
+        config::get_size("MARKET_HISTORY_COINS", 256));
+    gecko::chart_cache::instance().configure(std::chrono::seconds(config::get_long("CHART_CACHE_SECONDS", 60)),
+                                             config::get_size("CHART_CACHE_BYTES", 32 << 20));
+    gecko::watchlists::instance().configure(config::get_size("WATCHLIST_MAX_COINS", 25));
+
+    metrics::register_gauge("bot_price_cache_entries", "Quotes held by the price cache", {}, [] {
+        return static_cast<double>(gecko::price_cache::instance().get_stats().entries);
+    });
+    metrics::register_gauge("bot_price_history_coins", "Coins with price history held for /market", {}, [] {
+        return static_cast<double>(gecko::series_store::instance().get_stats().series);
+    });
+    metrics::register_gauge("bot_chart_cache_bytes", "Size of the rendered /market charts held", {}, [] {
+        return static_cast<double>(gecko::chart_cache::instance().get_stats().bytes);
+    });
+    metrics::register_gauge("bot_price_alerts", "Price alerts waiting to trigger", {}, [] {
+        return static_cast<double>(gecko::alert_engine::instance().get_stats().alerts);
+    });
+    metrics::register_gauge("bot_price_alert_coins", "Distinct coins with price alerts", {}, [] {
+        return static_cast<double>(gecko::alert_engine::instance().get_stats().watched_coins);
+    });
+    metrics::register_gauge("bot_price_tickers", "Live ticker messages", {}, [] {
+        return static_cast<double>(gecko::ticker_board::instance().get_stats().tickers);
+    });
+    metrics::register_gauge("bot_watchlist_users", "Users with a /prices watchlist", {}, [] {
+        return static_cast<double>(gecko::watchlists::instance().get_stats().users);
+    });
+    if (http::rate_limiter* limiter = gecko::rate_limiter()) {
+        metrics::register_gauge("bot_rate_limit_per_minute", "Current upstream request budget",
+                                {{"upstream", limiter->name()}},
+                                [limiter] { return limiter->get_stats().rate_per_minute; });
+    }
+
+    long metrics_port = config::get_long("METRICS_PORT", 0);
+    if (metrics_port > 0 && metrics_port < 65536) {
+        metrics::serve(config::get_string("METRICS_ADDRESS", "127.0.0.1"), static_cast<uint16_t>(metrics_port));
+    }
+
+    // Warm start from the last snapshot; the coin list download then happens in the background
+    std::string snapshot_path = config::get_string("SNAPSHOT_PATH", "");
+    if (!snapshot_path.empty()) snapshot::load(snapshot_path);
+
+    gecko::coin_index::instance().configure_ranking(gecko::base_url() + "/coins/markets",
+                                                    config::get_size("AUTOCOMPLETE_RANKED_COINS", 1000));
+
+    // Build the ticker index before accepting commands (unless it was
+    // restored above), then keep it fresh in the background
+    LOG_INFO("loading coin list");
+    gecko::coin_index::instance().start(
+        std::chrono::seconds(config::get_long("COIN_LIST_REFRESH_SECONDS", 3600)), gecko::rate_limiter(),
+        gecko::base_url() + "/coins/list");
+
+    // Prices are only fetched in USD; every other currency is converted with these rates
+    gecko::fx_rates::instance().start(std::chrono::seconds(config::get_long("FX_REFRESH_SECONDS", 600)),
+                                      gecko::rate_limiter(), gecko::base_url() + "/exchange_rates");
+
+    // Alerts are checked against batched /simple/price polls of every watched coin
+    gecko::alert_engine::instance().start(
+        std::chrono::seconds(config::get_long("ALERT_POLL_SECONDS", 60)), config::get_size("ALERT_BATCH_MAX_IDS", 250),
+        config::get_size("ALERT_MAX_PER_USER", 25), [&bot](const gecko::price_alert& alert, double price) {
+            metrics::get_counter("bot_price_alerts_triggered_total", "Price alerts triggered").inc();
+            bot.message_create(dpp::message(alert.channel_id, gecko::alert_notification(alert, price)));
+        });
+
+    // Ticker edits are paced per channel to stay inside Discord's rate limits
+    gecko::ticker_board::instance().start(
+        config::get_size("TICKER_BATCH_MAX_IDS", 250), config::get_size("TICKER_MAX_PER_CHANNEL", 5),
+        std::chrono::milliseconds(config::get_long("TICKER_EDIT_SPACING_MS", 1000)),
+        [&bot](const gecko::price_ticker& ticker, const std::string& content) {
+            if (ticker.message_id == 0) return;
+            dpp::message msg(ticker.channel_id, content);
+            msg.id = ticker.message_id;
+            bot.message_edit(msg, [id = ticker.id](const dpp::confirmation_callback_t& edited) {
+                if (!edited.is_error()) return;
+                dpp::error_info error = edited.get_error();
+                // Unknown Channel, Unknown Message, Missing Access: the message is gone for good
+                if (error.code == 10003 || error.code == 10008 || error.code == 50001) {
+                    LOG_INFO("ticker message gone, stopping it", logging::kv("ticker", id),
+                             logging::kv("error", error.message));
+                    gecko::ticker_board::instance().remove(id);
+                } else {
+                    LOG_WARN("ticker edit failed", logging::kv("ticker", id), logging::kv("error", error.message));
+                }
+            });
+        });
+
+    // Every slash command, how many of it may run at once and how many may wait.
+    // Cheap in-memory commands get room; the ones that hit upstream are kept
+    // from crowding out /price.
+    std::vector<commands::route> routes = {
+        {"ping", 4, 64, false, gecko::ping},
+        {"price", 32, 512, false, gecko::fetch_price},
+        {"coins", 8, 128, false, gecko::fetch_tokens},
+        {"market", 4, 32, false, gecko::fetch_market_chart},
+        {"prices", 8, 128, false, gecko::fetch_prices},
+        {"watch", 8, 128, true, gecko::watch_coins},
+        {"unwatch", 8, 128, true, gecko::unwatch_coins},
+        {"alert", 8, 128, false, gecko::create_alert},
+        {"alerts", 8, 128, true, gecko::list_alerts},
+        {"unalert", 8, 128, true, gecko::remove_alert},
+        {"ticker", 4, 32, true, [&bot](const dpp::slashcommand_t& event) { gecko::create_ticker(bot, event); }},
+        {"tickers", 8, 128, true, gecko::list_tickers},
+        {"untick", 8, 128, true, gecko::remove_ticker},
+    };
+    commands::start(std::move(routes), config::get_size("COMMAND_WORKERS", 4),
+                    std::chrono::milliseconds(config::get_long("COMMAND_ACK_BUDGET_MS", 1500)));
+    metrics::register_gauge("bot_command_queue_depth", "Commands waiting for a worker or a slot", {},
+                            [] { return static_cast<double>(commands::get_stats().queued); });
+
+    if (!snapshot_path.empty()) {
+        snapshot::start(snapshot_path, std::chrono::seconds(config::get_long("SNAPSHOT_SAVE_SECONDS", 300)));
+    }
+
+    LOG_INFO("starting bot");
     bot.start(dpp::st_wait);
+    commands::stop();
+    gecko::alert_engine::instance().stop();
+    gecko::ticker_board::instance().stop();
+    gecko::fx_rates::instance().stop();
+    snapshot::stop();
+    metrics::stop();
+    logging::shutdown();
     return 0;
 }
@@ -0,0 +1,304 @@
+#include <logging.h>
+#include <metrics.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <variant>
+
+namespace {
+
+// The registry is keyed by metric name, then by rendered label set
+using metric = std::variant<std::unique_ptr<metrics::counter>, std::unique_ptr<metrics::gauge>,
+                            std::unique_ptr<metrics::histogram>, std::function<double()>>;
+
+struct family {
+    std::string help;
+    const char* type = nullptr;
+    std::map<std::string, metric> series;
+};
+
+std::mutex registry_mutex;
+std::map<std::string, family> registry;
+
+std::thread server;
+std::atomic<bool> stopping{false};
+int listen_fd = -1;
+
+// Scrapes must answer quickly; a client that stalls is dropped
+constexpr int kClientTimeoutMs = 2000;
+
+// Render {key="value",...} with Prometheus label escaping
+std::string label_text(const metrics::labels& labels) {
+    if (labels.empty()) return "";
+    std::string out = "{";
+    for (const auto& [key, value] : labels) {
+        if (out.size() > 1) out += ',';
+        out += key;
+        out += "=\"";
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+    out += '}';
+    return out;
+}
+
+// Insert `extra` (already rendered, without braces) into a rendered label set
+std::string with_label(const std::string& labels, const std::string& extra) {
+    if (labels.empty()) return "{" + extra + "}";
+    return labels.substr(0, labels.size() - 1) + "," + extra + "}";
+}
+
+void append_number(std::string& out, double value) {
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, ec == std::errc() ? end - buffer : 0);
+}
+
+void append_number(std::string& out, uint64_t value) {
+    char buffer[24];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, ec == std::errc() ? end - buffer : 0);
+}
+
+template <typename T>
+T& find_or_create(const std::string& name, const std::string& help, const char* type,
+                  const metrics::labels& labels) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    family& f = registry[name];
+    if (f.type == nullptr) {
+        f.help = help;
+        f.type = type;
+    }
+
+    metric& m = f.series[label_text(labels)];
+    if (auto* existing = std::get_if<std::unique_ptr<T>>(&m)) {
+        if (*existing) return **existing;
+    }
+    m = std::make_unique<T>();
+    return *std::get<std::unique_ptr<T>>(m);
+}
+
+void serve_client(int fd) {
+    timeval timeout{kClientTimeoutMs / 1000, (kClientTimeoutMs % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Only the request line matters
+    char request[1024];
+    ssize_t received = recv(fd, request, sizeof(request) - 1, 0);
+    if (received <= 0) return;
+    request[received] = '\0';
+
+    std::string body;
+    const char* status = "200 OK";
+    const char* content_type = "text/plain; version=0.0.4";
+    if (std::strncmp(request, "GET /metrics ", 13) == 0 || std::strncmp(request, "GET /metrics?", 13) == 0) {
+        body = metrics::render();
+    } else {
+        status = "404 Not Found";
+        content_type = "text/plain";
+        body = "not found\n";
+    }
+
+    std::string response = "HTTP/1.1 ";
+    response += status;
+    response += "\r\nContent-Type: ";
+    response += content_type;
+    response += "\r\nContent-Length: " + std::to_string(body.size());
+    response += "\r\nConnection: close\r\n\r\n";
+    response += body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+    }
+}
+
+void run() {
+    while (!stopping) {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        // Wake up now and then to notice stop()
+        if (poll(&pfd, 1, 500) <= 0) continue;
+
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) continue;
+        serve_client(fd);
+        close(fd);
+    }
+}
+
+}  // namespace
+
+void metrics::histogram::observe(double seconds) {
+    size_t bucket = 0;
+    while (bucket < kBounds.size() && seconds > kBounds[bucket]) bucket++;
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_micros_.fetch_add(static_cast<uint64_t>(std::max(seconds, 0.0) * 1e6), std::memory_order_relaxed);
+}
+
+void metrics::histogram::render(std::string& out, const std::string& name, const std::string& label_text) const {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= kBounds.size(); i++) {
+        cumulative += buckets_[i].load(std::memory_order_relaxed);
+
+        std::string le = "le=\"";
+        if (i < kBounds.size()) {
+            append_number(le, kBounds[i]);
+        } else {
+            le += "+Inf";
+        }
+        le += '"';
+
+        out += name;
+        out += "_bucket";
+        out += with_label(label_text, le);
+        out += ' ';
+        append_number(out, cumulative);
+        out += '\n';
+    }
+
+    out += name + "_sum" + label_text + ' ';
+    append_number(out, sum_micros_.load(std::memory_order_relaxed) / 1e6);
+    out += '\n';
+    out += name + "_count" + label_text + ' ';
+    append_number(out, cumulative);
+    out += '\n';
+}
+
+metrics::counter& metrics::get_counter(const std::string& name, const std::string& help, const labels& labels) {
+    return find_or_create<counter>(name, help, "counter", labels);
+}
+
+metrics::gauge& metrics::get_gauge(const std::string& name, const std::string& help, const labels& labels) {
+    return find_or_create<gauge>(name, help, "gauge", labels);
+}
+
+metrics::histogram& metrics::get_histogram(const std::string& name, const std::string& help, const labels& labels) {
+    return find_or_create<histogram>(name, help, "histogram", labels);
+}
+
+template <typename Metric>
+Metric& metrics::labeled<Metric>::find(const std::string& key, std::initializer_list<const std::string*> values) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) return *it->second;
+    }
+
+    labels by_key;
+    auto value = values.begin();
+    for (size_t i = 0; i < keys_.size() && value != values.end(); i++, ++value) by_key[keys_[i]] = **value;
+    Metric* metric = nullptr;
+    if constexpr (std::is_same_v<Metric, counter>) {
+        metric = &get_counter(name_, help_, by_key);
+    } else {
+        metric = &get_histogram(name_, help_, by_key);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    cache_.emplace(key, metric);
+    return *metric;
+}
+
+template class metrics::labeled<metrics::counter>;
+template class metrics::labeled<metrics::histogram>;
+
+void metrics::register_gauge(const std::string& name, const std::string& help, const labels& labels,
+                             std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    family& f = registry[name];
+    if (f.type == nullptr) {
+        f.help = help;
+        f.type = "gauge";
+    }
+    f.series[label_text(labels)] = std::move(read);
+}
+
+std::string metrics::render() {
+    std::string out;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& [name, f] : registry) {
+        out += "# HELP " + name + ' ' + f.help + '\n';
+        out += "# TYPE " + name + ' ' + f.type + '\n';
+
+        for (const auto& [labels, m] : f.series) {
+            if (auto* c = std::get_if<std::unique_ptr<counter>>(&m)) {
+                out += name + labels + ' ';
+                append_number(out, (*c)->value());
+            } else if (auto* g = std::get_if<std::unique_ptr<gauge>>(&m)) {
+                out += name + labels + ' ' + std::to_string((*g)->value());
+            } else if (auto* h = std::get_if<std::unique_ptr<histogram>>(&m)) {
+                (*h)->render(out, name, labels);
+                continue;
+            } else if (auto* read = std::get_if<std::function<double()>>(&m)) {
+                out += name + labels + ' ';
+                append_number(out, (*read)());
+            }
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+bool metrics::serve(const std::string& address, uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        LOG_ERROR("invalid metrics address", logging::kv("address", address));
+        return false;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        LOG_ERROR("could not create metrics socket", logging::kv("error", std::strerror(errno)));
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        LOG_ERROR("could not listen for metrics", logging::kv("address", address), logging::kv("port", port),
+                  logging::kv("error", std::strerror(errno)));
+        close(fd);
+        return false;
+    }
+
+    listen_fd = fd;
+    stopping = false;
+    server = std::thread(run);
+    LOG_INFO("serving metrics", logging::kv("address", address), logging::kv("port", port));
+    return true;
+}
+
+void metrics::stop() {
+    stopping = true;
+    if (server.joinable()) server.join();
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        listen_fd = -1;
+    }
+}
@@ -0,0 +1,69 @@
+#include <png_encoder.h>
+
+#include <zlib.h>
+
+namespace {
+
+void put_u32(std::string& out, uint32_t value) {
+    out += static_cast<char>((value >> 24) & 0xFF);
+    out += static_cast<char>((value >> 16) & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+    out += static_cast<char>(value & 0xFF);
+}
+
+void put_chunk(std::string& out, const char* type, const uint8_t* data, size_t size) {
+    put_u32(out, static_cast<uint32_t>(size));
+    size_t type_pos = out.size();
+    out.append(type, 4);
+    out.append(reinterpret_cast<const char*>(data), size);
+
+    // CRC covers the chunk type and data
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(out.data() + type_pos), static_cast<uInt>(4 + size));
+    put_u32(out, static_cast<uint32_t>(crc));
+}
+
+}  // namespace
+
+std::string png::encode_rgb(int width, int height, const std::vector<uint8_t>& pixels) {
+    const size_t row_bytes = static_cast<size_t>(width) * 3;
+
+    // Each scanline is prefixed with its filter type. "Sub" (1) turns the
+    // long runs of flat background into zeros, which deflate very cheaply.
+    std::vector<uint8_t> filtered((row_bytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = pixels.data() + y * row_bytes;
+        uint8_t* dst = filtered.data() + y * (row_bytes + 1);
+        dst[0] = 1;
+        for (size_t x = 0; x < row_bytes; x++) {
+            dst[1 + x] = static_cast<uint8_t>(src[x] - (x >= 3 ? src[x - 3] : 0));
+        }
+    }
+
+    uLongf compressed_size = compressBound(static_cast<uLong>(filtered.size()));
+    std::vector<uint8_t> compressed(compressed_size);
+    if (compress2(compressed.data(), &compressed_size, filtered.data(),
+                  static_cast<uLong>(filtered.size()), Z_BEST_SPEED) != Z_OK) {
+        return "";
+    }
+
+    std::string out("\x89PNG\r\n\x1a\n", 8);
+
+    uint8_t header[13];
+    header[0] = (width >> 24) & 0xFF;
+    header[1] = (width >> 16) & 0xFF;
+    header[2] = (width >> 8) & 0xFF;
+    header[3] = width & 0xFF;
+    header[4] = (height >> 24) & 0xFF;
+    header[5] = (height >> 16) & 0xFF;
+    header[6] = (height >> 8) & 0xFF;
+    header[7] = height & 0xFF;
+    header[8] = 8;   // bit depth
+    header[9] = 2;   // color type: truecolor RGB
+    header[10] = 0;  // compression
+    header[11] = 0;  // filter method
+    header[12] = 0;  // no interlace
+    put_chunk(out, "IHDR", header, sizeof(header));
+    put_chunk(out, "IDAT", compressed.data(), compressed_size);
+    put_chunk(out, "IEND", nullptr, 0);
+    return out;
+}
@@ -0,0 +1,270 @@
+#include <logging.h>
+#include <price_alerts.h>
+#include <price_cache.h>
+#include <price_format.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+// Zero for IDR until the exchange rates have loaded
+double price_in(const gecko::price_quote& quote, gecko::alert_currency currency) {
+    return currency == gecko::alert_currency::idr ? gecko::idr_price(quote) : quote.usd;
+}
+
+void append_price(std::string& out, double value, gecko::alert_currency currency) {
+    if (currency == gecko::alert_currency::idr) {
+        // IDR prices are converted locally, so cap the noise digits
+        out += "Rp.";
+        pricefmt::append(out, value, std::min(pricefmt::precision_of(value), pricefmt::display_precision(value)),
+                         pricefmt::idr);
+    } else {
+        out += '$';
+        pricefmt::append(out, value, pricefmt::precision_of(value), pricefmt::usd);
+    }
+}
+
+}  // namespace
+
+std::string gecko::describe_alert(const price_alert& alert) {
+    std::string out = "#" + std::to_string(alert.id) + " " + alert.coingecko_id;
+    out += alert.direction == alert_direction::above ? " rises to " : " falls to ";
+    append_price(out, alert.target, alert.currency);
+    return out;
+}
+
+std::string gecko::alert_notification(const price_alert& alert, double price) {
+    std::string out = ":bell: <@" + std::to_string(alert.user_id) + "> " + alert.coingecko_id + " is now ";
+    append_price(out, price, alert.currency);
+    out += " (alert ";
+    out += describe_alert(alert);
+    out += ")";
+    return out;
+}
+
+gecko::alert_engine& gecko::alert_engine::instance() {
+    static alert_engine engine;
+    return engine;
+}
+
+gecko::alert_engine::~alert_engine() {
+    stop();
+}
+
+void gecko::alert_engine::start(std::chrono::seconds interval, size_t batch_size, size_t max_per_user,
+                                notify_callback notify) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interval_ = std::max(interval, std::chrono::seconds(1));
+        batch_size_ = std::max<size_t>(batch_size, 1);
+        max_per_user_ = max_per_user;
+        notify_ = std::move(notify);
+        stopping_ = false;
+    }
+    worker_ = std::thread(&alert_engine::run, this);
+}
+
+void gecko::alert_engine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    worker_cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void gecko::alert_engine::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!worker_cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+        lock.unlock();
+        tick();
+        lock.lock();
+    }
+}
+
+void gecko::alert_engine::tick() {
+    std::vector<std::string> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ticks_++;
+        if (outstanding_ > 0) {
+            // Upstream is slower than the interval; don't pile more requests on
+            skipped_ticks_++;
+            return;
+        }
+        ids.reserve(watches_.size());
+        for (const auto& [id, watch] : watches_) ids.push_back(id);
+    }
+
+    // Coins someone just looked up with /price need no request of their own
+    std::vector<std::string> stale;
+    for (const auto& id : ids) {
+        price_quote quote;
+        if (price_cache::instance().peek(id, quote)) {
+            deliver(id, quote);
+        } else {
+            stale.push_back(id);
+        }
+    }
+    if (stale.empty()) return;
+
+    std::vector<std::vector<std::string>> batches;
+    for (size_t i = 0; i < stale.size(); i += batch_size_) {
+        batches.emplace_back(stale.begin() + i, stale.begin() + std::min(stale.size(), i + batch_size_));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_ += batches.size();
+        requests_ += batches.size();
+    }
+    LOG_DEBUG("polling alert prices", logging::kv("coins", stale.size()), logging::kv("requests", batches.size()),
+              logging::kv("from_cache", ids.size() - stale.size()));
+
+    for (auto& batch : batches) {
+        fetch_quotes(
+            batch,
+            [this](const quote_map& results) {
+                for (const auto& [id, result] : results) {
+                    if (!result.ok) continue;
+                    price_cache::instance().store(id, result.quote);
+                    deliver(id, result.quote);
+                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                outstanding_--;
+            },
+            http::priority::background);
+    }
+}
+
+void gecko::alert_engine::deliver(const std::string& coingecko_id, const price_quote& quote) {
+    auto fired = evaluate(coingecko_id, quote);
+    if (fired.empty()) return;
+
+    notify_callback notify;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notify = notify_;
+    }
+    for (const auto& alert : fired) {
+        LOG_INFO("price alert triggered", logging::kv("alert", alert.id), logging::kv("coin", alert.coingecko_id),
+                 logging::kv("target", alert.target), logging::kv("price", price_in(quote, alert.currency)));
+        if (notify) notify(alert, price_in(quote, alert.currency));
+    }
+}
+
+bool gecko::alert_engine::add(price_alert& alert) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (per_user_[alert.user_id] >= max_per_user_) return false;
+    alert.id = next_id_++;
+    insert(alert);
+    return true;
+}
+
+bool gecko::alert_engine::remove(uint64_t user_id, uint64_t alert_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = alerts_.find(alert_id);
+    if (it == alerts_.end() || it->second.user_id != user_id) return false;
+    erase(it->second);
+    return true;
+}
+
+std::vector<gecko::price_alert> gecko::alert_engine::list(uint64_t user_id) const {
+    std::vector<price_alert> out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [id, alert] : alerts_) {
+            if (alert.user_id == user_id) out.push_back(alert);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const price_alert& a, const price_alert& b) { return a.id < b.id; });
+    return out;
+}
+
+std::vector<gecko::price_alert> gecko::alert_engine::evaluate(const std::string& coingecko_id,
+                                                              const price_quote& quote) {
+    std::vector<price_alert> fired;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto watch = watches_.find(coingecko_id);
+    if (watch == watches_.end()) return fired;
+
+    std::vector<uint64_t> ids;
+    for (alert_currency currency : {alert_currency::usd, alert_currency::idr}) {
+        double price = price_in(quote, currency);
+        // A zero price means the currency was missing from the response
+        if (price <= 0) continue;
+
+        // Targets at or below the price were crossed upwards...
+        const auto& above = watch->second.above[static_cast<int>(currency)];
+        for (auto it = above.begin(), end = above.upper_bound(price); it != end; ++it) ids.push_back(it->second);
+        // ...and targets at or above it downwards
+        const auto& below = watch->second.below[static_cast<int>(currency)];
+        for (auto it = below.lower_bound(price); it != below.end(); ++it) ids.push_back(it->second);
+    }
+
+    fired.reserve(ids.size());
+    for (uint64_t id : ids) {
+        auto it = alerts_.find(id);
+        fired.push_back(std::move(it->second));
+        erase(fired.back());
+    }
+    triggered_ += fired.size();
+    return fired;
+}
+
+gecko::alert_engine::stats gecko::alert_engine::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {alerts_.size(), watches_.size(), ticks_, requests_, triggered_, skipped_ticks_};
+}
+
+std::vector<gecko::price_alert> gecko::alert_engine::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<price_alert> out;
+    out.reserve(alerts_.size());
+    for (const auto& [id, alert] : alerts_) out.push_back(alert);
+    return out;
+}
+
+void gecko::alert_engine::restore(const std::vector<price_alert>& saved) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& alert : saved) {
+        if (alert.id == 0 || alerts_.count(alert.id)) continue;
+        insert(alert);
+        next_id_ = std::max(next_id_, alert.id + 1);
+    }
+}
+
+// Callers hold mutex_
+void gecko::alert_engine::insert(const price_alert& alert) {
+    watch& w = watches_[alert.coingecko_id];
+    auto& thresholds = alert.direction == alert_direction::above ? w.above : w.below;
+    thresholds[static_cast<int>(alert.currency)].emplace(alert.target, alert.id);
+    w.alerts++;
+    per_user_[alert.user_id]++;
+    alerts_[alert.id] = alert;
+}
+
+// Callers hold mutex_. `alert` may be the stored copy itself, so it's read
+// before being erased from alerts_.
+void gecko::alert_engine::erase(const price_alert& alert) {
+    uint64_t id = alert.id;
+    uint64_t user_id = alert.user_id;
+
+    auto watch = watches_.find(alert.coingecko_id);
+    if (watch != watches_.end()) {
+        auto& thresholds = alert.direction == alert_direction::above ? watch->second.above : watch->second.below;
+        auto& targets = thresholds[static_cast<int>(alert.currency)];
+        auto [first, last] = targets.equal_range(alert.target);
+        for (auto it = first; it != last; ++it) {
+            if (it->second == id) {
+                targets.erase(it);
+                break;
+            }
+        }
+        if (--watch->second.alerts == 0) watches_.erase(watch);
+    }
+
+    auto user = per_user_.find(user_id);
+    if (user != per_user_.end() && --user->second == 0) per_user_.erase(user);
+    alerts_.erase(id);
+}
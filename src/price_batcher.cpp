@@ -0,0 +1,98 @@
+#include <price_batcher.h>
+
+#include <algorithm>
+#include <memory>
+
+gecko::price_batcher& gecko::price_batcher::instance() {
+    static price_batcher batcher;
+    return batcher;
+}
+
+gecko::price_batcher::~price_batcher() {
+    stop();
+}
+
+void gecko::price_batcher::start(std::chrono::milliseconds window, size_t max_ids) {
+    window_ = std::max(window, std::chrono::milliseconds(1));
+    max_ids_ = std::max<size_t>(1, max_ids);
+    worker_ = std::thread(&price_batcher::run, this);
+}
+
+void gecko::price_batcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void gecko::price_batcher::enqueue(const std::string& coingecko_id, callback done) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    lookups_++;
+
+    auto& waiters = pending_.waiters[coingecko_id];
+    if (waiters.empty()) {
+        if (pending_.ids.empty()) first_enqueued_ = clock::now();
+        pending_.ids.push_back(coingecko_id);
+    }
+    waiters.push_back(std::move(done));
+
+    bool full = pending_.ids.size() >= max_ids_;
+    if (!worker_.joinable() || full) {
+        // Without a running worker (or with a full batch) send right away
+        batch ready = std::move(pending_);
+        pending_ = {};
+        lock.unlock();
+        flush(std::move(ready));
+        return;
+    }
+
+    lock.unlock();
+    cv_.notify_one();
+}
+
+void gecko::price_batcher::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (pending_.ids.empty()) {
+            cv_.wait(lock, [this] { return stopping_ || !pending_.ids.empty(); });
+            continue;
+        }
+
+        auto deadline = first_enqueued_ + window_;
+        if (clock::now() < deadline) {
+            cv_.wait_until(lock, deadline);
+            continue;
+        }
+
+        batch ready = std::move(pending_);
+        pending_ = {};
+        lock.unlock();
+        flush(std::move(ready));
+        lock.lock();
+    }
+}
+
+void gecko::price_batcher::flush(batch pending) {
+    if (pending.ids.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batches_++;
+    }
+
+    auto waiters = std::make_shared<std::unordered_map<std::string, std::vector<callback>>>(std::move(pending.waiters));
+    fetch_quotes(pending.ids, [waiters](const quote_map& results) {
+        for (const auto& [id, callbacks] : *waiters) {
+            auto it = results.find(id);
+            if (it == results.end()) continue;
+            for (const auto& done : callbacks) done(it->second);
+        }
+    });
+}
+
+gecko::price_batcher::stats gecko::price_batcher::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {lookups_, batches_};
+}
@@ -0,0 +1,177 @@
+#include <price_cache.h>
+
+#include <algorithm>
+
+// Sweep expired entries once the cache grows past this many coins
+static constexpr size_t kEvictThreshold = 4096;
+
+gecko::price_cache& gecko::price_cache::instance() {
+    static price_cache cache;
+    return cache;
+}
+
+void gecko::price_cache::configure(std::chrono::seconds ttl, std::chrono::seconds stale_ttl,
+                                   std::chrono::seconds fallback_ttl) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ttl_ = ttl;
+    stale_ttl_ = stale_ttl;
+    fallback_ttl_ = fallback_ttl;
+}
+
+bool gecko::price_cache::lookup(const std::string& coingecko_id, price_quote& quote) {
+    bool revalidate = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(coingecko_id);
+        if (it == entries_.end()) return false;
+
+        auto age = clock::now() - it->second.fetched_at;
+        if (age < ttl_) {
+            hits_++;
+        } else if (age < ttl_ + stale_ttl_) {
+            stale_hits_++;
+            // Revalidate in the background unless someone is already fetching
+            if (in_flight_.find(coingecko_id) == in_flight_.end()) {
+                in_flight_[coingecko_id];
+                revalidate = true;
+            }
+        } else {
+            return false;
+        }
+        quote = it->second.quote;
+    }
+
+    if (revalidate) start_fetch(coingecko_id);
+    return true;
+}
+
+bool gecko::price_cache::peek(const std::string& coingecko_id, price_quote& quote) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(coingecko_id);
+    if (it == entries_.end() || clock::now() - it->second.fetched_at >= ttl_) return false;
+    quote = it->second.quote;
+    return true;
+}
+
+void gecko::price_cache::store(const std::string& coingecko_id, const price_quote& quote) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = clock::now();
+    entries_[coingecko_id] = {quote, now};
+    if (entries_.size() > kEvictThreshold) evict_expired(now);
+}
+
+void gecko::price_cache::fetch(const std::string& coingecko_id, callback done) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(coingecko_id);
+        if (it != entries_.end() && clock::now() - it->second.fetched_at < ttl_) {
+            hits_++;
+            price_result result{true, it->second.quote, ""};
+            lock.unlock();
+            done(result);
+            return;
+        }
+
+        auto flight = in_flight_.find(coingecko_id);
+        if (flight != in_flight_.end()) {
+            coalesced_++;
+            flight->second.push_back(std::move(done));
+            return;
+        }
+
+        misses_++;
+        in_flight_[coingecko_id].push_back(std::move(done));
+    }
+
+    start_fetch(coingecko_id);
+}
+
+void gecko::price_cache::start_fetch(const std::string& coingecko_id) {
+    fetch_quote(coingecko_id, [this, coingecko_id](const price_result& result) {
+        complete(coingecko_id, result);
+    });
+}
+
+void gecko::price_cache::complete(const std::string& coingecko_id, const price_result& fetched) {
+    std::vector<callback> waiters;
+    price_result result = fetched;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = clock::now();
+        if (result.ok) {
+            entries_[coingecko_id] = {result.quote, now};
+            if (entries_.size() > kEvictThreshold) evict_expired(now);
+        } else {
+            // Degrade to the last known quote rather than failing outright
+            auto it = entries_.find(coingecko_id);
+            if (it != entries_.end() && now - it->second.fetched_at < fallback_ttl_) {
+                fallbacks_++;
+                result = {true, it->second.quote, "", true};
+            }
+        }
+
+        auto flight = in_flight_.find(coingecko_id);
+        if (flight != in_flight_.end()) {
+            waiters = std::move(flight->second);
+            in_flight_.erase(flight);
+        }
+    }
+
+    for (const auto& waiter : waiters) waiter(result);
+}
+
+void gecko::price_cache::evict_expired(clock::time_point now) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (now - it->second.fetched_at >= std::max(ttl_ + stale_ttl_, fallback_ttl_)) {
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::vector<gecko::price_cache::saved_entry> gecko::price_cache::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = clock::now();
+    auto wall_now = std::chrono::system_clock::now();
+    auto keep = std::max(ttl_ + stale_ttl_, fallback_ttl_);
+
+    std::vector<saved_entry> saved;
+    saved.reserve(entries_.size());
+    for (const auto& [id, e] : entries_) {
+        auto age = now - e.fetched_at;
+        if (age >= keep) continue;
+        saved.push_back({id, e.quote, wall_now - std::chrono::duration_cast<std::chrono::system_clock::duration>(age)});
+    }
+    return saved;
+}
+
+void gecko::price_cache::restore(const std::vector<saved_entry>& saved) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = clock::now();
+    auto wall_now = std::chrono::system_clock::now();
+    auto keep = std::max(ttl_ + stale_ttl_, fallback_ttl_);
+
+    for (const auto& s : saved) {
+        auto age = std::max(wall_now - s.fetched_at, std::chrono::system_clock::duration::zero());
+        if (age >= keep) continue;
+        auto fetched_at = now - std::chrono::duration_cast<clock::duration>(age);
+
+        auto it = entries_.find(s.coingecko_id);
+        if (it != entries_.end() && it->second.fetched_at >= fetched_at) continue;
+        entries_[s.coingecko_id] = {s.quote, fetched_at};
+    }
+}
+
+gecko::price_cache::stats gecko::price_cache::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats s;
+    s.hits = hits_;
+    s.stale_hits = stale_hits_;
+    s.misses = misses_;
+    s.coalesced = coalesced_;
+    s.fallbacks = fallbacks_;
+    s.entries = entries_.size();
+    return s;
+}
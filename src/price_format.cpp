@@ -0,0 +1,66 @@
+#include <price_format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+const pricefmt::number_style pricefmt::usd{',', '.', 3};
+const pricefmt::number_style pricefmt::idr{'.', ',', 3};
+
+// Matches what determine_precision_from_str allowed
+static constexpr int kMaxPrecision = 10;
+
+std::string_view pricefmt::formatter::format(double value, int precision, const number_style& style) {
+    if (!std::isfinite(value)) return "NaN";
+    precision = std::clamp(precision, 0, kMaxPrecision);
+
+    auto [end, ec] = std::to_chars(digits_, digits_ + sizeof(digits_), value, std::chars_format::fixed, precision);
+    if (ec != std::errc()) return "NaN";
+
+    // Copy the digits over, inserting separators
+    const char* digits = digits_;
+    char* out = buffer_;
+    if (*digits == '-') *out++ = *digits++;
+
+    const char* point = std::find(digits, static_cast<const char*>(end), '.');
+    size_t integer_digits = point - digits;
+    for (size_t i = 0; i < integer_digits; i++) {
+        if (i > 0 && style.group_size > 0 && (integer_digits - i) % style.group_size == 0) {
+            *out++ = style.group_separator;
+        }
+        *out++ = digits[i];
+    }
+
+    if (point != end) {
+        *out++ = style.decimal_separator;
+        out = std::copy(point + 1, static_cast<const char*>(end), out);
+    }
+    return std::string_view(buffer_, out - buffer_);
+}
+
+int pricefmt::precision_of(double value) {
+    if (!std::isfinite(value)) return 0;
+
+    // Shortest digits that round-trip, written without an exponent
+    char buffer[400];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed);
+    if (ec != std::errc()) return 0;
+
+    const char* point = std::find(buffer, end, '.');
+    if (point == end) return 0;
+    return std::min(static_cast<int>(end - point - 1), kMaxPrecision);
+}
+
+int pricefmt::display_precision(double value) {
+    value = std::fabs(value);
+    if (!std::isfinite(value) || value == 0) return 0;
+    if (value >= 1) return 2;
+    // Zeros between the point and the first significant digit, e.g. 1 for 0.0123
+    int leading = static_cast<int>(std::floor(-std::log10(value)));
+    return std::min(leading + 4, kMaxPrecision);
+}
+
+void pricefmt::append(std::string& out, double value, int precision, const number_style& style) {
+    thread_local formatter f;
+    out.append(f.format(value, precision, style));
+}
@@ -1,22 +1,20 @@
+#include <http_client.h>
+#include <logging.h>
+#include <metrics.h>
 #include <quickchart.h>
 
 using json = nlohmann::json;
 
-// This callback function is called by curl_easy_perform() to write the response
-// data into a string
-size_t qchart::write_callback(char* ptr, size_t size, size_t nmemb,
-                              std::string* data) {
-  data->append(ptr, size * nmemb);
-  return size * nmemb;
+static std::string quickchart_base_url = "https://quickchart.io";
+
+void qchart::configure_base_url(const std::string& url) {
+  quickchart_base_url = url;
+  while (!quickchart_base_url.empty() && quickchart_base_url.back() == '/') quickchart_base_url.pop_back();
 }
 
-std::string qchart::generate_chart(std::vector<long> data1, std::string label,
-                                   std::vector<double> data2) {
-  CURL* curl = curl_easy_init();
-  if (!curl) {
-    std::cerr << "Error: could not initialize libcurl" << std::endl;
-    return "";
-  }
+void qchart::generate_chart(std::vector<long> data1, std::string label,
+                            std::vector<double> data2,
+                            std::function<void(std::string)> done) {
   json datasets = json::array();
   datasets.push_back({{"label", label}, {"data", data2}});
   json req_body = {{"backgroundColor", "#fff"},
@@ -27,39 +25,29 @@ std::string qchart::generate_chart(std::vector<long> data1, std::string label,
                     {{"type", "line"},
                      {"data", {{"labels", data1}, {"datasets", datasets}}}}}};
   std::string request = req_body.dump();
-  std::cout << request << std::endl;
-  std::string url = "https://quickchart.io/chart/create";
-  std::string response_data;
-  struct curl_slist* headers = NULL;
-  headers = curl_slist_append(headers, "Content-Type: application/json");
-  headers = curl_slist_append(headers, "Accept: application/json");
-  headers = curl_slist_append(headers, "charset: utf-8");
-  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.c_str());
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-
-  CURLcode res = curl_easy_perform(curl);
-  if (res != CURLE_OK) {
-    std::cerr << "Error: curl_easy_perform() failed: "
-              << curl_easy_strerror(res) << std::endl;
-    curl_easy_cleanup(curl);
-    return "";
-  }
+  LOG_DEBUG("quickchart request", logging::kv("body", request));
 
-  try {
-    json response_json = json::parse(response_data);
-    std::cout << "=============================" << std::endl;
-    std::cout << ">> quickchart response: " << response_json << std::endl;
-    return response_json["url"];
-  } catch (const std::exception& e) {
-    std::cerr << "Error: failed to parse JSON response: " << e.what()
-              << std::endl;
-    curl_easy_cleanup(curl);
-    return "";
-  }
+  http::post_json_async(
+      quickchart_base_url + "/chart/create", request,
+      [done](http::response res) {
+        if (!res.ok()) {
+          LOG_ERROR("quickchart request failed", logging::kv("error", res.error()));
+          done("");
+          return;
+        }
 
-  curl_easy_cleanup(curl);
-  return "";
+        try {
+          LOG_DEBUG("quickchart response", logging::kv("body", res.body));
+          auto parse_start = std::chrono::steady_clock::now();
+          json response_json = json::parse(res.body);
+          static metrics::histogram& parse_time = metrics::get_histogram(
+              "bot_json_parse_seconds", "Time spent parsing upstream JSON", {{"document", "quickchart"}});
+          parse_time.observe_since(parse_start);
+          done(response_json["url"]);
+        } catch (const std::exception& e) {
+          LOG_ERROR("failed to parse quickchart response",
+                    logging::kv("error", e.what()));
+          done("");
+        }
+      });
 }
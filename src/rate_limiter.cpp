@@ -0,0 +1,78 @@
+#include <rate_limiter.h>
+
+#include <algorithm>
+
+// Backoff bounds when a 429 comes without Retry-After
+static constexpr std::chrono::milliseconds kMinBackoff{1000};
+static constexpr std::chrono::milliseconds kMaxBackoff{60000};
+
+http::rate_limiter::rate_limiter(std::string name, double requests_per_minute, double burst)
+    : name_(std::move(name)),
+      max_rate_(std::max(requests_per_minute, 1.0) / 60.0),
+      rate_(max_rate_),
+      burst_(std::max(burst, 1.0)),
+      tokens_(burst_),
+      last_refill_(clock::now()) {}
+
+void http::rate_limiter::refill(clock::time_point now) {
+    if (now <= last_refill_) return;
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+    last_refill_ = now;
+}
+
+bool http::rate_limiter::try_acquire(clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now < paused_until_) return false;
+
+    refill(now);
+    if (tokens_ < 1.0) return false;
+
+    tokens_ -= 1.0;
+    granted_++;
+    return true;
+}
+
+http::rate_limiter::clock::time_point http::rate_limiter::next_available(clock::time_point now) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now < paused_until_) return paused_until_;
+
+    refill(now);
+    if (tokens_ >= 1.0) return now;
+    auto wait = std::chrono::duration<double>((1.0 - tokens_) / rate_);
+    return now + std::chrono::duration_cast<clock::duration>(wait);
+}
+
+void http::rate_limiter::on_success() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rate_ = std::min(max_rate_, rate_ + max_rate_ / 20);
+    backoff_ = std::chrono::milliseconds(0);
+}
+
+http::rate_limiter::clock::time_point http::rate_limiter::on_throttled(clock::time_point now,
+                                                                       std::chrono::milliseconds retry_after) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    throttled_++;
+
+    if (retry_after.count() > 0) {
+        backoff_ = retry_after;
+    } else {
+        backoff_ = std::clamp(backoff_ * 2, kMinBackoff, kMaxBackoff);
+    }
+
+    paused_until_ = std::max(paused_until_, now + backoff_);
+    rate_ = std::max(max_rate_ / 16, rate_ / 2);
+    tokens_ = 0;
+    last_refill_ = paused_until_;
+    return paused_until_;
+}
+
+http::rate_limiter::stats http::rate_limiter::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats s;
+    s.granted = granted_;
+    s.throttled = throttled_;
+    s.rate_per_minute = rate_ * 60;
+    s.paused = clock::now() < paused_until_;
+    return s;
+}
@@ -0,0 +1,447 @@
+#include <coingecko.h>
+#include <series_store.h>
+
+#include <algorithm>
+
+namespace {
+
+constexpr int64_t kHourMs = 3600 * 1000;
+constexpr int64_t kDayMs = 24 * kHourMs;
+
+// A little over a day of 5 minute points, and a little over the 7d and 30d
+// ranges in 1 hour and 4 hour candles
+constexpr size_t kRawCapacity = 360;
+constexpr size_t kHourlyCapacity = 192;
+constexpr size_t kFourHourlyCapacity = 192;
+
+// Raw points further apart than this leave a hole; start over from the newer one
+constexpr int64_t kMaxRawGap = 30 * 60 * 1000;
+
+// CoinGecko only returns 5 minute points for spans under a day, so a series
+// that fell further behind is loaded again instead of caught up
+constexpr int64_t kMaxCatchUp = 23 * kHourMs;
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+int64_t span_ms(gecko::chart_range range) {
+    return gecko::range_days(range) * kDayMs;
+}
+
+}  // namespace
+
+const char* gecko::range_key(chart_range range) {
+    switch (range) {
+    case chart_range::week:
+        return "7d";
+    case chart_range::month:
+        return "30d";
+    default:
+        return "1d";
+    }
+}
+
+bool gecko::parse_range(const std::string& key, chart_range& out) {
+    if (key == "1d") {
+        out = chart_range::day;
+    } else if (key == "7d") {
+        out = chart_range::week;
+    } else if (key == "30d") {
+        out = chart_range::month;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int gecko::range_days(chart_range range) {
+    switch (range) {
+    case chart_range::week:
+        return 7;
+    case chart_range::month:
+        return 30;
+    default:
+        return 1;
+    }
+}
+
+void gecko::price_series::candles::add(int64_t ts, double price) {
+    if (ts <= last_ms) return;
+    int64_t bucket = ts - ts % width_ms;
+    if (!start.empty() && start.back() == bucket) {
+        high.back() = std::max(high.back(), price);
+        low.back() = std::min(low.back(), price);
+        close.back() = price;
+    } else {
+        if (start.empty() && complete_from == 0) complete_from = ts;
+        start.push_back(bucket);
+        open.push_back(price);
+        high.push_back(price);
+        low.push_back(price);
+        close.push_back(price);
+    }
+    last_ms = ts;
+}
+
+void gecko::price_series::candles::clear() {
+    start.clear();
+    open.clear();
+    high.clear();
+    low.clear();
+    close.clear();
+    last_ms = 0;
+    complete_from = 0;
+}
+
+gecko::price_series::saved_level gecko::price_series::candles::save() const {
+    saved_level out;
+    out.complete_from = complete_from;
+    out.last_ms = last_ms;
+    out.time.reserve(start.size());
+    out.price.reserve(start.size());
+    for (size_t i = 0; i < start.size(); i++) {
+        out.time.push_back(start[i]);
+        out.price.push_back(close[i]);
+    }
+    return out;
+}
+
+bool gecko::price_series::candles::restore(const saved_level& level) {
+    clear();
+    if (level.time.size() != level.price.size()) return false;
+    for (size_t i = 0; i < level.time.size(); i++) {
+        int64_t bucket = level.time[i];
+        if (bucket % width_ms != 0 || (i > 0 && bucket <= level.time[i - 1])) return false;
+        double price = level.price[i];
+        start.push_back(bucket);
+        open.push_back(price);
+        high.push_back(price);
+        low.push_back(price);
+        close.push_back(price);
+    }
+    if (!start.empty() && level.last_ms < start.back()) return false;
+    last_ms = level.last_ms;
+    complete_from = level.complete_from;
+    return true;
+}
+
+gecko::price_series::price_series()
+    : raw_(kRawCapacity), hourly_(kHourMs, kHourlyCapacity), four_hourly_(4 * kHourMs, kFourHourlyCapacity) {}
+
+void gecko::price_series::roll_up(int64_t ts, double price) {
+    hourly_.add(ts, price);
+    four_hourly_.add(ts, price);
+    latest_ms_ = std::max(latest_ms_, ts);
+}
+
+void gecko::price_series::add_points(const std::vector<long>& timestamps, const std::vector<double>& prices) {
+    size_t count = std::min(timestamps.size(), prices.size());
+    for (size_t i = 0; i < count; i++) {
+        int64_t ts = timestamps[i];
+        if (!raw_.time.empty() && ts - raw_.time.back() > kMaxRawGap) {
+            raw_.time.clear();
+            raw_.price.clear();
+            raw_.complete_from = 0;
+        }
+        if (raw_.time.empty() || ts > raw_.time.back()) {
+            if (raw_.time.empty()) raw_.complete_from = ts;
+            raw_.time.push_back(ts);
+            raw_.price.push_back(prices[i]);
+        }
+        roll_up(ts, prices[i]);
+    }
+}
+
+void gecko::price_series::load_points(const std::vector<long>& timestamps, const std::vector<double>& prices,
+                                      int64_t from_ms) {
+    raw_.time.clear();
+    raw_.price.clear();
+    add_points(timestamps, prices);
+    // Upstream had nothing older, e.g. for a coin listed this morning
+    raw_.complete_from = from_ms;
+}
+
+void gecko::price_series::load_hourly(const std::vector<long>& timestamps, const std::vector<double>& prices,
+                                      int64_t from_ms) {
+    hourly_.clear();
+    four_hourly_.clear();
+    size_t count = std::min(timestamps.size(), prices.size());
+    for (size_t i = 0; i < count; i++) roll_up(timestamps[i], prices[i]);
+    hourly_.complete_from = from_ms;
+    four_hourly_.complete_from = from_ms;
+
+    // Raw points past the last hourly one are finer than it
+    for (size_t i = 0; i < raw_.time.size(); i++) roll_up(raw_.time[i], raw_.price[i]);
+}
+
+void gecko::price_series::clear() {
+    raw_.time.clear();
+    raw_.price.clear();
+    raw_.complete_from = 0;
+    hourly_.clear();
+    four_hourly_.clear();
+    latest_ms_ = 0;
+}
+
+bool gecko::price_series::covers(chart_range range, int64_t now_ms) const {
+    int64_t want = now_ms - span_ms(range);
+    if (range == chart_range::day) {
+        if (raw_.time.empty()) return false;
+        // Once the buffer wraps, its oldest point is where the data starts
+        int64_t from = raw_.time.size() == raw_.time.capacity() ? std::max(raw_.complete_from, raw_.time[0])
+                                                                  : raw_.complete_from;
+        return from <= want;
+    }
+    const candles& level = range == chart_range::week ? hourly_ : four_hourly_;
+    if (level.start.empty()) return false;
+    int64_t from = level.start.size() == level.start.capacity() ? std::max(level.complete_from, level.start[0])
+                                                                  : level.complete_from;
+    return from <= want;
+}
+
+int64_t gecko::price_series::latest_point() const {
+    return raw_.time.empty() ? 0 : raw_.time.back();
+}
+
+void gecko::price_series::read(chart_range range, int64_t now_ms, std::vector<long>& timestamps,
+                               std::vector<double>& prices) const {
+    int64_t from = now_ms - span_ms(range);
+    timestamps.clear();
+    prices.clear();
+    if (range == chart_range::day) {
+        for (size_t i = 0; i < raw_.time.size(); i++) {
+            if (raw_.time[i] < from) continue;
+            timestamps.push_back(static_cast<long>(raw_.time[i]));
+            prices.push_back(raw_.price[i]);
+        }
+        return;
+    }
+
+    // Each candle is plotted at its close: the end of its interval, or the
+    // latest point for the one still open
+    const candles& level = range == chart_range::week ? hourly_ : four_hourly_;
+    for (size_t i = 0; i < level.start.size(); i++) {
+        int64_t closed_at = std::min(level.start[i] + level.width_ms, level.last_ms);
+        if (closed_at < from) continue;
+        timestamps.push_back(static_cast<long>(closed_at));
+        prices.push_back(level.close[i]);
+    }
+}
+
+std::vector<gecko::price_series::saved_level> gecko::price_series::save() const {
+    saved_level raw;
+    raw.complete_from = raw_.complete_from;
+    raw.last_ms = latest_point();
+    raw.time.reserve(raw_.time.size());
+    raw.price.reserve(raw_.time.size());
+    for (size_t i = 0; i < raw_.time.size(); i++) {
+        raw.time.push_back(raw_.time[i]);
+        raw.price.push_back(raw_.price[i]);
+    }
+    return {std::move(raw), hourly_.save(), four_hourly_.save()};
+}
+
+bool gecko::price_series::restore(const std::vector<saved_level>& levels) {
+    clear();
+    if (levels.size() != 3 || levels[0].time.size() != levels[0].price.size()) return false;
+
+    const saved_level& raw = levels[0];
+    for (size_t i = 0; i < raw.time.size(); i++) {
+        if (i > 0 && raw.time[i] <= raw.time[i - 1]) {
+            clear();
+            return false;
+        }
+        raw_.time.push_back(raw.time[i]);
+        raw_.price.push_back(raw.price[i]);
+    }
+    raw_.complete_from = raw.complete_from;
+    if (!hourly_.restore(levels[1]) || !four_hourly_.restore(levels[2])) {
+        clear();
+        return false;
+    }
+    latest_ms_ = std::max({latest_point(), hourly_.last_ms, four_hourly_.last_ms});
+    return true;
+}
+
+gecko::series_store& gecko::series_store::instance() {
+    static series_store store;
+    return store;
+}
+
+void gecko::series_store::configure(std::chrono::seconds refresh_interval, size_t max_series) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refresh_interval_ = std::max(refresh_interval, std::chrono::seconds(1));
+    max_series_ = std::max<size_t>(max_series, 1);
+}
+
+void gecko::series_store::fetch(const std::string& coingecko_id, chart_range range, callback done) {
+    load_plan plan;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto now = clock::now();
+        int64_t wall_now = now_ms();
+
+        auto [it, inserted] = entries_.try_emplace(coingecko_id);
+        if (inserted) evict(coingecko_id);
+        entry& e = it->second;
+        e.used_at = now;
+
+        if (e.in_flight) {
+            coalesced_++;
+            e.waiters.push_back({range, std::move(done)});
+            return;
+        }
+
+        if (e.series.latest() != 0 && wall_now - e.series.latest() >= kMaxCatchUp) e.series.clear();
+
+        if (!e.series.covers(range, wall_now)) {
+            loads_++;
+            plan.days = range_days(range);
+            plan.from_ms = wall_now - span_ms(range);
+        } else if (now - e.checked_at >= refresh_interval_) {
+            refreshes_++;
+            // Catch the raw points up too when a longer range was loaded since
+            plan.from_ms = e.series.latest_point();
+            if (wall_now - plan.from_ms >= kMaxCatchUp) plan.from_ms = e.series.latest();
+        } else {
+            hits_++;
+            price_history out;
+            out.ok = true;
+            e.series.read(range, wall_now, out.timestamps, out.prices);
+            lock.unlock();
+            done(out);
+            return;
+        }
+
+        e.in_flight = true;
+        e.waiters.push_back({range, std::move(done)});
+    }
+
+    start_load(coingecko_id, plan);
+}
+
+void gecko::series_store::start_load(const std::string& coingecko_id, load_plan plan) {
+    fetch_price_history(coingecko_id, plan.days, plan.from_ms, [this, coingecko_id, plan](const price_history& loaded) {
+        complete(coingecko_id, plan, loaded);
+    });
+}
+
+void gecko::series_store::complete(const std::string& coingecko_id, load_plan plan, const price_history& loaded) {
+    std::vector<std::pair<callback, price_history>> results;
+    std::vector<waiter> retry;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(coingecko_id);
+        if (it == entries_.end()) return;
+        entry& e = it->second;
+        e.in_flight = false;
+        auto now = clock::now();
+        int64_t wall_now = now_ms();
+
+        if (loaded.ok) {
+            if (plan.days == 1) {
+                e.series.load_points(loaded.timestamps, loaded.prices, plan.from_ms);
+            } else if (plan.days > 1) {
+                e.series.load_hourly(loaded.timestamps, loaded.prices, plan.from_ms);
+            } else {
+                e.series.add_points(loaded.timestamps, loaded.prices);
+            }
+            e.checked_at = now;
+        }
+
+        for (auto& w : e.waiters) {
+            price_history out;
+            if (e.series.covers(w.range, wall_now)) {
+                // A failed refresh still leaves data less than a day old to serve
+                out.ok = true;
+                e.series.read(w.range, wall_now, out.timestamps, out.prices);
+            } else if (loaded.ok) {
+                // Joined a load of a shorter range
+                retry.push_back(std::move(w));
+                continue;
+            } else {
+                out = loaded;
+            }
+            results.emplace_back(std::move(w.done), std::move(out));
+        }
+        e.waiters.clear();
+    }
+
+    for (auto& [done, out] : results) done(out);
+    for (auto& w : retry) fetch(coingecko_id, w.range, std::move(w.done));
+}
+
+void gecko::series_store::evict(const std::string& keep) {
+    while (entries_.size() > max_series_) {
+        auto oldest = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->second.in_flight || it->first == keep) continue;
+            if (oldest == entries_.end() || it->second.used_at < oldest->second.used_at) oldest = it;
+        }
+        if (oldest == entries_.end()) return;
+        entries_.erase(oldest);
+    }
+}
+
+gecko::series_store::stats gecko::series_store::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats out;
+    out.hits = hits_;
+    out.refreshes = refreshes_;
+    out.loads = loads_;
+    out.coalesced = coalesced_;
+    out.series = entries_.size();
+    return out;
+}
+
+std::vector<gecko::series_store::saved_entry> gecko::series_store::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<const std::pair<const std::string, entry>*> held;
+    held.reserve(entries_.size());
+    for (const auto& item : entries_) {
+        if (item.second.series.latest() != 0) held.push_back(&item);
+    }
+    std::sort(held.begin(), held.end(), [](const auto* a, const auto* b) { return a->second.used_at > b->second.used_at; });
+
+    auto now = clock::now();
+    auto wall_now = std::chrono::system_clock::now();
+    std::vector<saved_entry> out;
+    out.reserve(held.size());
+    for (const auto* item : held) {
+        saved_entry saved;
+        saved.coingecko_id = item->first;
+        saved.checked_at = wall_now - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                          now - item->second.checked_at);
+        saved.levels = item->second.series.save();
+        out.push_back(std::move(saved));
+    }
+    return out;
+}
+
+void gecko::series_store::restore(const std::vector<saved_entry>& saved) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = clock::now();
+    auto wall_now = std::chrono::system_clock::now();
+    int64_t wall_now_ms = now_ms();
+
+    // Keep the saved order for eviction: the first entry was charted last
+    auto used_at = now;
+    for (const auto& item : saved) {
+        if (entries_.size() >= max_series_) break;
+        if (entries_.count(item.coingecko_id)) continue;
+
+        price_series series;
+        if (!series.restore(item.levels) || series.latest() == 0 || wall_now_ms - series.latest() >= kMaxCatchUp) {
+            continue;
+        }
+        entry& e = entries_[item.coingecko_id];
+        e.series = std::move(series);
+        auto age = std::max(wall_now - item.checked_at, std::chrono::system_clock::duration::zero());
+        e.checked_at = now - std::chrono::duration_cast<clock::duration>(age);
+        e.used_at = used_at;
+        used_at -= std::chrono::milliseconds(1);
+    }
+}
@@ -0,0 +1,600 @@
+#include <coin_index.h>
+#include <fx_rates.h>
+#include <logging.h>
+#include <price_alerts.h>
+#include <price_cache.h>
+#include <series_store.h>
+#include <snapshot.h>
+#include <ticker_board.h>
+#include <watchlists.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+using system_clock = std::chrono::system_clock;
+
+constexpr char kMagic[4] = {'C', 'P', 'B', 'S'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 4 + 4 + 8 + 4 + 8;
+
+enum section_tag : uint32_t {
+    coin_index_section = 1,
+    price_cache_section = 2,
+    coin_ranks_section = 3,
+    price_alerts_section = 4,
+    price_tickers_section = 5,
+    fx_rates_section = 6,
+    watchlists_section = 7,
+    price_series_section = 8,
+};
+
+int64_t to_unix_ms(system_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+
+system_clock::time_point from_unix_ms(int64_t ms) {
+    return system_clock::time_point(std::chrono::milliseconds(ms));
+}
+
+uint64_t fnv1a(const char* data, size_t size) {
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+class writer {
+public:
+    template <typename T>
+    void put(T value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put(const std::string& text) {
+        put(static_cast<uint32_t>(text.size()));
+        out_.append(text);
+    }
+
+    // Start a section; returns the offset of its size field
+    size_t begin_section(section_tag tag) {
+        sections_++;
+        put(static_cast<uint32_t>(tag));
+        size_t at = out_.size();
+        put(uint64_t{0});
+        return at;
+    }
+
+    void end_section(size_t size_at) {
+        uint64_t size = out_.size() - size_at - sizeof(uint64_t);
+        std::memcpy(&out_[size_at], &size, sizeof(size));
+    }
+
+    std::string& data() { return out_; }
+    uint32_t sections() const { return sections_; }
+
+private:
+    std::string out_;
+    uint32_t sections_ = 0;
+};
+
+// Bounds-checked reads straight out of the mapped file
+class reader {
+public:
+    reader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) return false;
+        std::memcpy(&value, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+
+    bool get(std::string& text) {
+        uint32_t size = 0;
+        if (!get(size) || static_cast<size_t>(end_ - p_) < size) return false;
+        text.assign(p_, size);
+        p_ += size;
+        return true;
+    }
+
+    bool skip(size_t size) {
+        if (static_cast<size_t>(end_ - p_) < size) return false;
+        p_ += size;
+        return true;
+    }
+
+    const char* position() const { return p_; }
+    size_t remaining() const { return end_ - p_; }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+void write_coin_index(writer& w) {
+    auto& index = gecko::coin_index::instance();
+    auto snapshot = index.snapshot();
+    if (!snapshot) return;
+
+    size_t section = w.begin_section(coin_index_section);
+    w.put(to_unix_ms(index.built_at()));
+    w.put(static_cast<uint32_t>(snapshot->size()));
+    for (const auto& [symbol, coins] : *snapshot) {
+        w.put(symbol);
+        w.put(static_cast<uint32_t>(coins.size()));
+        for (const auto& coin : coins) {
+            w.put(coin.id);
+            w.put(coin.name);
+        }
+    }
+    w.end_section(section);
+}
+
+void write_coin_ranks(writer& w) {
+    auto ranks = gecko::coin_index::instance().ranks();
+    if (!ranks || ranks->empty()) return;
+
+    size_t section = w.begin_section(coin_ranks_section);
+    w.put(static_cast<uint32_t>(ranks->size()));
+    for (const auto& [id, rank] : *ranks) {
+        w.put(id);
+        w.put(rank);
+    }
+    w.end_section(section);
+}
+
+void write_price_cache(writer& w) {
+    auto saved = gecko::price_cache::instance().save();
+
+    size_t section = w.begin_section(price_cache_section);
+    w.put(static_cast<uint32_t>(saved.size()));
+    for (const auto& entry : saved) {
+        w.put(entry.coingecko_id);
+        w.put(entry.quote.usd);
+        w.put(static_cast<int32_t>(entry.quote.usd_precision));
+        w.put(to_unix_ms(entry.fetched_at));
+    }
+    w.end_section(section);
+}
+
+void write_price_alerts(writer& w) {
+    auto alerts = gecko::alert_engine::instance().save();
+
+    size_t section = w.begin_section(price_alerts_section);
+    w.put(static_cast<uint32_t>(alerts.size()));
+    for (const auto& alert : alerts) {
+        w.put(alert.id);
+        w.put(alert.user_id);
+        w.put(alert.channel_id);
+        w.put(alert.coingecko_id);
+        w.put(static_cast<uint8_t>(alert.currency));
+        w.put(static_cast<uint8_t>(alert.direction));
+        w.put(alert.target);
+        w.put(to_unix_ms(alert.created_at));
+    }
+    w.end_section(section);
+}
+
+void write_price_tickers(writer& w) {
+    auto tickers = gecko::ticker_board::instance().save();
+
+    size_t section = w.begin_section(price_tickers_section);
+    w.put(static_cast<uint32_t>(tickers.size()));
+    for (const auto& ticker : tickers) {
+        w.put(ticker.id);
+        w.put(ticker.channel_id);
+        w.put(ticker.message_id);
+        w.put(ticker.user_id);
+        w.put(ticker.coingecko_id);
+        w.put(static_cast<int64_t>(ticker.interval.count()));
+        w.put(to_unix_ms(ticker.created_at));
+    }
+    w.end_section(section);
+}
+
+void write_fx_rates(writer& w) {
+    auto& fx = gecko::fx_rates::instance();
+    auto rates = fx.snapshot();
+    if (!rates) return;
+
+    size_t section = w.begin_section(fx_rates_section);
+    w.put(to_unix_ms(fx.built_at()));
+    w.put(static_cast<uint32_t>(rates->size()));
+    for (const auto& [code, rate] : *rates) {
+        w.put(code);
+        w.put(rate.name);
+        w.put(rate.unit);
+        w.put(rate.type);
+        w.put(rate.per_btc);
+    }
+    w.end_section(section);
+}
+
+void write_watchlists(writer& w) {
+    auto lists = gecko::watchlists::instance().save();
+
+    size_t section = w.begin_section(watchlists_section);
+    w.put(static_cast<uint32_t>(lists.size()));
+    for (const auto& list : lists) {
+        w.put(list.user_id);
+        w.put(static_cast<uint32_t>(list.ids.size()));
+        for (const auto& id : list.ids) w.put(id);
+    }
+    w.end_section(section);
+}
+
+void write_price_series(writer& w) {
+    auto saved = gecko::series_store::instance().save();
+
+    size_t section = w.begin_section(price_series_section);
+    w.put(static_cast<uint32_t>(saved.size()));
+    for (const auto& entry : saved) {
+        w.put(entry.coingecko_id);
+        w.put(to_unix_ms(entry.checked_at));
+        w.put(static_cast<uint32_t>(entry.levels.size()));
+        for (const auto& level : entry.levels) {
+            w.put(level.complete_from);
+            w.put(level.last_ms);
+            w.put(static_cast<uint32_t>(level.time.size()));
+            for (int64_t time : level.time) w.put(time);
+            for (double price : level.price) w.put(price);
+        }
+    }
+    w.end_section(section);
+}
+
+bool read_coin_index(reader& r, std::shared_ptr<gecko::coin_index::symbol_map>& index,
+                     system_clock::time_point& built_at) {
+    int64_t built_at_ms = 0;
+    uint32_t symbols = 0;
+    if (!r.get(built_at_ms) || !r.get(symbols)) return false;
+    built_at = from_unix_ms(built_at_ms);
+
+    index = std::make_shared<gecko::coin_index::symbol_map>();
+    index->reserve(symbols);
+    for (uint32_t i = 0; i < symbols; i++) {
+        std::string symbol;
+        uint32_t count = 0;
+        if (!r.get(symbol) || !r.get(count)) return false;
+
+        auto& coins = (*index)[symbol];
+        coins.resize(count);
+        for (auto& coin : coins) {
+            if (!r.get(coin.id) || !r.get(coin.name)) return false;
+        }
+    }
+    return true;
+}
+
+bool read_coin_ranks(reader& r, std::shared_ptr<gecko::coin_index::rank_map>& ranks) {
+    uint32_t count = 0;
+    if (!r.get(count)) return false;
+
+    ranks = std::make_shared<gecko::coin_index::rank_map>();
+    ranks->reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        std::string id;
+        uint32_t rank = 0;
+        if (!r.get(id) || !r.get(rank)) return false;
+        (*ranks)[std::move(id)] = rank;
+    }
+    return true;
+}
+
+bool read_price_cache(reader& r, std::vector<gecko::price_cache::saved_entry>& saved) {
+    uint32_t count = 0;
+    if (!r.get(count)) return false;
+
+    saved.resize(count);
+    for (auto& entry : saved) {
+        int32_t usd_precision = 0;
+        int64_t fetched_at_ms = 0;
+        if (!r.get(entry.coingecko_id) || !r.get(entry.quote.usd) || !r.get(usd_precision) ||
+            !r.get(fetched_at_ms)) {
+            return false;
+        }
+        entry.quote.usd_precision = usd_precision;
+        entry.fetched_at = from_unix_ms(fetched_at_ms);
+    }
+    return true;
+}
+
+bool read_price_alerts(reader& r, std::vector<gecko::price_alert>& alerts) {
+    uint32_t count = 0;
+    if (!r.get(count)) return false;
+
+    alerts.resize(count);
+    for (auto& alert : alerts) {
+        uint8_t currency = 0;
+        uint8_t direction = 0;
+        int64_t created_ms = 0;
+        if (!r.get(alert.id) || !r.get(alert.user_id) || !r.get(alert.channel_id) || !r.get(alert.coingecko_id) ||
+            !r.get(currency) || !r.get(direction) || !r.get(alert.target) || !r.get(created_ms)) {
+            return false;
+        }
+        if (currency > 1 || direction > 1) return false;
+        alert.currency = static_cast<gecko::alert_currency>(currency);
+        alert.direction = static_cast<gecko::alert_direction>(direction);
+        alert.created_at = from_unix_ms(created_ms);
+    }
+    return true;
+}
+
+bool read_price_tickers(reader& r, std::vector<gecko::price_ticker>& tickers) {
+    uint32_t count = 0;
+    if (!r.get(count)) return false;
+
+    tickers.resize(count);
+    for (auto& ticker : tickers) {
+        int64_t interval = 0;
+        int64_t created_ms = 0;
+        if (!r.get(ticker.id) || !r.get(ticker.channel_id) || !r.get(ticker.message_id) || !r.get(ticker.user_id) ||
+            !r.get(ticker.coingecko_id) || !r.get(interval) || !r.get(created_ms)) {
+            return false;
+        }
+        if (interval <= 0) return false;
+        ticker.interval = std::chrono::seconds(interval);
+        ticker.created_at = from_unix_ms(created_ms);
+    }
+    return true;
+}
+
+bool read_fx_rates(reader& r, std::shared_ptr<gecko::fx_rates::rate_map>& rates,
+                   system_clock::time_point& built_at) {
+    int64_t built_at_ms = 0;
+    uint32_t count = 0;
+    if (!r.get(built_at_ms) || !r.get(count)) return false;
+    built_at = from_unix_ms(built_at_ms);
+
+    rates = std::make_shared<gecko::fx_rates::rate_map>();
+    rates->reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        std::string code;
+        gecko::currency_rate rate;
+        if (!r.get(code) || !r.get(rate.name) || !r.get(rate.unit) || !r.get(rate.type) || !r.get(rate.per_btc)) {
+            return false;
+        }
+        if (!(rate.per_btc > 0)) return false;
+        (*rates)[std::move(code)] = std::move(rate);
+    }
+    return rates->count("usd") > 0;
+}
+
+bool read_watchlists(reader& r, std::vector<gecko::watchlist>& lists) {
+    uint32_t count = 0;
+    if (!r.get(count)) return false;
+
+    lists.resize(count);
+    for (auto& list : lists) {
+        uint32_t ids = 0;
+        if (!r.get(list.user_id) || !r.get(ids)) return false;
+        list.ids.resize(ids);
+        for (auto& id : list.ids) {
+            if (!r.get(id)) return false;
+        }
+    }
+    return true;
+}
+
+bool read_price_series(reader& r, std::vector<gecko::series_store::saved_entry>& saved) {
+    uint32_t count = 0;
+    if (!r.get(count)) return false;
+
+    saved.resize(count);
+    for (auto& entry : saved) {
+        int64_t checked_ms = 0;
+        uint32_t levels = 0;
+        if (!r.get(entry.coingecko_id) || !r.get(checked_ms) || !r.get(levels)) return false;
+        entry.checked_at = from_unix_ms(checked_ms);
+
+        entry.levels.resize(levels);
+        for (auto& level : entry.levels) {
+            uint32_t points = 0;
+            if (!r.get(level.complete_from) || !r.get(level.last_ms) || !r.get(points)) return false;
+            if (r.remaining() / (sizeof(int64_t) + sizeof(double)) < points) return false;
+            level.time.resize(points);
+            level.price.resize(points);
+            for (auto& time : level.time) r.get(time);
+            for (auto& price : level.price) r.get(price);
+        }
+    }
+    return true;
+}
+
+// Parse a whole file. Nothing is published unless every section is valid.
+bool parse(const char* data, size_t size) {
+    reader header(data, size);
+    char magic[4];
+    uint32_t version = 0;
+    int64_t created_ms = 0;
+    uint32_t sections = 0;
+    uint64_t hash = 0;
+    if (!header.get(magic) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) return false;
+    if (!header.get(version) || version != kVersion) {
+        LOG_WARN("ignoring snapshot with another format version", logging::kv("version", version));
+        return false;
+    }
+    if (!header.get(created_ms) || !header.get(sections) || !header.get(hash)) return false;
+    if (fnv1a(header.position(), header.remaining()) != hash) {
+        LOG_WARN("ignoring corrupt snapshot");
+        return false;
+    }
+
+    std::shared_ptr<gecko::coin_index::symbol_map> index;
+    std::shared_ptr<gecko::coin_index::rank_map> ranks;
+    system_clock::time_point built_at;
+    std::vector<gecko::price_cache::saved_entry> quotes;
+    std::vector<gecko::price_alert> alerts;
+    std::vector<gecko::price_ticker> tickers;
+    std::shared_ptr<gecko::fx_rates::rate_map> rates;
+    system_clock::time_point rates_built_at;
+    std::vector<gecko::watchlist> lists;
+    std::vector<gecko::series_store::saved_entry> histories;
+
+    reader r(header.position(), header.remaining());
+    for (uint32_t i = 0; i < sections; i++) {
+        uint32_t tag = 0;
+        uint64_t section_size = 0;
+        if (!r.get(tag) || !r.get(section_size) || r.remaining() < section_size) return false;
+
+        reader section(r.position(), section_size);
+        bool ok = true;
+        if (tag == coin_index_section) {
+            ok = read_coin_index(section, index, built_at);
+        } else if (tag == price_cache_section) {
+            ok = read_price_cache(section, quotes);
+        } else if (tag == coin_ranks_section) {
+            ok = read_coin_ranks(section, ranks);
+        } else if (tag == price_alerts_section) {
+            ok = read_price_alerts(section, alerts);
+        } else if (tag == price_tickers_section) {
+            ok = read_price_tickers(section, tickers);
+        } else if (tag == fx_rates_section) {
+            ok = read_fx_rates(section, rates, rates_built_at);
+        } else if (tag == watchlists_section) {
+            ok = read_watchlists(section, lists);
+        } else if (tag == price_series_section) {
+            ok = read_price_series(section, histories);
+        }
+        if (!ok) return false;
+        r.skip(section_size);
+    }
+
+    if (index) gecko::coin_index::instance().restore(std::move(index), built_at, std::move(ranks));
+    gecko::price_cache::instance().restore(quotes);
+    gecko::alert_engine::instance().restore(alerts);
+    gecko::ticker_board::instance().restore(tickers);
+    if (rates) gecko::fx_rates::instance().restore(std::move(rates), rates_built_at);
+    gecko::watchlists::instance().restore(lists);
+    gecko::series_store::instance().restore(histories);
+    return true;
+}
+
+std::mutex saver_mutex;
+std::condition_variable saver_cv;
+bool saver_stopping = false;
+std::thread saver;
+
+}  // namespace
+
+bool snapshot::save(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+
+    writer body;
+    write_coin_index(body);
+    write_coin_ranks(body);
+    write_price_cache(body);
+    write_price_alerts(body);
+    write_price_tickers(body);
+    write_fx_rates(body);
+    write_watchlists(body);
+    write_price_series(body);
+
+    writer file;
+    file.data().append(kMagic, sizeof(kMagic));
+    file.put(kVersion);
+    file.put(to_unix_ms(system_clock::now()));
+    file.put(body.sections());
+    file.put(fnv1a(body.data().data(), body.data().size()));
+    file.data().append(body.data());
+
+    std::string temp_path = path + ".tmp";
+    FILE* out = std::fopen(temp_path.c_str(), "wb");
+    if (out == nullptr) {
+        LOG_ERROR("could not write snapshot", logging::kv("path", temp_path), logging::kv("error", std::strerror(errno)));
+        return false;
+    }
+    bool written = std::fwrite(file.data().data(), 1, file.data().size(), out) == file.data().size();
+    written = std::fflush(out) == 0 && written;
+    written = fsync(fileno(out)) == 0 && written;
+    std::fclose(out);
+
+    if (!written || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        LOG_ERROR("could not write snapshot", logging::kv("path", path), logging::kv("error", std::strerror(errno)));
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    LOG_INFO("snapshot saved", logging::kv("path", path), logging::kv("bytes", file.data().size()),
+             logging::kv("ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count()));
+    return true;
+}
+
+bool snapshot::load(const std::string& path) {
+    auto started = std::chrono::steady_clock::now();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_INFO("no snapshot to load", logging::kv("path", path));
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(kHeaderSize)) {
+        close(fd);
+        LOG_WARN("ignoring truncated snapshot", logging::kv("path", path));
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG_ERROR("could not map snapshot", logging::kv("path", path), logging::kv("error", std::strerror(errno)));
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    bool ok = parse(static_cast<const char*>(mapped), size);
+    munmap(mapped, size);
+
+    if (!ok) {
+        LOG_WARN("ignoring unreadable snapshot", logging::kv("path", path));
+        return false;
+    }
+    LOG_INFO("snapshot loaded", logging::kv("path", path), logging::kv("bytes", size),
+             logging::kv("ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count()));
+    return true;
+}
+
+void snapshot::start(const std::string& path, std::chrono::seconds interval) {
+    {
+        std::lock_guard<std::mutex> lock(saver_mutex);
+        saver_stopping = false;
+    }
+    interval = std::max(interval, std::chrono::seconds(1));
+    saver = std::thread([path, interval] {
+        std::unique_lock<std::mutex> lock(saver_mutex);
+        while (!saver_cv.wait_for(lock, interval, [] { return saver_stopping; })) {
+            lock.unlock();
+            save(path);
+            lock.lock();
+        }
+        lock.unlock();
+        save(path);
+    });
+}
+
+void snapshot::stop() {
+    {
+        std::lock_guard<std::mutex> lock(saver_mutex);
+        saver_stopping = true;
+    }
+    saver_cv.notify_all();
+    if (saver.joinable()) saver.join();
+}
@@ -0,0 +1,297 @@
+#include <logging.h>
+#include <price_cache.h>
+#include <price_format.h>
+#include <ticker_board.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+// e.g. "30s", "5m", "1h"
+std::string interval_label(std::chrono::seconds interval) {
+    long seconds = static_cast<long>(interval.count());
+    if (seconds % 3600 == 0) return std::to_string(seconds / 3600) + "h";
+    if (seconds % 60 == 0) return std::to_string(seconds / 60) + "m";
+    return std::to_string(seconds) + "s";
+}
+
+}  // namespace
+
+std::string gecko::ticker_message(const price_ticker& ticker, const price_quote& quote) {
+    auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+
+    std::string out = ":chart_with_upwards_trend: **" + ticker.coingecko_id + "** $";
+    pricefmt::append(out, quote.usd, quote.usd_precision, pricefmt::usd);
+    double idr = idr_price(quote);
+    if (idr > 0) {
+        out += " / Rp.";
+        pricefmt::append(out, idr, pricefmt::display_precision(idr), pricefmt::idr);
+    }
+    out += "\n_Live ticker #" + std::to_string(ticker.id) + ", every " + interval_label(ticker.interval) +
+           ", updated <t:" + std::to_string(now.count()) + ":R>_";
+    return out;
+}
+
+gecko::ticker_board& gecko::ticker_board::instance() {
+    static ticker_board board;
+    return board;
+}
+
+gecko::ticker_board::ticker_board() : epoch_(clock::now()) {}
+
+gecko::ticker_board::~ticker_board() {
+    stop();
+}
+
+void gecko::ticker_board::start(size_t batch_size, size_t max_per_channel, std::chrono::milliseconds edit_spacing,
+                                edit_callback edit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch_size_ = std::max<size_t>(batch_size, 1);
+        max_per_channel_ = max_per_channel;
+        edit_spacing_ = std::max(edit_spacing, std::chrono::milliseconds(1));
+        edit_ = std::move(edit);
+        stopping_ = false;
+    }
+    worker_ = std::thread(&ticker_board::run, this);
+}
+
+void gecko::ticker_board::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    worker_cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+uint64_t gecko::ticker_board::tick_at(clock::time_point t) const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(t - epoch_).count());
+}
+
+// The next multiple of the ticker's interval, so tickers sharing an
+// interval (or a multiple of it) come due in the same second
+uint64_t gecko::ticker_board::next_slot(const price_ticker& ticker) const {
+    uint64_t interval = std::max<uint64_t>(static_cast<uint64_t>(ticker.interval.count()), 1);
+    return (wheel_.now() / interval + 1) * interval;
+}
+
+void gecko::ticker_board::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        auto now = clock::now();
+
+        std::vector<uint64_t> fired;
+        wheel_.advance(tick_at(now), fired);
+        if (!fired.empty()) {
+            due_map due;
+            for (uint64_t id : fired) {
+                auto it = tickers_.find(id);
+                if (it == tickers_.end()) continue;
+                due[it->second.coingecko_id].push_back(id);
+                wheel_.schedule(id, next_slot(it->second));
+            }
+            refresh_slots_++;
+            lock.unlock();
+            refresh(std::move(due));
+            lock.lock();
+        }
+
+        // Let out one edit per channel whose spacing has elapsed
+        std::vector<std::pair<price_ticker, std::string>> edits;
+        auto wake = epoch_ + std::chrono::seconds(wheel_.now() + 1);
+        for (auto it = channels_.begin(); it != channels_.end();) {
+            channel_queue& queue = it->second;
+            // Tickers removed since their edit was queued
+            while (!queue.waiting.empty() && pending_.count(queue.waiting.front()) == 0) queue.waiting.pop_front();
+
+            if (!queue.waiting.empty() && queue.next_edit <= now) {
+                uint64_t id = queue.waiting.front();
+                queue.waiting.pop_front();
+                auto content = pending_.find(id);
+                auto ticker = tickers_.find(id);
+                if (ticker != tickers_.end()) edits.emplace_back(ticker->second, std::move(content->second));
+                pending_.erase(content);
+                queue.next_edit = now + edit_spacing_;
+            }
+
+            if (!queue.waiting.empty()) {
+                wake = std::min(wake, queue.next_edit);
+            } else if (queue.next_edit <= now) {
+                it = channels_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+
+        if (!edits.empty()) {
+            edits_ += edits.size();
+            edit_callback edit = edit_;
+            lock.unlock();
+            for (const auto& [ticker, content] : edits) {
+                if (edit) edit(ticker, content);
+            }
+            lock.lock();
+            continue;
+        }
+
+        auto ready = [this] { return stopping_ || edits_ready_; };
+        if (wheel_.empty() && channels_.empty()) {
+            // Idle until a ticker is added
+            worker_cv_.wait(lock, ready);
+        } else {
+            worker_cv_.wait_until(lock, wake, ready);
+        }
+        edits_ready_ = false;
+    }
+}
+
+void gecko::ticker_board::refresh(due_map due) {
+    // Coins someone just looked up need no request of their own
+    std::vector<std::string> stale;
+    for (const auto& [id, tickers] : due) {
+        price_quote quote;
+        if (price_cache::instance().peek(id, quote)) {
+            publish(tickers, quote);
+        } else {
+            stale.push_back(id);
+        }
+    }
+    if (stale.empty()) return;
+
+    size_t batches = (stale.size() + batch_size_ - 1) / batch_size_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requests_ += batches;
+    }
+    LOG_DEBUG("refreshing tickers", logging::kv("coins", stale.size()), logging::kv("requests", batches),
+              logging::kv("from_cache", due.size() - stale.size()));
+
+    auto shared_due = std::make_shared<const due_map>(std::move(due));
+    for (size_t i = 0; i < stale.size(); i += batch_size_) {
+        std::vector<std::string> batch(stale.begin() + i, stale.begin() + std::min(stale.size(), i + batch_size_));
+        fetch_quotes(
+            batch,
+            [this, shared_due](const quote_map& results) {
+                for (const auto& [id, result] : results) {
+                    // Leave the message showing the last price rather than an error
+                    if (!result.ok) continue;
+                    price_cache::instance().store(id, result.quote);
+                    auto tickers = shared_due->find(id);
+                    if (tickers != shared_due->end()) publish(tickers->second, result.quote);
+                }
+            },
+            http::priority::background);
+    }
+}
+
+void gecko::ticker_board::publish(const std::vector<uint64_t>& ticker_ids, const price_quote& quote) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint64_t id : ticker_ids) {
+            auto ticker = tickers_.find(id);
+            if (ticker == tickers_.end()) continue;
+
+            auto [pending, inserted] = pending_.try_emplace(id);
+            pending->second = ticker_message(ticker->second, quote);
+            if (inserted) {
+                channels_[ticker->second.channel_id].waiting.push_back(id);
+            } else {
+                coalesced_edits_++;
+            }
+        }
+        edits_ready_ = true;
+    }
+    worker_cv_.notify_one();
+}
+
+bool gecko::ticker_board::add(price_ticker& ticker) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (per_channel_[ticker.channel_id] >= max_per_channel_) return false;
+        ticker.id = next_id_++;
+        insert(ticker);
+    }
+    worker_cv_.notify_one();
+    return true;
+}
+
+void gecko::ticker_board::set_message(uint64_t ticker_id, uint64_t message_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tickers_.find(ticker_id);
+    if (it != tickers_.end()) it->second.message_id = message_id;
+}
+
+bool gecko::ticker_board::remove(uint64_t channel_id, uint64_t ticker_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tickers_.find(ticker_id);
+    if (it == tickers_.end() || it->second.channel_id != channel_id) return false;
+    erase(ticker_id);
+    return true;
+}
+
+void gecko::ticker_board::remove(uint64_t ticker_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tickers_.count(ticker_id)) erase(ticker_id);
+}
+
+std::vector<gecko::price_ticker> gecko::ticker_board::list(uint64_t channel_id) const {
+    std::vector<price_ticker> out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [id, ticker] : tickers_) {
+            if (ticker.channel_id == channel_id) out.push_back(ticker);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](const price_ticker& a, const price_ticker& b) { return a.id < b.id; });
+    return out;
+}
+
+gecko::ticker_board::stats gecko::ticker_board::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {tickers_.size(), refresh_slots_, requests_, edits_, coalesced_edits_};
+}
+
+std::vector<gecko::price_ticker> gecko::ticker_board::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<price_ticker> out;
+    out.reserve(tickers_.size());
+    for (const auto& [id, ticker] : tickers_) out.push_back(ticker);
+    return out;
+}
+
+void gecko::ticker_board::restore(const std::vector<price_ticker>& saved) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& ticker : saved) {
+            if (ticker.id == 0 || tickers_.count(ticker.id)) continue;
+            insert(ticker);
+            next_id_ = std::max(next_id_, ticker.id + 1);
+        }
+    }
+    worker_cv_.notify_one();
+}
+
+// Callers hold mutex_
+void gecko::ticker_board::insert(const price_ticker& ticker) {
+    tickers_[ticker.id] = ticker;
+    per_channel_[ticker.channel_id]++;
+    // An idle worker doesn't advance the wheel; catch up so the slot is aligned to now
+    if (wheel_.empty()) {
+        std::vector<uint64_t> none;
+        wheel_.advance(tick_at(clock::now()), none);
+    }
+    wheel_.schedule(ticker.id, next_slot(ticker));
+    edits_ready_ = true;
+}
+
+// Callers hold mutex_
+void gecko::ticker_board::erase(uint64_t ticker_id) {
+    auto it = tickers_.find(ticker_id);
+    auto channel = per_channel_.find(it->second.channel_id);
+    if (channel != per_channel_.end() && --channel->second == 0) per_channel_.erase(channel);
+    wheel_.cancel(ticker_id);
+    pending_.erase(ticker_id);
+    tickers_.erase(it);
+}
@@ -0,0 +1,65 @@
+#include <timer_wheel.h>
+
+#include <algorithm>
+
+void timer_wheel::schedule(timer_id id, uint64_t at) {
+    at = std::clamp(at, now_ + 1, now_ + kMaxDelay);
+    timer& t = timers_[id];
+    t.expires = at;
+    t.generation = next_generation_++;
+    place(id, t);
+}
+
+bool timer_wheel::cancel(timer_id id) {
+    // The slot entry stays behind and is skipped once its slot comes up
+    return timers_.erase(id) > 0;
+}
+
+bool timer_wheel::current(const slot_entry& entry) const {
+    auto it = timers_.find(entry.id);
+    return it != timers_.end() && it->second.generation == entry.generation;
+}
+
+void timer_wheel::place(timer_id id, const timer& t) {
+    uint64_t delay = t.expires - now_;
+    int level = 0;
+    while (level < kLevels - 1 && delay >= (uint64_t{1} << (kLevelBits * (level + 1)))) level++;
+    size_t index = (t.expires >> (kLevelBits * level)) & (kSlots - 1);
+    wheels_[level][index].push_back({id, t.generation});
+}
+
+void timer_wheel::cascade(int level, uint64_t tick) {
+    size_t index = (tick >> (kLevelBits * level)) & (kSlots - 1);
+    slot entries;
+    entries.swap(wheels_[level][index]);
+    for (const auto& entry : entries) {
+        if (current(entry)) place(entry.id, timers_.at(entry.id));
+    }
+}
+
+void timer_wheel::advance(uint64_t to, std::vector<timer_id>& due) {
+    while (now_ < to) {
+        if (timers_.empty()) {
+            // Nothing can fire; only stale entries are left in the slots
+            for (auto& level : wheels_) {
+                for (auto& s : level) s.clear();
+            }
+            now_ = to;
+            return;
+        }
+
+        uint64_t tick = ++now_;
+        // Refill lower levels from the top down at each level boundary
+        for (int level = kLevels - 1; level > 0; level--) {
+            if ((tick & ((uint64_t{1} << (kLevelBits * level)) - 1)) == 0) cascade(level, tick);
+        }
+
+        slot entries;
+        entries.swap(wheels_[0][tick & (kSlots - 1)]);
+        for (const auto& entry : entries) {
+            if (!current(entry)) continue;
+            timers_.erase(entry.id);
+            due.push_back(entry.id);
+        }
+    }
+}
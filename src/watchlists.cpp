@@ -0,0 +1,83 @@
+#include <watchlists.h>
+
+#include <algorithm>
+
+gecko::watchlists& gecko::watchlists::instance() {
+    static watchlists lists;
+    return lists;
+}
+
+void gecko::watchlists::configure(size_t max_coins) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_coins_ = std::max<size_t>(max_coins, 1);
+}
+
+size_t gecko::watchlists::max_coins() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_coins_;
+}
+
+std::vector<std::string> gecko::watchlists::add(uint64_t user_id, const std::vector<std::string>& ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> added;
+    auto& list = lists_[user_id];
+    for (const auto& id : ids) {
+        if (list.size() >= max_coins_) break;
+        if (std::find(list.begin(), list.end(), id) != list.end()) continue;
+        list.push_back(id);
+        added.push_back(id);
+    }
+    coins_ += added.size();
+    if (list.empty()) lists_.erase(user_id);
+    return added;
+}
+
+std::vector<std::string> gecko::watchlists::remove(uint64_t user_id, const std::vector<std::string>& ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> removed;
+    auto it = lists_.find(user_id);
+    if (it == lists_.end()) return removed;
+
+    auto& list = it->second;
+    for (const auto& id : ids) {
+        auto found = std::find(list.begin(), list.end(), id);
+        if (found == list.end()) continue;
+        list.erase(found);
+        removed.push_back(id);
+    }
+    coins_ -= removed.size();
+    if (list.empty()) lists_.erase(it);
+    return removed;
+}
+
+std::vector<std::string> gecko::watchlists::get(uint64_t user_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = lists_.find(user_id);
+    return it == lists_.end() ? std::vector<std::string>{} : it->second;
+}
+
+gecko::watchlists::stats gecko::watchlists::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats out;
+    out.users = lists_.size();
+    out.coins = coins_;
+    return out;
+}
+
+std::vector<gecko::watchlist> gecko::watchlists::save() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<watchlist> out;
+    out.reserve(lists_.size());
+    for (const auto& [user_id, ids] : lists_) out.push_back({user_id, ids});
+    return out;
+}
+
+void gecko::watchlists::restore(const std::vector<watchlist>& saved) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& list : saved) {
+        if (list.ids.empty() || lists_.count(list.user_id)) continue;
+        auto& ids = lists_[list.user_id];
+        ids.assign(list.ids.begin(), list.ids.begin() + std::min(list.ids.size(), max_coins_));
+        coins_ += ids.size();
+    }
+}